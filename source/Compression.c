@@ -0,0 +1,513 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "Compression.h"
+
+// Compressed bytes read from a gzip file at once:
+#define COMPRESSED_INPUT_BYTES (256 << 10)
+
+// A BGZF block starts with a gzip header whose extra field holds its size:
+#define BGZF_HEADER_BYTES 18
+#define BGZF_FOOTER_BYTES 8
+#define BGZF_MAX_BLOCK_BYTES 65536
+
+static void failDecompression(CompressedFile* file)
+{
+    printf("CRITICAL: FAILED TO DECOMPRESS %s!\n", file->fileName);
+    exit(1);
+}
+
+static inline unsigned int read32(unsigned char* bytes)
+{
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+}
+
+/* Returns the size of the BGZF block starting with the header, or 0 if the 
+ * header is not that of a BGZF block. */
+static unsigned int getBlockSize(unsigned char* header)
+{
+    if(header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || (header[3] & 0x4) == 0 ||
+            header[10] != 6 || header[11] != 0 || header[12] != 'B' || header[13] != 'C' || 
+            header[14] != 2 || header[15] != 0)
+    {
+        return 0;
+    }
+    
+    return (header[16] | (header[17] << 8)) + 1;
+}
+
+bool isCompressedFile(char* fileName)
+{
+    unsigned char magic[2];
+    bool compressed;
+    
+    FILE* file = fopen(fileName, "rb");
+    
+    if(file == NULL)
+    {
+        return false;
+    }
+    
+    compressed = fread(magic, 1, 2, file) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+    fclose(file);
+    
+    return compressed;
+}
+
+/* Waits for a chunk that the reader is done with, and returns it, or NULL if 
+ * the reader stopped reading. */
+static CompressedChunk* getFreeChunk(CompressedFile* file)
+{
+    CompressedChunk* chunk = NULL;
+    
+    pthread_mutex_lock(&(file->lock));
+    
+    while(file->filled == COMPRESSED_NUM_CHUNKS && !file->closing)
+    {
+        pthread_cond_wait(&(file->changed), &(file->lock));
+    }
+    
+    if(!file->closing)
+    {
+        chunk = &(file->chunks[(file->first + file->filled) % COMPRESSED_NUM_CHUNKS]);
+    }
+    
+    pthread_mutex_unlock(&(file->lock));
+    
+    return chunk;
+}
+
+/* Hands the chunk returned by getFreeChunk to the reader. */
+static void finishChunk(CompressedFile* file)
+{
+    pthread_mutex_lock(&(file->lock));
+    file->filled++;
+    pthread_cond_broadcast(&(file->changed));
+    pthread_mutex_unlock(&(file->lock));
+}
+
+/* Decompresses a gzip file, member after member. */
+static void inflateGzip(CompressedFile* file)
+{
+    unsigned char* input = (unsigned char*)malloc(COMPRESSED_INPUT_BYTES);
+    unsigned long long int consumed = 0;    // Bytes read from the file.
+    CompressedChunk* chunk;
+    z_stream stream;
+    int status;
+    bool ended = false;                     // Whether the last member ended.
+    
+    memset(&stream, 0, sizeof(stream));
+    
+    if(input == NULL || inflateInit2(&stream, 15 + 16) != Z_OK)
+    {
+        failDecompression(file);
+    }
+    
+    while((chunk = getFreeChunk(file)) != NULL)
+    {
+        stream.next_out = (Bytef*)chunk->data;
+        stream.avail_out = COMPRESSED_CHUNK_BYTES;
+        
+        while(stream.avail_out > 0)
+        {
+            if(stream.avail_in == 0)
+            {
+                stream.next_in = input;
+                stream.avail_in = fread(input, 1, COMPRESSED_INPUT_BYTES, file->file);
+                consumed += stream.avail_in;
+                
+                if(stream.avail_in == 0)
+                {
+                    break;
+                }
+            }
+            
+            status = inflate(&stream, Z_NO_FLUSH);
+            ended = (status == Z_STREAM_END);
+            
+            // Another member may follow:
+            if(status == Z_STREAM_END)
+            {
+                inflateReset(&stream);
+            }
+            else if(status != Z_OK)
+            {
+                failDecompression(file);
+            }
+        }
+        
+        chunk->length = COMPRESSED_CHUNK_BYTES - stream.avail_out;
+        chunk->end = consumed - stream.avail_in;
+        
+        if(chunk->length == 0)
+        {
+            break;
+        }
+        
+        finishChunk(file);
+    }
+    
+    // The file was cut short:
+    if(chunk != NULL && !ended)
+    {
+        failDecompression(file);
+    }
+    
+    inflateEnd(&stream);
+    free(input);
+}
+
+// A range of the BGZF blocks of a chunk, decompressed by one thread:
+typedef struct
+{
+    unsigned char* input;
+    unsigned long long int* blocks;         // Input offsets of the blocks.
+    unsigned long long int* outputs;        // Output offsets of the blocks.
+    char* output;
+    
+    unsigned int first;
+    unsigned int last;
+    bool failed;
+} InflatingThread;
+
+static void* inflateBlocksThread(void* arg)
+{
+    InflatingThread* thread = (InflatingThread*)arg;
+    unsigned char* block;
+    unsigned int size;
+    unsigned int length;
+    z_stream stream;
+    
+    memset(&stream, 0, sizeof(stream));
+    
+    if(inflateInit2(&stream, -15) != Z_OK)
+    {
+        thread->failed = true;
+        return NULL;
+    }
+    
+    for(unsigned int i = thread->first; i < thread->last && !thread->failed; i++)
+    {
+        block = thread->input + thread->blocks[i];
+        size = thread->blocks[i + 1] - thread->blocks[i];
+        length = thread->outputs[i + 1] - thread->outputs[i];
+        
+        // End of file markers hold nothing:
+        if(length == 0)
+        {
+            continue;
+        }
+        
+        inflateReset(&stream);
+        
+        stream.next_in = block + BGZF_HEADER_BYTES;
+        stream.avail_in = size - BGZF_HEADER_BYTES - BGZF_FOOTER_BYTES;
+        stream.next_out = (Bytef*)(thread->output + thread->outputs[i]);
+        stream.avail_out = length;
+        
+        thread->failed = inflate(&stream, Z_FINISH) != Z_STREAM_END || stream.avail_out != 0 ||
+                crc32(0L, (Bytef*)(thread->output + thread->outputs[i]), length) != 
+                read32(block + size - BGZF_FOOTER_BYTES);
+    }
+    
+    inflateEnd(&stream);
+    
+    return NULL;
+}
+
+/* Decompresses a chunk's worth of BGZF blocks at a time, dividing the blocks 
+ * among the threads. */
+static void inflateBGZF(CompressedFile* file)
+{
+    unsigned char* input = (unsigned char*)malloc(COMPRESSED_CHUNK_BYTES + BGZF_MAX_BLOCK_BYTES);
+    unsigned int maxBlocks = COMPRESSED_CHUNK_BYTES / BGZF_HEADER_BYTES + 2;
+    unsigned long long int* blocks = (unsigned long long int*)malloc(maxBlocks * sizeof(unsigned long long int));
+    unsigned long long int* outputs = (unsigned long long int*)malloc(maxBlocks * sizeof(unsigned long long int));
+    unsigned long long int consumed = 0;    // Bytes read from the file.
+    unsigned int numThreads = file->numThreads;
+    unsigned int numBlocks;
+    unsigned int size = 0;                  // Of a block left for the next chunk.
+    unsigned int length = 0;
+    size_t header;
+    bool end = false;
+    
+    CompressedChunk* chunk;
+    InflatingThread threads[numThreads];
+    pthread_t handles[numThreads];
+    
+    if(input == NULL || blocks == NULL || outputs == NULL)
+    {
+        failDecompression(file);
+    }
+    
+    while(!end && (chunk = getFreeChunk(file)) != NULL)
+    {
+        numBlocks = 0;
+        blocks[0] = 0;
+        outputs[0] = 0;
+        
+        // The block left over from the last chunk is already at the start:
+        if(size > 0)
+        {
+            blocks[1] = size;
+            outputs[1] = length;
+            numBlocks = 1;
+        }
+        
+        // Read whole blocks while they fit in the chunk:
+        while(true)
+        {
+            if((header = fread(input + blocks[numBlocks], 1, BGZF_HEADER_BYTES, file->file)) == 0)
+            {
+                end = true;
+                size = 0;
+                break;
+            }
+            
+            if(header != BGZF_HEADER_BYTES || (size = getBlockSize(input + blocks[numBlocks])) < 
+                    BGZF_HEADER_BYTES + BGZF_FOOTER_BYTES || fread(input + blocks[numBlocks] + BGZF_HEADER_BYTES, 
+                    1, size - BGZF_HEADER_BYTES, file->file) != size - BGZF_HEADER_BYTES)
+            {
+                failDecompression(file);
+            }
+            
+            consumed += size;
+            length = read32(input + blocks[numBlocks] + size - 4);
+            
+            if(length > BGZF_MAX_BLOCK_BYTES)
+            {
+                failDecompression(file);
+            }
+            
+            // Leave the block for the next chunk:
+            if(blocks[numBlocks] + size > COMPRESSED_CHUNK_BYTES || 
+                    outputs[numBlocks] + length > COMPRESSED_CHUNK_BYTES)
+            {
+                break;
+            }
+            
+            blocks[numBlocks + 1] = blocks[numBlocks] + size;
+            outputs[numBlocks + 1] = outputs[numBlocks] + length;
+            numBlocks++;
+            size = 0;
+        }
+        
+        // Each thread decompresses a contiguous range of blocks:
+        for(unsigned int t = 0; t < numThreads; t++)
+        {
+            threads[t].input = input;
+            threads[t].blocks = blocks;
+            threads[t].outputs = outputs;
+            threads[t].output = chunk->data;
+            threads[t].first = numBlocks * t / numThreads;
+            threads[t].last = numBlocks * (t + 1) / numThreads;
+            threads[t].failed = false;
+            
+            if(numThreads > 1)
+            {
+                pthread_create(&handles[t], NULL, inflateBlocksThread, &threads[t]);
+            }
+            else
+            {
+                inflateBlocksThread(&threads[t]);
+            }
+        }
+        
+        for(unsigned int t = 0; t < numThreads; t++)
+        {
+            if(numThreads > 1)
+            {
+                pthread_join(handles[t], NULL);
+            }
+            
+            if(threads[t].failed)
+            {
+                failDecompression(file);
+            }
+        }
+        
+        chunk->length = outputs[numBlocks];
+        chunk->end = consumed - size;
+        
+        // Move the block left over to the start:
+        if(size > 0)
+        {
+            memmove(input, input + blocks[numBlocks], size);
+        }
+        
+        if(chunk->length > 0)
+        {
+            finishChunk(file);
+        }
+    }
+    
+    free(input);
+    free(blocks);
+    free(outputs);
+}
+
+/* Decompresses the whole file in the background. */
+static void* decompressFile(void* arg)
+{
+    CompressedFile* file = (CompressedFile*)arg;
+    
+    if(file->bgzf)
+    {
+        inflateBGZF(file);
+    }
+    else
+    {
+        inflateGzip(file);
+    }
+    
+    pthread_mutex_lock(&(file->lock));
+    file->finished = true;
+    pthread_cond_broadcast(&(file->changed));
+    pthread_mutex_unlock(&(file->lock));
+    
+    return NULL;
+}
+
+CompressedFile* openCompressedFile(char* fileName, unsigned int numThreads)
+{
+    CompressedFile* file;
+    unsigned char header[BGZF_HEADER_BYTES];
+    struct stat st;
+    
+    if((file = calloc(1, sizeof *file)) == NULL)
+    {
+        return NULL;
+    }
+    
+    if((file->file = fopen(fileName, "rb")) == NULL || fstat(fileno(file->file), &st) != 0)
+    {
+        if(file->file != NULL)
+        {
+            fclose(file->file);
+        }
+        
+        free(file);
+        return NULL;
+    }
+    
+    file->fileName = fileName;
+    file->size = st.st_size;
+    file->numThreads = (numThreads > 0) ? numThreads : 1;
+    
+    // A file that starts with a BGZF block is read as one:
+    file->bgzf = fread(header, 1, BGZF_HEADER_BYTES, file->file) == BGZF_HEADER_BYTES && 
+            getBlockSize(header) > 0;
+    rewind(file->file);
+    
+    for(int i = 0; i < COMPRESSED_NUM_CHUNKS; i++)
+    {
+        if((file->chunks[i].data = (char*)malloc(COMPRESSED_CHUNK_BYTES)) == NULL)
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE DECOMPRESSION BUFFERS!\n");
+            exit(1);
+        }
+    }
+    
+    pthread_mutex_init(&(file->lock), NULL);
+    pthread_cond_init(&(file->changed), NULL);
+    pthread_create(&(file->thread), NULL, decompressFile, file);
+    
+    return file;
+}
+
+unsigned long long int readCompressedFile(CompressedFile* file, char* buffer, 
+        unsigned long long int length)
+{
+    CompressedChunk* chunk;
+    unsigned long long int copied = 0;
+    unsigned long long int available;
+    
+    while(copied < length)
+    {
+        // Wait for the next chunk:
+        pthread_mutex_lock(&(file->lock));
+        
+        while(file->filled == 0 && !file->finished)
+        {
+            pthread_cond_wait(&(file->changed), &(file->lock));
+        }
+        
+        chunk = (file->filled > 0) ? &(file->chunks[file->first]) : NULL;
+        pthread_mutex_unlock(&(file->lock));
+        
+        // The end of the file:
+        if(chunk == NULL)
+        {
+            break;
+        }
+        
+        available = chunk->length - file->offset;
+        available = (available < length - copied) ? available : length - copied;
+        
+        memcpy(buffer + copied, chunk->data + file->offset, available);
+        copied += available;
+        file->offset += available;
+        
+        // Give the chunk back once it is read:
+        if(file->offset == chunk->length)
+        {
+            file->offset = 0;
+            file->position = chunk->end;
+            
+            pthread_mutex_lock(&(file->lock));
+            file->first = (file->first + 1) % COMPRESSED_NUM_CHUNKS;
+            file->filled--;
+            pthread_cond_broadcast(&(file->changed));
+            pthread_mutex_unlock(&(file->lock));
+        }
+    }
+    
+    return copied;
+}
+
+unsigned long long int getCompressedPosition(CompressedFile* file)
+{
+    return file->position;
+}
+
+void closeCompressedFile(CompressedFile* file)
+{
+    // Stop the background thread, if it is still decompressing:
+    pthread_mutex_lock(&(file->lock));
+    file->closing = true;
+    pthread_cond_broadcast(&(file->changed));
+    pthread_mutex_unlock(&(file->lock));
+    
+    pthread_join(file->thread, NULL);
+    
+    for(int i = 0; i < COMPRESSED_NUM_CHUNKS; i++)
+    {
+        free(file->chunks[i].data);
+    }
+    
+    pthread_mutex_destroy(&(file->lock));
+    pthread_cond_destroy(&(file->changed));
+    fclose(file->file);
+    free(file);
+}
@@ -0,0 +1,125 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <pthread.h>
+#include "Utility.h"
+
+#ifndef COMPRESSION_H
+#define	COMPRESSION_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reads a gzip-compressed file as a stream of decompressed bytes. A background 
+ * thread decompresses the file ahead of the reader into a small ring of chunks, 
+ * so that decompression overlaps with whatever the reader does with the bytes.
+ * 
+ * A file made of several gzip members is read as their concatenation. When the 
+ * file is BGZF (a series of small gzip members that record their own sizes, as 
+ * written by bgzip), the background thread instead decompresses a chunk's worth 
+ * of members at a time, divided among several threads.
+ */
+#define COMPRESSED_CHUNK_BYTES (4 << 20)    // Decompressed bytes per chunk.
+#define COMPRESSED_NUM_CHUNKS 4             // Chunks decompressed ahead.
+
+// A chunk of decompressed bytes:
+typedef struct
+{
+    char* data;
+    unsigned long long int length;
+    unsigned long long int end;             // The compressed bytes before its end.
+} CompressedChunk;
+
+typedef struct
+{
+    char* fileName;
+    FILE* file;
+    unsigned long long int size;            // The length of the compressed file.
+    bool bgzf;
+    unsigned int numThreads;                // Decompressing BGZF members.
+    
+    // Filled by the background thread and emptied by the reader, in order:
+    CompressedChunk chunks[COMPRESSED_NUM_CHUNKS];
+    unsigned int first;                     // The next chunk to read.
+    unsigned int filled;                    // The number of chunks ready.
+    bool finished;                          // Whether every chunk was filled.
+    bool closing;                           // Whether the reader stopped.
+    
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+    
+    unsigned long long int offset;          // Read from the first chunk.
+    unsigned long long int position;        // The compressed bytes read.
+} CompressedFile;
+
+/**
+ * Returns whether the file starts like a gzip file.
+ * 
+ * @param fileName The name of the file.
+ * @return Whether or not the file is compressed.
+ */
+bool isCompressedFile(char* fileName);
+
+/**
+ * Opens the compressed file and starts decompressing it.
+ * 
+ * @param fileName The name of the file.
+ * @param numThreads The number of threads decompressing a BGZF file.
+ * @return The compressed file, or NULL if it could not be opened.
+ */
+CompressedFile* openCompressedFile(char* fileName, unsigned int numThreads);
+
+/**
+ * Copies the next decompressed bytes of the file into the buffer, waiting for 
+ * them to be decompressed if needed. Exits if the file is damaged.
+ * 
+ * @param file The compressed file.
+ * @param buffer The buffer to fill.
+ * @param length The size of the buffer.
+ * @return The number of bytes copied, which is 0 only at the end of the file.
+ */
+unsigned long long int readCompressedFile(CompressedFile* file, char* buffer, 
+        unsigned long long int length);
+
+/**
+ * Returns the number of compressed bytes that hold the bytes read so far, to 
+ * the nearest chunk.
+ * 
+ * @param file The compressed file.
+ * @return The compressed bytes read.
+ */
+unsigned long long int getCompressedPosition(CompressedFile* file);
+
+/**
+ * Stops decompressing and closes the file.
+ * 
+ * @param file The compressed file to close.
+ */
+void closeCompressedFile(CompressedFile* file);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* COMPRESSION_H */
@@ -22,21 +22,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "Utility.h"
 
 void getKMerCounts(unsigned long long int* sequence, unsigned int length, 
-        KMerHashTable* kmers,  unsigned int kmerSize, unsigned int* counts)
+        KMerHashTable* kmers, unsigned int* counts)
 {
-    // Variables:
-    unsigned long long int kmer;
-    int total = length - kmerSize + 1;
-    
-    // Iterate over all k-mers within the read:
-    for(int i = 0; i < total; i++)
-    {
-        // Get the next k-mer:
-        kmer = getKMer(sequence, i, i + kmerSize);
-
-        // Get the count:     
-        counts[i] = KMerTableLookup(kmers, kmer);
-    }
+    // Get the counts of all k-mers within the read at once:
+    KMerTableLookupSequence(kmers, sequence, length, counts);
 }
 
 unsigned int areCountsBelowThreshold(unsigned int* counts, unsigned int start, 
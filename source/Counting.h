@@ -34,12 +34,11 @@ extern "C" {
  * @param sequence The sequence to get the k-mer counts for.
  * @param length The length of the sequence.
  * @param kmers The k-mer hash table data structure.
- * @param kmerSize The length of the kmers.
- * @param counts The counts array to fill. There will be (length - kmerSize + 1) 
+ * @param counts The counts array to fill. There will be (length - k + 1) 
  *      entries expected to be filled.
  */    
 void getKMerCounts(unsigned long long int* sequence, unsigned int length, 
-        KMerHashTable* kmers,  unsigned int kmerSize, unsigned int* counts);
+        KMerHashTable* kmers, unsigned int* counts);
 
 /**
  * This function determines whether or not all the entries between the specified 
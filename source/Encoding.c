@@ -52,7 +52,6 @@ void encode_sequence(struct read* rd, char* seq) {
         seq[strlen(seq) - 1] = 0;
     }
     int seq_words = ceil((double)strlen(seq)/(double)32);
-    rd->sequence       = malloc(seq_words * sizeof(unsigned long long int));
     // initialize the array to be 0's
     for (int i = 0; i < seq_words; i++) {
         rd->sequence[i] = 0;
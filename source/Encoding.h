@@ -31,7 +31,8 @@ extern "C" {
     
 #include "Reads.h"
 
-// Encodes the given string into the sequence_64b 64bit word array
+// Encodes the given string into the sequence_64b 64bit word array, which 
+// must already hold ceil(length / 32) words
 void encode_sequence(struct read* rd, char* seq);
 
 #ifdef	__cplusplus
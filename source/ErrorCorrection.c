@@ -47,6 +47,7 @@ typedef enum
     CorrectionType_Count       // Needs to be last! Count of items in enum!
 } CorrectionType;
 
+// Updated atomically, as reads are corrected by several threads at once:
 unsigned int substitutionErrors = 0;
 unsigned int insertionErrors = 0;
 unsigned int deletionErrors = 0;
@@ -119,7 +120,7 @@ int getSequenceLocation(struct Sequence* sequence, int kmerLocation,
     // K-mers.
     int total = sequence->length - kmerSize + 1;
     unsigned int kmerCounts[total];
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmerCounts);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerCounts);
     
     int sequenceLocation;
     
@@ -222,13 +223,13 @@ bool doSubstitutionCorrection(
     unsigned int kmersCorrection[total];
     
     // Get initial counts.
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmersInitial);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmersInitial);
     
     // Try correction.   
     changeBase(sequence, sequenceLocation, substitution, newQuality);
     
     // Get new counts.
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmersCorrection);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmersCorrection);
     
     // Note changes:
     int kmersImproved = evaluateCorrection(isHighToLow(kmersInitial, kmerLocation), 
@@ -254,7 +255,7 @@ bool doDeletionCorrection(struct Sequence* sequence, unsigned int kmerLocation,
     unsigned int kmersCorrection[total];
     
     // Get initial counts.
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmersInitial);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmersInitial);
     
     // Try correction.
     if(insertLeft)
@@ -267,7 +268,7 @@ bool doDeletionCorrection(struct Sequence* sequence, unsigned int kmerLocation,
     }
     
     // Get new counts.
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmersCorrection);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmersCorrection);
     
     bool highToLow = isHighToLow(kmersInitial, kmerLocation);
     int kmersImproved;
@@ -318,13 +319,13 @@ bool correctErrorAtLocationInsertion(struct Sequence* sequence,
     unsigned int kmersCorrection[total - 1];    // Original with deletion. (-1)
     
     // Get initial counts.
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmersInitial);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmersInitial);
     
     // Delete:
     deleteBase(sequence, sequenceLocation);    
     
     // Get new counts.
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmersCorrection);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmersCorrection);
     
     bool highToLow = isHighToLow(kmersInitial, kmerLocation);
     int kmersImproved;
@@ -383,7 +384,7 @@ void findKMerDiscrepancies(struct Sequence* sequence,
     // K-mers.
     int total = sequence->length - kmerSize + 1;
     unsigned int kmerCounts[total];
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmerCounts);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerCounts);
     
     // Analyze possible discrepancies
     for(int i = 0; i < total - 1; i++)
@@ -409,7 +410,7 @@ double getAverageKMerCount(struct Sequence* sequence,
     // K-mers:
     int total = sequence->length - kmerSize + 1;
     unsigned int kmerCounts[total];
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmerCounts);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerCounts);
     
     // Averaged k-mers:
     for(int i = start; i < end; i++)
@@ -438,7 +439,7 @@ bool correctErrorAtLocationHomopolymer(struct Sequence* sequence,
     // K-mers:
     int total = sequence->length - kmerSize + 1;
     unsigned int kmerCounts[total];
-    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerSize, kmerCounts);
+    getKMerCounts(sequence->sequence, sequence->length, kmers, kmerCounts);
     
     int sequenceLocation = getSequenceLocation(sequence, kmerLocation, kmers, kmerSize);
     char newQuality = getAverageQuality(sequence, sequenceLocation - 1, sequenceLocation + 1);  //TODO: THIS SHOULD BE TEMP
@@ -717,19 +718,19 @@ void recordHomopolymerSize(int size)
 {
     if(size > HOMOPOLYMER_SIZE_RANGE)
     {
-        homopolymerSize[HOMOPOLYMER_SIZE_RANGE * 2 + 1]++;
+        __sync_fetch_and_add(&homopolymerSize[HOMOPOLYMER_SIZE_RANGE * 2 + 1], 1);
     }
     else if(size < -HOMOPOLYMER_SIZE_RANGE)
     {
-        homopolymerSize[0]++;
+        __sync_fetch_and_add(&homopolymerSize[0], 1);
     }
     else if(size > 0)
     {
-        homopolymerSize[HOMOPOLYMER_SIZE_RANGE + size]++;
+        __sync_fetch_and_add(&homopolymerSize[HOMOPOLYMER_SIZE_RANGE + size], 1);
     }
     else if(size < 0)
     {
-        homopolymerSize[(HOMOPOLYMER_SIZE_RANGE + 1) + size]++;
+        __sync_fetch_and_add(&homopolymerSize[(HOMOPOLYMER_SIZE_RANGE + 1) + size], 1);
     }
     else
     {
@@ -739,11 +740,17 @@ void recordHomopolymerSize(int size)
 
 void applyCorrection(struct Sequence* sequence, struct read* read)
 {
-    free(read->sequence);
+    // The sequence in the arena and the quality read from the file are not 
+    // freed:
+    if(read->corrected)
+    {
+        free(read->sequence);
+        free(read->quality);
+    }
+    
     read->sequence = sequence->sequence;      // NOT QUITE CORRECT!
-
-    free(read->quality);
     read->quality = sequence->quality;
+    read->corrected = 1;
 
     read->length = sequence->length;
 
@@ -752,12 +759,12 @@ void applyCorrection(struct Sequence* sequence, struct read* read)
     {
         switch(sequence->corrections[i])
         {
-            case 'S': substitutionErrors++; break;
-            case 'I': insertionErrors++; break;
-            case 'D': deletionErrors++; break;
+            case 'S': __sync_fetch_and_add(&substitutionErrors, 1); break;
+            case 'I': __sync_fetch_and_add(&insertionErrors, 1); break;
+            case 'D': __sync_fetch_and_add(&deletionErrors, 1); break;
             
             // Homopolymers:
-            case 'H':  homopolymerErrors++;
+            case 'H':  __sync_fetch_and_add(&homopolymerErrors, 1);
                        recordHomopolymerSize(sequence->homopolymerSize[i]);
                        break;
         }
@@ -765,7 +772,7 @@ void applyCorrection(struct Sequence* sequence, struct read* read)
 
     if(sequence->numCorrections > 1)
     {
-        multipleErrors++;
+        __sync_fetch_and_add(&multipleErrors, 1);
     }
     
     free(sequence->corrections);
@@ -818,7 +825,7 @@ bool isHighQuality(struct read* read, Correction* correction)
     double numUniqueKMers = 0;
     
     unsigned int kmerCounts[total];
-    getKMerCounts(read->sequence, read->length, kmers, kmerSize, kmerCounts);
+    getKMerCounts(read->sequence, read->length, kmers, kmerCounts);
     
     // Scan k-mers:
     for(int i = 0; i < total; i++)
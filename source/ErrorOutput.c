@@ -31,17 +31,15 @@ void writeKMerCounts(FILE* output,
         unsigned long long int* sequence, unsigned int length,
         KMerHashTable* kmers,  unsigned int kmerSize)
 {
-    unsigned long long int kmer;
-    unsigned long long int count;
+    int total = (int)length - (int)kmerSize + 1;
+    unsigned int counts[total > 0 ? total : 1];
+    
+    getKMerCounts(sequence, length, kmers, counts);
     
     // Iterate over all k-mers within the read:
-    for(int j = 0; j <= (int)length - (int)kmerSize; j++)
+    for(int j = 0; j < total; j++)
     {
-        // Get the next k-mer:
-        kmer = getKMer(sequence, j, j + kmerSize);
-        count = KMerTableLookup(kmers, kmer);
-        
-        fprintf(output, "%2llu ", count % 100);
+        fprintf(output, "%2u ", counts[j] % 100);
     }     
 }
 
@@ -69,14 +67,14 @@ void outputKMerCounts(FILE* output,
 
             readLength = current->length;
             sequence = current->sequence;
+            
+            unsigned int counts[readLength > 0 ? readLength : 1];
+            getKMerCounts(sequence, readLength, kmers, counts);
 
             // Iterate over all k-mers within the read:
             for(int j = 0; j <= (int)readLength - (int)kmerSize; j++)
             {
-                // Get the next k-mer:
-                kmer = getKMer(sequence, j, j + kmerSize);
-
-                count = KMerTableLookup(kmers, kmer);
+                count = counts[j];
 
                 // Safety check for existence of k-mer:
                 // Exists:
@@ -87,6 +85,8 @@ void outputKMerCounts(FILE* output,
                 // Doesn't exist -- ERROR:
                 else
                 {
+                    kmer = getKMer(sequence, j, j + kmerSize);
+                    
                     fprintf(output, "\nERROR - KMER NOT RECOGNIZED!\n");
                     fprintf(output, "%llu\n", kmer);
                     writeAsNucleotides(output, &kmer, 0, kmerSize);
@@ -115,9 +115,9 @@ void outputKMerCounts(FILE* output,
 
 void outputRead(FILE* output, struct read* read)
 {
-    fprintf(output, "%s", read->seqName1);
+    fwrite(read->seqName1, 1, read->seqName1Length, output);
     writeAsNucleotides(output, read->sequence, 0, read->length); fprintf(output, "\n"); 
-    fprintf(output, "%s", read->seqName2);
+    fwrite(read->seqName2, 1, read->seqName2Length, output);
     fprintf(output, "%s\n", read->quality);
 }
 
@@ -134,9 +134,9 @@ void outputReads(FILE* output, Reads* reads)
 
 void outputReadFASTK(FILE* output, struct read* read, KMerHashTable* kmers, unsigned int kmerSize)
 {
-    fprintf(output, "%s", read->seqName1);
+    fwrite(read->seqName1, 1, read->seqName1Length, output);
     writeAsNucleotides(output, read->sequence, 0, read->length); fprintf(output, "\n"); 
-    fprintf(output, "%s", read->seqName2);
+    fwrite(read->seqName2, 1, read->seqName2Length, output);
     fprintf(output, "%s\n", read->quality);
     
     // Is the read long enough to have k-mers of this size?
@@ -153,7 +153,7 @@ void outputReadFASTK(FILE* output, struct read* read, KMerHashTable* kmers, unsi
         unsigned int readKMers[total];
 
         // Get kmer counts.
-        getKMerCounts(read->sequence, read->length, kmers, kmerSize, readKMers);
+        getKMerCounts(read->sequence, read->length, kmers, readKMers);
 
         for(int i = 0; i < total; i++)
         {
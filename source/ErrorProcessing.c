@@ -26,6 +26,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "ErrorCorrection.h"
 #include "Reads.h"
 #include "Correction.h"
+#include "KMerPartitions.h"
+#include "KMerIndex.h"
+#include "Memory.h"
+#include "Counting.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,39 +38,183 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
 
 unsigned int KMER_SIZE = 31;
+unsigned int NUM_THREADS = 1;
+unsigned long long int MAX_MEMORY = 0;    // Bytes, or 0 for no limit.
+unsigned long long int FILTER_SIZE = 0;   // Bytes, or 0 for no Bloom filter.
+char* SAVE_KMERS = NULL;                  // K-mer index to write, if any.
+char* LOAD_KMERS = NULL;                  // K-mer index to read, if any.
+char* EXTEND_KMERS = NULL;                // K-mer index to count more reads into, if any.
+bool FREEZE_KMERS = false;                // Perfect hash the k-mers once counted.
+enum KMER_TABLE_ENGINE KMER_ENGINE = KMER_ENGINE_HASH;
+enum KMER_HASH_FUNCTION HASH_FUNCTION = KMER_HASH_MURMUR;
+enum KMER_SLOT_REDUCTION SLOT_REDUCTION = KMER_SLOT_MASK;
+unsigned int REMAINDER_BITS = KMER_QUOTIENT_DEFAULT_REMAINDER_BITS;
+enum HUGE_PAGE_MODE HUGE_PAGES = HUGE_PAGES_TRANSPARENT;
+enum NUMA_POLICY NUMA_PLACEMENT = NUMA_OFF;   // Of the frozen k-mers, for correction.
 
 const int LEFT = 0;
 const int RIGHT = 1;
 
-static inline void printProgress(int x, int n, int r)
+/* Prints the percentage of the file read so far whenever it passes another 
+ * multiple of 100/r percent. Returns the number of multiples printed, to be 
+ * given back as printed on the next call. */
+static inline int printReadsProgress(Reads* reads, int printed, int r)
 {
-    // Only update r times.
-    if (n/r == 0 || x % (n/r) != 0) return; // Mod 0 causes problems.
+    unsigned long long int size = readsGetSize(reads);
+    int passed = (size == 0) ? r : (int)(readsGetPosition(reads) * r / size);
     
-    double result;
+    for(; printed <= passed; printed++)
+    {
+        printf("%d%% ", printed * (100 / r));
+    }
     
-    if(n / r != 1)
-        result = x / (n/r) * (100/r);
-    else
-        result = (x + 1) / ((double)n/(double)r) * ((double)100/(double)r);
- 
-    printf("%d%% ", (int)result);
     fflush(stdout);
+    
+    return printed;
 }
 
 void hashSequence(unsigned long long int* sequence, unsigned int sequenceLength,
         KMerHashTable* kmers, unsigned int kmerSize)
 {
-    unsigned long long int* reverse;
-    
+    // Canonical k-mers account for both strands:
     addKMersToTable(kmers, sequence, sequenceLength, kmerSize);
+}
+
+// A slice of a batch of reads, hashed by one thread:
+typedef struct
+{
+    struct read* reads;
+    int start;
+    int end;
+    
+    KMerHashTableBuffer* buffer;
+} HashingThread;
+
+void* hashReadsThread(void* arg)
+{
+    HashingThread* thread = (HashingThread*)arg;
+    
+    for(int i = thread->start; i < thread->end; i++)
+    {
+        KMerBufferAddSequence(thread->buffer, thread->reads[i].sequence, thread->reads[i].length);
+    }
+    
+    KMerBufferFlush(thread->buffer);
+    
+    return NULL;
+}
 
-    reverse = createReverseCompliment(sequence, sequenceLength);       
-    addKMersToTable(kmers, reverse, sequenceLength, kmerSize);
+void hashBatch(struct read* batch, int count, KMerHashTable* kmers, 
+        unsigned int kmerSize, HashingThread* threads, unsigned int numThreads)
+{
+    pthread_t handles[numThreads];
+    
+    // Single threaded:
+    if(numThreads <= 1)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            hashSequence(batch[i].sequence, batch[i].length, kmers, kmerSize);
+        }
+        
+        return;
+    }
+    
+    // Multithreaded: each thread hashes a contiguous slice of the batch.
+    for(int t = 0; t < numThreads; t++)
+    {
+        threads[t].reads = batch;
+        threads[t].start = (int)((long long int)count * t / numThreads);
+        threads[t].end = (int)((long long int)count * (t + 1) / numThreads);
+        
+        pthread_create(&handles[t], NULL, hashReadsThread, &threads[t]);
+    }
+    
+    for(int t = 0; t < numThreads; t++)
+    {
+        pthread_join(handles[t], NULL);
+    }
+}
+
+/* Returns an upper bound on the number of distinct k-mers in the reads file. 
+ * Without an estimate, every base of a FASTQ record, which is accompanied by a 
+ * quality score, is assumed to start a new k-mer. */
+static unsigned long long int estimateNumKMers(Reads* reads)
+{
+    struct stat st = {0};
+    
+    if(reads->distinctKMers > 0)
+    {
+        return reads->distinctKMers + reads->distinctKMers / 50;
+    }
+    
+    if(stat(readsGetFileName(reads), &st) != 0)
+    {
+        return 0;
+    }
+    
+    return (unsigned long long int)st.st_size / 2;
+}
+
+/* Returns an upper bound on the number of k-mers in the reads file that are 
+ * seen more than once, and so are kept by pruning. */
+static unsigned long long int estimateNumKeptKMers(Reads* reads)
+{
+    if(reads->distinctKMers > 0)
+    {
+        return reads->repeatedKMers + reads->repeatedKMers / 50;
+    }
     
-    free(reverse);
+    // Each of them takes at least two of the k-mers:
+    return estimateNumKMers(reads) / 2;
+}
+
+/* Returns an upper bound on the number of bases in the reads file, and so on 
+ * the number of k-mers counted from it. */
+static unsigned long long int estimateNumBases(Reads* reads)
+{
+    if(reads->numBases > 0)
+    {
+        return reads->numBases + reads->numBases / 50;
+    }
+    
+    return estimateNumKMers(reads);
+}
+
+/* Spills the k-mers of a batch of reads to the partitions, to be counted once 
+ * every file has been read. */
+void spillBatch(struct read* batch, int count, KMerPartitions* partitions)
+{
+    for(int i = 0; i < count; i++)
+    {
+        KMerPartitionsAddSequence(partitions, batch[i].sequence, batch[i].length);
+    }
+}
+
+/* Counts the k-mers spilled to the partitions, pruning each partition once it 
+ * is counted, and sets the low k-mer threshold of the correction. */
+void preprocessPartitions(Correction* correction, KMerPartitions* partitions)
+{
+    unsigned long long int histogram[KMER_HISTOGRAM_SIZE];
+    unsigned long long int unique = 0;
+    unsigned long long int total = 0;
+    
+    // Initialize Counts:
+    for (int i = 0; i < KMER_HISTOGRAM_SIZE; i++)
+    {
+        histogram[i] = 0;
+    }
+    
+    if(!KMerPartitionsCount(partitions, histogram, &unique, &total))
+    {
+        exit(1);
+    }
+    
+    finishPreprocessingKMers(histogram, unique, total, correction);
 }
 
 void hashReads(Correction* correction)
@@ -74,15 +222,101 @@ void hashReads(Correction* correction)
     // Reads:
     Reads** reads = correctionGetReads(correction);
     unsigned int numReadSets = correctionGetNumReadSets(correction);
-    struct read* current;
-    
-    // Read:
-    unsigned long long int* sequence;
-    unsigned int length;
+    struct read* batch;
+    int count;
+    int printed;
     
     // KMers:
     KMerHashTable* kmers = correctionGetKMers(correction);
     unsigned int kmerSize = correctionGetKMerSize(correction);
+    KMerPartitions* partitions = NULL;      // Or NULL to count directly.
+    unsigned int numPartitions;
+    unsigned long long int numKMers = 0;
+    unsigned long long int numKept = 0;
+    unsigned long long int numOccurrences = 0;
+    unsigned long long int used;
+    unsigned long long int distinct = 0;
+    unsigned long long int repeated = 0;
+    KMerStatistics* statistics;
+    
+    // Threads:
+    HashingThread threads[NUM_THREADS];
+    
+    // Memory limit, less what is already allocated, the hashing buffers, the 
+    // k-mers pruned for an index and the reads of every file, which are kept 
+    // until correction is done. Every file is counted the same way, so that 
+    // all of their k-mers are pruned together:
+    if(MAX_MEMORY > 0)
+    {
+        used = getMemoryUsed() + ((NUM_THREADS > 1) ? NUM_THREADS * KMerBufferGetMemory(kmers) : 0);
+        
+        for(int file = 0; file < numReadSets; file++)
+        {
+            used += readsGetMemory(reads[file]);
+            numKMers += estimateNumKMers(reads[file]);
+            numKept += estimateNumKeptKMers(reads[file]);
+            numOccurrences += estimateNumBases(reads[file]);
+        }
+        
+        // The k-mers seen once, kept until they are saved:
+        if(kmers->keepPruned && numKMers > numKept)
+        {
+            used += KMER_TABLE_NUM_SHARDS * getAllocationSize(
+                    (numKMers - numKept) / KMER_TABLE_NUM_SHARDS * sizeof(unsigned long long int));
+        }
+        
+        if(used >= MAX_MEMORY)
+        {
+            printf("ERROR: Reading the files needs %llu bytes, more than the memory limit of %llu bytes.\n",
+                    used, MAX_MEMORY);
+            printf("A smaller batch size (-b) needs less.\n");
+            exit(1);
+        }
+        
+        numPartitions = getNumKMerPartitions(numKMers, numKept, numOccurrences, MAX_MEMORY - used);
+        
+        if(numPartitions == 0)
+        {
+            printf("ERROR: Counting the k-mers needs more than the memory limit of %llu bytes.\n",
+                    MAX_MEMORY);
+            exit(1);
+        }
+        
+        // The k-mers do not fit in memory:
+        if(numPartitions > 1)
+        {
+            partitions = newKMerPartitions(kmers, numPartitions, correctionGetOutputDirectory(correction));
+            
+            if(partitions == NULL)
+            {
+                printf("CRITICAL: FAILED TO CREATE K-MER PARTITIONS!\n");
+                exit(1);
+            }
+            
+            printf("Spilling k-mers to %u partitions.\n\n", numPartitions);
+        }
+    }
+    
+    for(int t = 0; t < NUM_THREADS && NUM_THREADS > 1; t++)
+    {
+        threads[t].buffer = newKMerHashTableBuffer(kmers);
+    }
+    
+    // A quotient filter loses precision as it grows, so it is sized for every 
+    // file up front:
+    if(kmers->engine == KMER_ENGINE_QUOTIENT)
+    {
+        for(int file = 0; file < numReadSets; file++)
+        {
+            distinct += reads[file]->distinctKMers;
+            repeated += reads[file]->repeatedKMers;
+        }
+        
+        if(!KMerTableReserve(kmers, distinct, repeated))
+        {
+            exit(1);
+        }
+    }
     
     // Iterate over all files:    
     for(int file = 0; file < numReadSets; file++)
@@ -91,24 +325,61 @@ void hashReads(Correction* correction)
         
         readsReset(reads[file]);
         
-        // Iterate over all reads:
-        for(int i = 0; readsHasNext(reads[file]); i++)
-        {            
-            printProgress(i, readsGetCount(reads[file]), 20);
-            
-            current = readsGetNext(reads[file]);  
-            sequence = current->sequence;
-            length = current->length;
-
-            hashSequence(sequence, length, kmers, kmerSize);
+        // Size the table for the whole file:
+        if(partitions == NULL && reads[file]->distinctKMers > 0 && kmers->engine != KMER_ENGINE_QUOTIENT &&
+                !KMerTableReserve(kmers, reads[file]->distinctKMers, reads[file]->repeatedKMers))
+        {
+            exit(1);
         }
         
-        printf("\n");
+        printed = 0;
+        
+        // Iterate over all batches of reads:
+        while(readsHasNext(reads[file]))
+        {
+            count = readsGetNextBatch(reads[file], &batch);
+            printed = printReadsProgress(reads[file], printed, 20);
+            
+            if(partitions != NULL)
+            {
+                spillBatch(batch, count, partitions);
+            }
+            else
+            {
+                hashBatch(batch, count, kmers, kmerSize, threads, NUM_THREADS);
+            }
+        }
         
-        printf("Preprocessing k-mers...\n");
-        preprocessKMers(kmers, correction);
-        printf("Finished preprocessing k-mers!\n\n");
+        printf("\n\n");
+    }
+    
+    for(int t = 0; t < NUM_THREADS && NUM_THREADS > 1; t++)
+    {
+        freeKMerHashTableBuffer(threads[t].buffer);
+    }
+    
+    // Prune once every file is counted, so that a k-mer seen once in each of 
+    // two files is kept:
+    printf("Preprocessing k-mers...\n");
+    
+    if(partitions != NULL)
+    {
+        preprocessPartitions(correction, partitions);
+        freeKMerPartitions(partitions);
+    }
+    else
+    {
+        preprocessKMers(kmers, correction, NUM_THREADS);
     }
+    
+    printf("Finished preprocessing k-mers!\n\n");
+    
+    // K-Mer Spectrum:
+    statistics = KMerTableGetStatistics(kmers, NUM_THREADS);
+    
+    printf("Kept %llu distinct k-mers, seen %llu times in total.\n", 
+            statistics->distinct, statistics->total);
+    printf("The highest k-mer count was %llu.\n\n", statistics->maxCount);
 }
 
 void checkDirectoryExistsAndCreate(char* directory)
@@ -124,6 +395,177 @@ void checkDirectoryExistsAndCreate(char* directory)
 	}
 }
 
+// A slice of a batch of reads, corrected by one thread:
+typedef struct
+{
+    struct read* reads;
+    int start;
+    int end;
+    
+    Correction correction;                  // With the k-mers for its node.
+    int node;                               // The node it runs on, or -1.
+} CorrectionThread;
+
+/* Gives each correction thread a node and the k-mers it looks up, placing the 
+ * frozen k-mers as the NUMA policy says. The k-mers of each node are reported 
+ * with the fraction of its lookups expected to read local memory. Copies of the 
+ * k-mers are kept in replicas, one per node, to be released once correction is 
+ * done. */
+void placeKMers(Correction* correction, CorrectionThread* threads, unsigned int numThreads,
+        KMerHashTable** replicas)
+{
+    const char* policyNames[] = {"off", "first-touch", "interleave", "replicate"};
+    
+    KMerHashTable* kmers = correctionGetKMers(correction);
+    KMerHashTable* nodeKMers;
+    enum NUMA_POLICY policy = NUMA_PLACEMENT;
+    unsigned int numNodes = getNumNodes();
+    unsigned int nodeThreads;
+    double locality;
+    
+    for(int node = 0; node < NUMA_MAX_NODES; node++)
+    {
+        replicas[node] = NULL;
+    }
+    
+    if(policy != NUMA_OFF && kmers->engine != KMER_ENGINE_PERFECT)
+    {
+        printf("WARNING: Only frozen k-mers can be placed; leaving them where they are.\n");
+        policy = NUMA_FIRST_TOUCH;
+    }
+    
+    if(policy == NUMA_INTERLEAVE_PAGES && !KMerTablePlace(kmers, NUMA_INTERLEAVE))
+    {
+        printf("WARNING: Could not interleave the k-mers.\n");
+    }
+    
+    // The k-mers themselves serve the first node:
+    if(policy == NUMA_REPLICATE)
+    {
+        if(!KMerTablePlace(kmers, 0))
+        {
+            printf("WARNING: Could not move the k-mers to the first node.\n");
+        }
+        
+        replicas[0] = kmers;
+        
+        for(unsigned int node = 1; node < numNodes; node++)
+        {
+            if((replicas[node] = KMerTableReplicate(kmers, node)) == NULL)
+            {
+                printf("CRITICAL: FAILED TO REPLICATE K-MERS!\n");
+                exit(1);
+            }
+        }
+    }
+    
+    // Threads are spread evenly over the nodes:
+    for(unsigned int t = 0; t < numThreads; t++)
+    {
+        threads[t].correction = *correction;
+        threads[t].node = (policy == NUMA_OFF) ? -1 : (int)(t % numNodes);
+        
+        if(policy == NUMA_REPLICATE)
+        {
+            threads[t].correction.kmers = replicas[t % numNodes];
+        }
+    }
+    
+    if(policy == NUMA_OFF)
+    {
+        return;
+    }
+    
+    // A single thread corrects on the main thread:
+    if(numThreads == 1)
+    {
+        pinThreadToNode(0);
+    }
+    
+    printf("NUMA placement of the k-mers: %s, over %u node(s).\n", policyNames[policy], numNodes);
+    
+    for(unsigned int node = 0; node < numNodes && node < numThreads; node++)
+    {
+        nodeThreads = numThreads / numNodes + (node < numThreads % numNodes);
+        nodeKMers = (policy == NUMA_REPLICATE) ? replicas[node] : kmers;
+        locality = KMerTableGetLocality(nodeKMers, node);
+        
+        if(locality < 0)
+        {
+            printf("Node %u: %u thread(s), local lookups unknown.\n", node, nodeThreads);
+        }
+        else
+        {
+            printf("Node %u: %u thread(s), %.1f%% of lookups local, %.1f%% remote.\n", 
+                    node, nodeThreads, 100 * locality, 100 * (1 - locality));
+        }
+    }
+    
+    printf("\n");
+}
+
+void releaseKMerReplicas(KMerHashTable** replicas)
+{
+    // The first node used the k-mers themselves:
+    for(int node = 1; node < NUMA_MAX_NODES; node++)
+    {
+        if(replicas[node] != NULL)
+        {
+            freeKMerHashTable(replicas[node]);
+        }
+    }
+}
+
+void* correctReadsThread(void* arg)
+{
+    CorrectionThread* thread = (CorrectionThread*)arg;
+    CorrectionFunction correctionFunction = correctionGetFunction(&(thread->correction));
+    
+    if(thread->node >= 0)
+    {
+        pinThreadToNode(thread->node);
+    }
+    
+    for(int i = thread->start; i < thread->end; i++)
+    {
+        correctionFunction(&(thread->reads[i]), &(thread->correction));
+    }
+    
+    return NULL;
+}
+
+void correctBatch(struct read* batch, int count, CorrectionThread* threads, unsigned int numThreads)
+{
+    pthread_t handles[numThreads];
+    CorrectionFunction correctionFunction = correctionGetFunction(&(threads[0].correction));
+    
+    // Single threaded:
+    if(numThreads <= 1)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            correctionFunction(&batch[i], &(threads[0].correction));
+        }
+        
+        return;
+    }
+    
+    // Multithreaded: each thread corrects a contiguous slice of the batch.
+    for(int t = 0; t < numThreads; t++)
+    {
+        threads[t].reads = batch;
+        threads[t].start = (int)((long long int)count * t / numThreads);
+        threads[t].end = (int)((long long int)count * (t + 1) / numThreads);
+        
+        pthread_create(&handles[t], NULL, correctReadsThread, &threads[t]);
+    }
+    
+    for(int t = 0; t < numThreads; t++)
+    {
+        pthread_join(handles[t], NULL);
+    }
+}
+
 void executePairedCorrection(Correction* correction,
         FILE* leftCorrectedFile, FILE* rightCorrectedFile, 
         FILE* leftGarbageFile, FILE* rightGarbageFile, FILE* extraFile)
@@ -134,8 +576,7 @@ void executePairedCorrection(Correction* correction,
     // Correction Function:
     CorrectionFunction correctionFunction = correctionGetFunction(correction);
     
-    int maxReads = getMax(readsGetCount(reads[LEFT]), readsGetCount(reads[RIGHT]));
-    int current = 0;
+    int printed = 0;
     
     printf("Correcting paired files.\n");
 
@@ -158,8 +599,7 @@ void executePairedCorrection(Correction* correction,
     
     while(readsHasNext(reads[LEFT]) && readsHasNext(reads[RIGHT]))
     {   
-        printProgress(current, maxReads, 20);
-        current++;
+        printed = printReadsProgress(reads[LEFT], printed, 20);
 
         // The current pair matches.
         // This is to accommodate read filtering which might have been done at
@@ -233,9 +673,13 @@ int processSimpleCorrection(Correction* correction)
     // Reads:
     Reads** reads = correctionGetReads(correction);
     unsigned int numReadSets = correctionGetNumReadSets(correction);
+    struct read* batch;
+    int count;
+    int printed;
     
-    // Correction Function:
-    CorrectionFunction correctionFunction = correctionGetFunction(correction);
+    // Threads:
+    CorrectionThread threads[NUM_THREADS];
+    KMerHashTable* replicas[NUMA_MAX_NODES];
     
     // Files:
     char correctedFileName[1024];
@@ -246,6 +690,8 @@ int processSimpleCorrection(Correction* correction)
     char* outputDirectory = correctionGetOutputDirectory(correction);
     char baseName[1024];
     
+    placeKMers(correction, threads, NUM_THREADS, replicas);
+    
     // Iterate over all files:
     for(int file = 0; file < numReadSets; file++)
     {
@@ -293,25 +739,29 @@ int processSimpleCorrection(Correction* correction)
         
         readsReset(reads[file]);
         
-        // Iterate over all reads:
-        for(int i = 0; readsHasNext(reads[file]); i++)
-        {            
-            printProgress(i, readsGetCount(reads[file]), 20);
-            
-            struct read* current = readsGetNext(reads[file]);
+        printed = 0;
+        
+        // Iterate over all batches of reads:
+        while(readsHasNext(reads[file]))
+        {
+            count = readsGetNextBatch(reads[file], &batch);
+            printed = printReadsProgress(reads[file], printed, 20);
             
             // Correction:
-            correctionFunction(current, correction);
+            correctBatch(batch, count, threads, NUM_THREADS);
             
-            // Output:
-            if (current->type != BAD || correction->filtering == false)
+            // Output, in the order of the reads:
+            for(int j = 0; j < count; j++)
             {
-                outputRead(correctedFile, current);
+                if (batch[j].type != BAD || correction->filtering == false)
+                {
+                    outputRead(correctedFile, &batch[j]);
+                }
+                else
+                {
+                    outputRead(garbageFile, &batch[j]);
+                }
             }
-            else
-            {
-                outputRead(garbageFile, current);
-            }             
         }
         
         // Close file:
@@ -325,7 +775,9 @@ int processSimpleCorrection(Correction* correction)
         printf("\n");
         printCorrectionResults();
         printf("\n");
-    }     
+    }
+    
+    releaseKMerReplicas(replicas);
 }
 
 void processPairedCorrection(Correction* correction)
@@ -345,6 +797,9 @@ void processPairedCorrection(Correction* correction)
     FILE* rightGarbageFile;
     FILE* extraFile;
     
+    CorrectionThread thread[1];
+    KMerHashTable* replicas[NUMA_MAX_NODES];
+    
     Reads** reads = correctionGetReads(correction);
     
     // Left Corrected:
@@ -399,8 +854,13 @@ void processPairedCorrection(Correction* correction)
     strcat(extraFileName, "/extra.corrected");
     extraFile = fopen(extraFileName, "w");
 
-    executePairedCorrection(correction, leftCorrectedFile, rightCorrectedFile, 
+    // Paired reads are corrected by a single thread:
+    placeKMers(correction, thread, 1, replicas);
+    
+    executePairedCorrection(&(thread[0].correction), leftCorrectedFile, rightCorrectedFile, 
             leftGarbageFile, rightGarbageFile, extraFile);
+    
+    releaseKMerReplicas(replicas);
 
     // Close files:
     fclose(leftCorrectedFile);
@@ -418,11 +878,82 @@ void processPairedCorrection(Correction* correction)
 Correction* preprocessing(int numInputFiles, char* inputFileNames, char* outputDirectory) 
 {
     unsigned int LOW_COVERAGE_THRESHOLD_DEFAULT = 3;
+    unsigned int lowKMerThreshold = LOW_COVERAGE_THRESHOLD_DEFAULT;
+    unsigned int replacement;
+    char* indexFileName;
 
 	// DATA STRUCTURES:
-	KMerHashTable* kmers = newKMerHashTable();
+	KMerHashTable* kmers;
 	Reads** reads = (Reads**)malloc(sizeof(Reads*) * numInputFiles);
 	Correction* correction = (Correction*)malloc(sizeof(Correction));
+	KMerSketch* sketch = NULL;
+    
+    // MEMORY:
+    setMemoryLimit(MAX_MEMORY);
+    setHugePageMode(HUGE_PAGES);
+
+    // SAVED K-MERS:
+    if(LOAD_KMERS != NULL)
+    {
+        printf("Loading k-mers: %s\n", LOAD_KMERS);
+        
+        if((kmers = loadKMerIndex(LOAD_KMERS, &lowKMerThreshold, &replacement)) == NULL)
+        {
+            exit(1);
+        }
+        
+        // Replace N's as if the reads had been counted:
+        NUCLEOTIDE = replacement;
+        
+        KMER_SIZE = kmers->kmerSize;
+        printf("Loaded %llu k-mers of size %d.\n\n", KMerTableNumEntries(kmers), KMER_SIZE);
+    }
+    // K-MERS TO EXTEND:
+    else if(EXTEND_KMERS != NULL)
+    {
+        printf("Extending k-mers: %s\n", EXTEND_KMERS);
+        
+        if((kmers = readKMerIndex(EXTEND_KMERS, &lowKMerThreshold, &replacement)) == NULL)
+        {
+            exit(1);
+        }
+        
+        // Replace N's as if the earlier reads had just been counted:
+        NUCLEOTIDE = replacement;
+        
+        KMER_SIZE = kmers->kmerSize;
+        sketch = newKMerSketch(KMER_SIZE);
+        printf("Read %llu k-mers of size %d.\n\n", KMerTableNumEntries(kmers), KMER_SIZE);
+    }
+    else
+    {
+        kmers = newKMerTable(KMER_SIZE, KMER_ENGINE);
+        
+        // The sketch only holds k-mers that fit in 64 bits:
+        if(KMER_SIZE <= KMER_NARROW_MAX_SIZE)
+        {
+            sketch = newKMerSketch(KMER_SIZE);
+        }
+        
+        if(KMER_ENGINE != KMER_ENGINE_SORT && !KMerTableSetHash(kmers, HASH_FUNCTION, SLOT_REDUCTION))
+        {
+            printf("CRITICAL: HASH FUNCTION %s IS NOT SUPPORTED!\n", getKMerHashName(HASH_FUNCTION));
+            exit(1);
+        }
+        
+        if(KMER_ENGINE == KMER_ENGINE_QUOTIENT && !KMerTableSetRemainderBits(kmers, REMAINDER_BITS))
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE QUOTIENT FILTER!\n");
+            exit(1);
+        }
+        
+        // SINGLETON FILTER:
+        if(FILTER_SIZE > 0 && !KMerTableSetFilter(kmers, FILTER_SIZE))
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE BLOOM FILTER!\n");
+            exit(1);
+        }
+    }
 
 	// OUTPUT DIRECTORY:
 	checkDirectoryExistsAndCreate(outputDirectory);
@@ -434,19 +965,73 @@ Correction* preprocessing(int numInputFiles, char* inputFileNames, char* outputD
         char* inputFileName = &(inputFileNames[i * 200]);
         printf("Reading file: %s\n", inputFileName);
         
-        reads[i] = createReads(inputFileName);
+        reads[i] = createReads(inputFileName, sketch, NUM_THREADS);
+        
+        if(reads[i] != 0 && sketch != NULL)
+        {
+            printf("Estimated %llu distinct k-mers, %llu of them repeated.\n", 
+                    reads[i]->distinctKMers, reads[i]->repeatedKMers);
+        }
     }    
+    
+    if(sketch != NULL)
+    {
+        freeKMerSketch(sketch);
+    }
+    
     printf("Finished creating read objects!\n\n");    
 
     // META OBJECT:
     correction = createCorrection(reads, numInputFiles, 
-            kmers, KMER_SIZE, LOW_COVERAGE_THRESHOLD_DEFAULT,
+            kmers, KMER_SIZE, lowKMerThreshold,
             outputDirectory, NULL);
     
+    if(LOAD_KMERS != NULL)
+    {
+        return correction;
+    }
+    
+    // Keep the k-mers seen once, so that the index can be extended:
+    if(SAVE_KMERS != NULL || EXTEND_KMERS != NULL)
+    {
+        KMerTableKeepPruned(kmers, 1);
+    }
+    
     // CONSTRUCT KMERS:
     printf("Constructing k-mers...\n");       
     hashReads(correction);
-    printf("Finished constructing k-mers!\n\n");
+    printf("Finished constructing k-mers!\n");
+    printf("Peak memory for k-mers and reads: %llu bytes.\n\n", getMemoryPeak());
+    
+    // SAVE KMERS, writing an extended index back unless told otherwise:
+    if(SAVE_KMERS != NULL || EXTEND_KMERS != NULL)
+    {
+        indexFileName = (SAVE_KMERS != NULL) ? SAVE_KMERS : EXTEND_KMERS;
+        printf("Saving k-mers: %s\n", indexFileName);
+        
+        if(!saveKMerIndex(kmers, indexFileName, correction->lowKMerThreshold, NUCLEOTIDE))
+        {
+            exit(1);
+        }
+        
+        KMerTableKeepPruned(kmers, 0);
+        
+        printf("Finished saving k-mers!\n\n");
+    }
+    
+    // FREEZE KMERS:
+    if(FREEZE_KMERS)
+    {
+        printf("Freezing k-mers...\n");
+        
+        if(!KMerTableFreeze(kmers))
+        {
+            printf("CRITICAL: FAILED TO FREEZE K-MERS!\n");
+            exit(1);
+        }
+        
+        printf("Froze k-mers into %llu bytes.\n\n", KMerTableGetMemory(kmers));
+    }
     
     return correction;
 }
@@ -498,6 +1083,195 @@ int convertFASTQToFASTK(int numInputFiles, char* inputFileNames, char* outputDir
     }
 }
 
+/* Prints the share of the k-mers found within the range of probe lengths. */
+static void printProbeShare(unsigned long long int* histogram, unsigned int first,
+        unsigned int last, unsigned long long int entries)
+{
+    unsigned long long int found = 0;
+    
+    for(unsigned int i = first; i <= last && i < KMER_PROBE_HISTOGRAM_SIZE; i++)
+    {
+        found += histogram[i];
+    }
+    
+    printf(" %6.2f%%", entries > 0 ? 100.0 * found / entries : 0.0);
+}
+
+static double getSeconds(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Counts every k-mer of the reads into a new table placed with the given hash, 
+ * then looks up every k-mer of the reads again. The time taken by each pass is 
+ * returned, and the probe lengths of the table are tallied in the histogram. */
+static void benchmarkHashFunction(Reads** reads, int numInputFiles, 
+        enum KMER_HASH_FUNCTION function, enum KMER_SLOT_REDUCTION reduction,
+        double* countSeconds, double* lookupSeconds, unsigned long long int* histogram)
+{
+    KMerHashTable* kmers = newKMerHashTable(KMER_SIZE);
+    struct read* batch;
+    int count;
+    
+    struct timespec start;
+    struct timespec end;
+    
+    KMerTableSetHash(kmers, function, reduction);
+    
+    // Count every k-mer of every file, replacing N's the same way each time:
+    NUCLEOTIDE = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    for(int file = 0; file < numInputFiles; file++)
+    {
+        readsReset(reads[file]);
+        
+        while(readsHasNext(reads[file]))
+        {
+            count = readsGetNextBatch(reads[file], &batch);
+            hashBatch(batch, count, kmers, KMER_SIZE, NULL, 1);
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *countSeconds = getSeconds(&start, &end);
+    
+    // Look them up as correction does, without the time taken to load reads:
+    NUCLEOTIDE = 0;
+    *lookupSeconds = 0;
+    
+    for(int file = 0; file < numInputFiles; file++)
+    {
+        readsReset(reads[file]);
+        
+        while(readsHasNext(reads[file]))
+        {
+            count = readsGetNextBatch(reads[file], &batch);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            
+            for(int i = 0; i < count; i++)
+            {
+                unsigned int counts[batch[i].length > 0 ? batch[i].length : 1];
+                getKMerCounts(batch[i].sequence, batch[i].length, kmers, counts);
+            }
+            
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            *lookupSeconds += getSeconds(&start, &end);
+        }
+    }
+    
+    KMerTableGetProbeLengths(kmers, histogram);
+    freeKMerHashTable(kmers);
+}
+
+int benchmarkHashFunctions(int numInputFiles, char* inputFileNames)
+{
+    static const char* PAGE_MODES[] = {"off", "transparent", "explicit"};
+    
+    Reads* reads[numInputFiles];
+    
+    unsigned long long int histogram[KMER_PROBE_HISTOGRAM_SIZE];
+    unsigned long long int entries;
+    unsigned long long int probes;
+    unsigned int longest;
+    
+    double countSeconds;
+    double lookupSeconds;
+    double baseline = 0;
+    
+    printf("HASH BENCHMARK\n\n");
+    
+    if(KMER_SIZE > KMER_NARROW_MAX_SIZE)
+    {
+        printf("ERROR: The hash benchmark only uses k-mers of up to %d bases.\n", KMER_NARROW_MAX_SIZE);
+        return 1;
+    }
+    
+    setHugePageMode(HUGE_PAGES);
+    
+    for(int file = 0; file < numInputFiles; file++)
+    {
+        if((reads[file] = createReads(&(inputFileNames[file * 200]), NULL, NUM_THREADS)) == 0)
+        {
+            return 1;
+        }
+    }
+    
+    printf("Slots examined by a lookup of each stored k-mer:\n\n");
+    printf("%-8s %-6s %12s %8s %8s %6s %6s %7s %7s %7s %7s %7s %7s\n", "hash", "slots", 
+            "k-mers", "count", "lookup", "mean", "max", "1", "2", "3-4", "5-8", "9-16", "17+");
+    
+    for(int function = KMER_HASH_FIRST; function <= KMER_HASH_LAST; function++)
+    {
+        for(int reduction = KMER_SLOT_MASK; reduction <= KMER_SLOT_SHIFT; reduction++)
+        {
+            if(!isKMerHashSupported(function))
+            {
+                continue;
+            }
+            
+            benchmarkHashFunction(reads, numInputFiles, function, reduction, 
+                    &countSeconds, &lookupSeconds, histogram);
+            
+            entries = 0;
+            probes = 0;
+            longest = 0;
+            
+            for(unsigned int i = 1; i < KMER_PROBE_HISTOGRAM_SIZE; i++)
+            {
+                entries += histogram[i];
+                probes += histogram[i] * i;
+                
+                if(histogram[i] > 0)
+                {
+                    longest = i;
+                }
+            }
+            
+            printf("%-8s %-6s %12llu %7.3fs %7.3fs %6.3f %5u%s", getKMerHashName(function), 
+                    reduction == KMER_SLOT_SHIFT ? "shift" : "mask", entries,
+                    countSeconds, lookupSeconds, entries > 0 ? (double)probes / entries : 0.0, 
+                    longest, longest == KMER_TABLE_MAX_PROBE_LENGTH ? "+" : " ");
+            printProbeShare(histogram, 1, 1, entries);
+            printProbeShare(histogram, 2, 2, entries);
+            printProbeShare(histogram, 3, 4, entries);
+            printProbeShare(histogram, 5, 8, entries);
+            printProbeShare(histogram, 9, 16, entries);
+            printProbeShare(histogram, 17, KMER_TABLE_MAX_PROBE_LENGTH, entries);
+            printf("\n");
+        }
+    }
+    
+    // The same hash with each page size:
+    printf("\nHuge pages, with %s and %s slots:\n\n", getKMerHashName(HASH_FUNCTION),
+            SLOT_REDUCTION == KMER_SLOT_SHIFT ? "shift" : "mask");
+    printf("%-12s %8s %8s %8s\n", "pages", "count", "lookup", "saved");
+    
+    for(int mode = HUGE_PAGES_OFF; mode <= HUGE_PAGES_EXPLICIT; mode++)
+    {
+        setHugePageMode(mode);
+        benchmarkHashFunction(reads, numInputFiles, HASH_FUNCTION, SLOT_REDUCTION, 
+                &countSeconds, &lookupSeconds, histogram);
+        
+        if(mode == HUGE_PAGES_OFF)
+        {
+            baseline = lookupSeconds;
+        }
+        
+        printf("%-12s %7.3fs %7.3fs %7.1f%%\n", PAGE_MODES[mode], countSeconds, lookupSeconds,
+                baseline > 0 ? 100.0 * (baseline - lookupSeconds) / baseline : 0.0);
+    }
+    
+    setHugePageMode(HUGE_PAGES);
+    
+    for(int file = 0; file < numInputFiles; file++)
+    {
+        readsDestroy(reads[file]);
+    }
+    
+    return 0;
+}
+
 int processCorrection(int numInputFiles, char* inputFileNames, char* outputDirectory, 
         bool paired, bool substitutions, bool insertions, bool deletions, bool homopolymers,
         bool filtering, bool qualityUpdating) 
@@ -24,12 +24,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "KMerHashTable.h"
 #include "Globals.h"
 #include "Reads.h"
+#include "Memory.h"
+#include "Numa.h"
 
 #ifdef	__cplusplus
 extern "C" {
 #endif  
 
 extern unsigned int KMER_SIZE;
+extern unsigned int NUM_THREADS;
+extern unsigned long long int MAX_MEMORY;
+extern unsigned long long int FILTER_SIZE;
+extern char* SAVE_KMERS;
+extern char* LOAD_KMERS;
+extern char* EXTEND_KMERS;
+extern bool FREEZE_KMERS;
+extern enum KMER_TABLE_ENGINE KMER_ENGINE;
+extern enum KMER_HASH_FUNCTION HASH_FUNCTION;
+extern enum KMER_SLOT_REDUCTION SLOT_REDUCTION;
+extern unsigned int REMAINDER_BITS;
+extern enum HUGE_PAGE_MODE HUGE_PAGES;
+extern enum NUMA_POLICY NUMA_PLACEMENT;
     
 /**
  * This function will initiate error correcting.
@@ -40,6 +55,15 @@ int processCorrection(int numInputFiles, char* inputFileNames, char* output,
 
 int convertFASTQToFASTK(int numInputFiles, char* inputFileNames, char* outputDirectory);
 
+/**
+ * Counts every k-mer of the input files with each supported hash function and 
+ * slot reduction in turn, printing the time taken to count and look up the 
+ * k-mers and the distribution of the probe lengths in the resulting k-mer 
+ * table. The selected hash function is then run with each huge page mode, to 
+ * show how much of the lookup time huge pages save.
+ */
+int benchmarkHashFunctions(int numInputFiles, char* inputFileNames);
+
 void hashSequence(unsigned long long int* sequence, unsigned int sequenceLength,
         KMerHashTable* kmers, unsigned int kmerSize);
 
@@ -59,7 +59,7 @@ int getExternalErrorPosition(unsigned long long int* sequence, unsigned int leng
     
     // Data structures:
     unsigned int counts[total];
-    getKMerCounts(sequence, length, kmers, kmerSize, counts);
+    getKMerCounts(sequence, length, kmers, counts);
     
     // Beginning?
     if(counts[0] <= THRESHOLD)
@@ -162,7 +162,7 @@ int getStartOfInternalError(unsigned long long int* sequence, unsigned int lengt
     
     // Data structures:
     unsigned int counts[total];
-    getKMerCounts(sequence, length, kmers, kmerSize, counts);
+    getKMerCounts(sequence, length, kmers, counts);
     
     // Analyze:
     // Find start:
@@ -194,7 +194,7 @@ int getLengthOfInternalError(unsigned long long int* sequence, unsigned int leng
     
     // Data structures:
     unsigned int counts[total];
-    getKMerCounts(sequence, length, kmers, kmerSize, counts);
+    getKMerCounts(sequence, length, kmers, counts);
     
     // Analyze:
     // Find start:
@@ -264,7 +264,7 @@ unsigned int typeHighQuality(unsigned long long int* sequence, unsigned int leng
     
     // Data structures:
     unsigned int counts[total];
-    getKMerCounts(sequence, length, kmers, kmerSize, counts);
+    getKMerCounts(sequence, length, kmers, counts);
     
     // Analyze:
     for(int i = 0; i < total; i++)
@@ -288,7 +288,7 @@ unsigned int typeLowCoverage(unsigned long long int* sequence, unsigned int leng
     
     // Data structures:
     unsigned int counts[total];
-    getKMerCounts(sequence, length, kmers, kmerSize, counts);
+    getKMerCounts(sequence, length, kmers, counts);
     
     // Analyze:
     for(int i = 0; i < total; i++)
@@ -329,7 +329,7 @@ unsigned int typeHomopolymer(unsigned long long int* sequence, unsigned int leng
     
     // Data structures:
     unsigned int counts[total];
-    getKMerCounts(sequence, length, kmers, kmerSize, counts);
+    getKMerCounts(sequence, length, kmers, counts);
     
     // Analyze:
     for(int i = 1; i < length; i++)
@@ -0,0 +1,86 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <string.h>
+#include "KMerHash.h"
+
+static const char* HASH_NAMES[] = {"", "murmur", "wyhash", "crc32c"};
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+unsigned long long int hashKMerCRC(unsigned long long int kmer)
+{
+    unsigned long long int rotated = (kmer << 32) | (kmer >> 32);
+        // The CRC is linear: hashing the same bits twice with another seed 
+        // would only flip a constant set of bits.
+    
+    return (__builtin_ia32_crc32di(0x9E3779B9ULL, rotated) << 32) | 
+            __builtin_ia32_crc32di(0x7F4A7C15ULL, kmer);
+}
+
+int isKMerHashSupported(enum KMER_HASH_FUNCTION function)
+{
+    if(function == KMER_HASH_CRC)
+    {
+        return __builtin_cpu_supports("sse4.2");
+    }
+    
+    return function >= KMER_HASH_FIRST && function <= KMER_HASH_LAST;
+}
+
+#else
+
+unsigned long long int hashKMerCRC(unsigned long long int kmer)
+{
+    // Never selected: see isKMerHashSupported.
+    return hashKMerMurmur(kmer);
+}
+
+int isKMerHashSupported(enum KMER_HASH_FUNCTION function)
+{
+    return function >= KMER_HASH_FIRST && function < KMER_HASH_CRC;
+}
+
+#endif
+
+const char* getKMerHashName(enum KMER_HASH_FUNCTION function)
+{
+    if(function < KMER_HASH_FIRST || function > KMER_HASH_LAST)
+    {
+        return "unknown";
+    }
+    
+    return HASH_NAMES[function];
+}
+
+int parseKMerHash(char* name, enum KMER_HASH_FUNCTION* function)
+{
+    for(int i = KMER_HASH_FIRST; i <= KMER_HASH_LAST; i++)
+    {
+        if(strcmp(name, HASH_NAMES[i]) == 0)
+        {
+            *function = (enum KMER_HASH_FUNCTION)i;
+            return 1;
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef KMERHASH_H
+#define	KMERHASH_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * The hash functions used to place k-mers in the k-mer table. K-mers are 
+ * left-aligned and their low bits are always 0, so they must be mixed before 
+ * any of their bits can select a shard or a slot. Every function produces a 
+ * full 64-bit hash: the k-mer table takes its shard from the high bits and its 
+ * slot from the remaining bits (see KMER_SLOT_REDUCTION).
+ * 
+ * The values identify the hash function in saved k-mer indexes, and must not 
+ * change.
+ */
+enum KMER_HASH_FUNCTION
+{
+    KMER_HASH_MURMUR = 1,                   // MurmurHash3 64-bit finalizer.
+    KMER_HASH_WY = 2,                       // wyhash 64-bit mix.
+    KMER_HASH_CRC = 3,                      // Two CRC32-C (requires SSE4.2).
+};
+
+#define KMER_HASH_FIRST KMER_HASH_MURMUR
+#define KMER_HASH_LAST KMER_HASH_CRC
+
+/**
+ * How a hash is reduced to a slot of a power-of-two table. A mask takes the 
+ * lowest bits of the hash. A shift takes the highest bits that are not used to 
+ * select the shard, such that slot order follows hash order.
+ */
+enum KMER_SLOT_REDUCTION
+{
+    KMER_SLOT_MASK = 0,
+    KMER_SLOT_SHIFT = 1,
+};
+
+static inline unsigned long long int hashKMerMurmur(unsigned long long int kmer)
+{
+    kmer ^= kmer >> 33;
+    kmer *= 0xFF51AFD7ED558CCDULL;
+    kmer ^= kmer >> 33;
+    kmer *= 0xC4CEB9FE1A85EC53ULL;
+    kmer ^= kmer >> 33;
+    
+    return kmer;
+}
+
+/* Multiplies into 128 bits and folds the halves together. */
+static inline unsigned long long int mixWy(unsigned long long int a, unsigned long long int b)
+{
+    __uint128_t product = (__uint128_t)a * b;
+    
+    return (unsigned long long int)(product >> 64) ^ (unsigned long long int)product;
+}
+
+static inline unsigned long long int hashKMerWy(unsigned long long int kmer)
+{
+    unsigned long long int hash = mixWy(kmer ^ 0x2D358DCCAA6C78A5ULL, kmer ^ 0x8BB84B93962EACC9ULL);
+    
+    return mixWy(hash ^ 0x2D358DCCAA6C78A5ULL, 0x8BB84B93962EACC9ULL);
+}
+
+/**
+ * Hashes the k-mer with the CRC32-C instruction. The k-mer and its rotation 
+ * give the low and high halves of the hash. This must only be used when 
+ * isKMerHashSupported(KMER_HASH_CRC) is true.
+ * 
+ * @param kmer The k-mer.
+ * @return The hash of the k-mer.
+ */
+unsigned long long int hashKMerCRC(unsigned long long int kmer);
+
+static inline unsigned long long int hashKMerWith(enum KMER_HASH_FUNCTION function, 
+        unsigned long long int kmer)
+{
+    switch(function)
+    {
+        case KMER_HASH_WY:
+            return hashKMerWy(kmer);
+        case KMER_HASH_CRC:
+            return hashKMerCRC(kmer);
+        default:
+            return hashKMerMurmur(kmer);
+    }
+}
+
+/**
+ * Whether the hash function is known and can be run on this machine.
+ * 
+ * @param function The hash function.
+ * @return Non-zero if the hash function can be used.
+ */
+int isKMerHashSupported(enum KMER_HASH_FUNCTION function);
+
+/**
+ * Returns the name of the hash function, as accepted by parseKMerHash.
+ * 
+ * @param function The hash function.
+ * @return The name of the hash function.
+ */
+const char* getKMerHashName(enum KMER_HASH_FUNCTION function);
+
+/**
+ * Parses the name of a hash function: "murmur", "wyhash" or "crc32c".
+ * 
+ * @param name The name of the hash function.
+ * @param function The parsed hash function.
+ * @return Non-zero on success, 0 if the name is unknown.
+ */
+int parseKMerHash(char* name, enum KMER_HASH_FUNCTION* function);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* KMERHASH_H */
+
@@ -19,247 +19,2068 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
 #include "KMerHashTable.h"
 #include "Utility.h"
 #include "Correction.h"
+#include "KMerSortedTable.h"
+#include "Memory.h"
 
-static inline void printProgress(int x, int n, int r)
+/* Prints the percentage of the n steps done so far whenever it passes another 
+ * multiple of 100/r percent, ending with 100% after the last step. Returns the 
+ * number of multiples printed, to be given back as printed on the next call. */
+static inline int printProgress(unsigned int done, unsigned int n, int printed, int r)
 {
-    // Only update r times.
-    if (n/r == 0 || x % (n/r) != 0) return; // Mod 0 causes problems.
+    for(; printed <= r && (unsigned long long int)printed * n <= (unsigned long long int)done * r; printed++)
+    {
+        printf("%d%% ", printed * (100 / r));
+    }
+    
+    fflush(stdout);
+    
+    return printed;
+}
+
+// The smallest number of slots a shard will have.
+#define KMER_TABLE_MINIMUM_CAPACITY 256ULL
+
+/* A shard grows when it becomes more than 7/10 full. After pruning, it is 
+ * sized to be no more than 1/2 full, leaving room for the next input file. */
+#define KMER_TABLE_MAX_LOAD_NUMERATOR 7
+#define KMER_TABLE_MAX_LOAD_DENOMINATOR 10
+
+// The number of k-mers a buffer collects for a shard before adding them.
+#define KMER_BUFFER_SIZE 512
+
+// The number of k-mers whose slots are prefetched together by KMerTableLookupBatch.
+#define KMER_LOOKUP_GROUP 16
+
+static inline unsigned long long int hashKMer(KMerHashTableShard* shard, 
+        unsigned long long int kmer)
+{
+    return hashKMerWith(shard->hashFunction, kmer);
+}
+
+/* Returns the slot where probing for the hash starts. */
+static inline unsigned long long int getHomeSlot(KMerHashTableShard* shard, 
+        unsigned long long int hash)
+{
+    if(shard->slotReduction == KMER_SLOT_SHIFT)
+    {
+        return (hash << KMER_TABLE_SHARD_BITS) >> (64 - __builtin_ctzll(shard->capacity));
+    }
+    
+    return hash & (shard->capacity - 1);
+}
+
+static inline unsigned int getShardIndex(unsigned long long int hash)
+{
+    return (unsigned int)(hash >> (64 - KMER_TABLE_SHARD_BITS));
+}
+
+static inline KMerHashTableShard* getShard(KMerHashTable* kmerTable, 
+        unsigned long long int kmer)
+{
+    return &(kmerTable->shards[getShardIndex(hashKMerWith(kmerTable->hashFunction, kmer))]);
+}
+
+/* Returns the slot containing the k-mer, or the empty slot where it would be 
+ * inserted, probing from the given slot. The shard must contain at least one 
+ * empty slot. */
+static inline unsigned long long int probeSlot(KMerHashTableShard* shard, 
+        unsigned long long int kmer, unsigned long long int slot)
+{
+    unsigned long long int mask = shard->capacity - 1;
+    
+    while(shard->kmers[slot] != kmer && shard->kmers[slot] != KMER_EMPTY)
+    {
+        slot = (slot + 1) & mask;
+    }
+    
+    return slot;
+}
+
+/* Returns the slot containing the k-mer, or the empty slot where it would be 
+ * inserted. The shard must contain at least one empty slot. */
+static inline unsigned long long int findSlot(KMerHashTableShard* shard, 
+        unsigned long long int kmer)
+{
+    return probeSlot(shard, kmer, getHomeSlot(shard, hashKMer(shard, kmer)));
+}
+
+/* Returns the smallest capacity that holds the entries within the given load. */
+static unsigned long long int getCapacityForEntries(unsigned long long int entries,
+        unsigned long long int numerator, unsigned long long int denominator)
+{
+    unsigned long long int capacity = KMER_TABLE_MINIMUM_CAPACITY;
+    
+    while(entries * denominator > capacity * numerator)
+    {
+        capacity *= 2;
+    }
+    
+    return capacity;
+}
+
+static int allocateShard(KMerHashTableShard* shard, unsigned long long int capacity)
+{
+    shard->kmers = (unsigned long long int*)allocateMemory(capacity * sizeof(unsigned long long int));
+    shard->counts = (KMerCount*)allocateMemory(capacity * sizeof(KMerCount));
+        // Counts start at 0; concurrent counting only ever adds to them.
+    
+    if(shard->kmers == NULL || shard->counts == NULL)
+    {
+        freeMemory(shard->kmers, capacity * sizeof(unsigned long long int));
+        freeMemory(shard->counts, capacity * sizeof(KMerCount));
+        
+        return 0;
+    }
+    
+    // All bits set is KMER_EMPTY:
+    memset(shard->kmers, 0xFF, capacity * sizeof(unsigned long long int));
+    
+    shard->capacity = capacity;
+    shard->entries = 0;
+    shard->reserved = 0;
+    
+    return 1;
+}
+
+/* Moves every k-mer with a count of at least minimumCount into a new set of 
+ * arrays with the given capacity. The old arrays are released. */
+static int rebuildShard(KMerHashTableShard* shard, unsigned long long int capacity,
+        unsigned int minimumCount)
+{
+    unsigned long long int* oldKMers = shard->kmers;
+    KMerCount* oldCounts = shard->counts;
+    unsigned long long int oldCapacity = shard->capacity;
+    unsigned long long int oldEntries = shard->entries;
+    unsigned long long int slot;
+    
+    if(!allocateShard(shard, capacity))
+    {
+        printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+        
+        shard->kmers = oldKMers;
+        shard->counts = oldCounts;
+        shard->capacity = oldCapacity;
+        shard->entries = oldEntries;
+        
+        return 0;
+    }
+    
+    for(unsigned long long int i = 0; i < oldCapacity; i++)
+    {
+        if(oldKMers[i] != KMER_EMPTY && oldCounts[i] >= minimumCount)
+        {
+            slot = findSlot(shard, oldKMers[i]);
+            
+            shard->kmers[slot] = oldKMers[i];
+            shard->counts[slot] = oldCounts[i];
+            shard->entries++;
+        }
+    }
     
-    double result;
+    freeMemory(oldKMers, oldCapacity * sizeof(unsigned long long int));
+    freeMemory(oldCounts, oldCapacity * sizeof(KMerCount));
     
-    if(n / r != 1)
-        result = x / (n/r) * (100/r);
+    // The k-mers left behind are no longer tallied:
+    for(unsigned int count = 1; count < minimumCount && count < KMER_COUNT_SATURATED; count++)
+    {
+        shard->histogram[count] = 0;
+    }
+    
+    return 1;
+}
+
+/* Returns the number of entries a shard may hold before it must grow. */
+static inline unsigned long long int getShardLimit(KMerHashTableShard* shard)
+{
+    return shard->capacity * KMER_TABLE_MAX_LOAD_NUMERATOR / KMER_TABLE_MAX_LOAD_DENOMINATOR;
+}
+
+/* Returns the overflow count of the k-mer. If the k-mer has none, it is given 
+ * a count of 0 when create is set, and NULL is returned otherwise. */
+static unsigned long long int* getOverflow(KMerHashTableShard* shard, 
+        unsigned long long int kmer, int create)
+{
+    unsigned long long int* oldKMers = shard->overflowKMers;
+    unsigned long long int* oldCounts = shard->overflowCounts;
+    unsigned long long int oldCapacity = shard->overflowCapacity;
+    unsigned long long int mask = oldCapacity - 1;
+    unsigned long long int slot = hashKMer(shard, kmer) & mask;
+    
+    // Find the k-mer:
+    while(oldCapacity > 0 && oldKMers[slot] != KMER_EMPTY)
+    {
+        if(oldKMers[slot] == kmer)
+        {
+            return &(oldCounts[slot]);
+        }
+        
+        slot = (slot + 1) & mask;
+    }
+    
+    if(!create)
+    {
+        return NULL;
+    }
+    
+    // Grow when half full:
+    if((shard->overflowEntries + 1) * 2 > oldCapacity)
+    {
+        shard->overflowCapacity = oldCapacity > 0 ? oldCapacity * 2 : KMER_TABLE_OVERFLOW_MINIMUM_CAPACITY;
+        shard->overflowKMers = (unsigned long long int*)allocateMemory(
+                shard->overflowCapacity * sizeof(unsigned long long int));
+        shard->overflowCounts = (unsigned long long int*)allocateMemory(
+                shard->overflowCapacity * sizeof(unsigned long long int));
+        
+        if(shard->overflowKMers == NULL || shard->overflowCounts == NULL)
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+            exit(1);
+        }
+        
+        memset(shard->overflowKMers, 0xFF, shard->overflowCapacity * sizeof(unsigned long long int));
+        shard->overflowEntries = 0;
+        
+        for(unsigned long long int i = 0; i < oldCapacity; i++)
+        {
+            if(oldKMers[i] != KMER_EMPTY)
+            {
+                *getOverflow(shard, oldKMers[i], 1) = oldCounts[i];
+            }
+        }
+        
+        freeMemory(oldKMers, oldCapacity * sizeof(unsigned long long int));
+        freeMemory(oldCounts, oldCapacity * sizeof(unsigned long long int));
+        
+        return getOverflow(shard, kmer, 1);
+    }
+    
+    shard->overflowKMers[slot] = kmer;
+    shard->overflowCounts[slot] = 0;
+    shard->overflowEntries++;
+    
+    return &(shard->overflowCounts[slot]);
+}
+
+/* Returns the exact count of the k-mer in the slot. */
+static inline unsigned long long int getCount(KMerHashTableShard* shard, 
+        unsigned long long int slot)
+{
+    if(shard->counts[slot] == KMER_COUNT_SATURATED)
+    {
+        return *getOverflow(shard, shard->kmers[slot], 0);
+    }
+    
+    return shard->counts[slot];
+}
+
+/* Moves a k-mer from the tally of its previous count to that of its new count. 
+ * Saturated counts are not tallied: they are in the overflow map. */
+static inline void tallyCount(unsigned long long int* histogram, 
+        unsigned long long int previous, unsigned long long int count)
+{
+    if(previous > 0 && previous < KMER_COUNT_SATURATED)
+    {
+        histogram[previous]--;
+    }
+    
+    if(count > 0 && count < KMER_COUNT_SATURATED)
+    {
+        histogram[count]++;
+    }
+}
+
+/* Replaces the count of the k-mer in the slot. */
+static void setCount(KMerHashTableShard* shard, unsigned long long int slot, 
+        unsigned long long int count)
+{
+    unsigned long long int* overflow;
+    
+    tallyCount(shard->histogram, shard->counts[slot], count);
+    
+    if(count >= KMER_COUNT_SATURATED)
+    {
+        shard->counts[slot] = KMER_COUNT_SATURATED;
+        *getOverflow(shard, shard->kmers[slot], 1) = count;
+        
+        return;
+    }
+    
+    shard->counts[slot] = (KMerCount)count;
+    
+    // A stale overflow count must restart from 0 if the counter saturates again:
+    if((overflow = getOverflow(shard, shard->kmers[slot], 0)) != NULL)
+    {
+        *overflow = 0;
+    }
+}
+
+/* Adds amount to the count of the k-mer in the slot. Once the counter saturates, 
+ * the whole count is kept in the overflow map instead. 
+ * This must not be used while other threads are counting into the shard. */
+static inline void addToCount(KMerHashTableShard* shard, unsigned long long int slot, 
+        unsigned int amount)
+{
+    unsigned int count = shard->counts[slot];
+    
+    if(count == KMER_COUNT_SATURATED)
+    {
+        *getOverflow(shard, shard->kmers[slot], 1) += amount;
+    }
+    else if(count + amount >= KMER_COUNT_SATURATED)
+    {
+        shard->counts[slot] = KMER_COUNT_SATURATED;
+        *getOverflow(shard, shard->kmers[slot], 1) += count + amount;
+        tallyCount(shard->histogram, count, KMER_COUNT_SATURATED);
+    }
     else
-        result = (x + 1) / ((double)n/(double)r) * ((double)100/(double)r);
- 
-    printf("%d%% ", (int)result);
-    fflush(stdout);
+    {
+        shard->counts[slot] = (KMerCount)(count + amount);
+        tallyCount(shard->histogram, count, count + amount);
+    }
+}
+
+/* As addToCount, for use while other threads are counting. The thread that 
+ * saturates the counter moves the count it saturated with to the overflow map; 
+ * threads that find it saturated add only their own amount. The overflow map 
+ * is only ever added to, so these may happen in any order. The change of count 
+ * is tallied in the calling thread's own histogram, to be added to the shard's 
+ * later. */
+static inline void addToCountAtomic(KMerHashTableShard* shard, unsigned long long int slot, 
+        unsigned long long int kmer, unsigned int amount, long long int* histogram)
+{
+    unsigned int current = __atomic_load_n(&(shard->counts[slot]), __ATOMIC_RELAXED);
+    unsigned int previous;
+    unsigned int next;
+    
+    while(current != KMER_COUNT_SATURATED)
+    {
+        next = current + amount;
+        previous = __sync_val_compare_and_swap(&(shard->counts[slot]), (KMerCount)current, 
+                (KMerCount)(next < KMER_COUNT_SATURATED ? next : KMER_COUNT_SATURATED));
+        
+        if(previous == current)
+        {
+            tallyCount((unsigned long long int*)histogram, current, next);
+            
+            // Not saturated:
+            if(next < KMER_COUNT_SATURATED)
+            {
+                return;
+            }
+            
+            amount = next;
+            break;
+        }
+        
+        current = previous;
+    }
+    
+    pthread_mutex_lock(&(shard->overflowLock));
+    *getOverflow(shard, kmer, 1) += amount;
+    pthread_mutex_unlock(&(shard->overflowLock));
+}
+
+/* Adds amount to the count of the k-mer, inserting it if necessary. 
+ * This must not be used while other threads are counting into the shard. */
+static inline int addToKMer(KMerHashTableShard* shard, unsigned long long int kmer,
+        unsigned int amount)
+{
+    unsigned long long int slot = findSlot(shard, kmer);
+    
+    // The k-mer does exist:
+    if(shard->kmers[slot] == kmer)
+    {
+        addToCount(shard, slot, amount);
+        
+        return 1;
+    }
+    
+    // The k-mer doesn't exist. Is the shard too full?
+    if(shard->entries + 1 > getShardLimit(shard))
+    {
+        if(!rebuildShard(shard, shard->capacity * 2, 1))
+        {
+            return 0;
+        }
+        
+        slot = findSlot(shard, kmer);
+    }
+    
+    // Initialize:
+    shard->kmers[slot] = kmer;
+    addToCount(shard, slot, amount);
+    shard->entries++;
+    
+    return 1;
+}
+
+/* Returns the bits a k-mer sets in its word of the shard's filter. The low bits 
+ * of the hash select the word, and the top bits select the shard. */
+static inline unsigned long long int getFilterBits(unsigned long long int hash)
+{
+    return (1ULL << ((hash >> 32) & 63)) | (1ULL << ((hash >> 38) & 63)) | 
+            (1ULL << ((hash >> 44) & 63)) | (1ULL << ((hash >> 50) & 63));
+}
+
+/* Records the k-mer in the shard's filter. Returns whether it was (probably) 
+ * already recorded. */
+static inline int testAndSetFilter(KMerHashTableShard* shard, unsigned long long int hash)
+{
+    unsigned long long int* word = &(shard->filter[hash & (shard->filterWords - 1)]);
+    unsigned long long int bits = getFilterBits(hash);
+    unsigned long long int previous = *word;
+    
+    *word = previous | bits;
+    
+    return (previous & bits) == bits;
+}
+
+/* As testAndSetFilter, for use while other threads are counting. A k-mer's 
+ * bits all lie in one word, so recording it is a single atomic operation. */
+static inline int testAndSetFilterAtomic(KMerHashTableShard* shard, unsigned long long int hash)
+{
+    unsigned long long int* word = &(shard->filter[hash & (shard->filterWords - 1)]);
+    unsigned long long int bits = getFilterBits(hash);
+    
+    return (__sync_fetch_and_or(word, bits) & bits) == bits;
+}
+
+/* Whether the k-mer must pass through the shard's filter before being counted. 
+ * Palindromes (counted 2 per occurrence) are never singletons, so they skip it. */
+static inline int isGated(KMerHashTableShard* shard, unsigned int amount)
+{
+    return shard->filter != NULL && amount == 1;
+}
+
+/* Counts one occurrence of the k-mer, which is only added to the shard when it 
+ * has been seen before. This must not be used while other threads are counting 
+ * into the shard. */
+static inline int countKMer(KMerHashTableShard* shard, unsigned long long int kmer,
+        unsigned int amount)
+{
+    unsigned long long int slot;
+    
+    if(!isGated(shard, amount))
+    {
+        return addToKMer(shard, kmer, amount);
+    }
+    
+    slot = findSlot(shard, kmer);
+    
+    if(shard->kmers[slot] == kmer)
+    {
+        addToCount(shard, slot, amount);
+        
+        return 1;
+    }
+    
+    // First occurrence:
+    if(!testAndSetFilter(shard, hashKMer(shard, kmer)))
+    {
+        shard->singletons++;
+        
+        return 1;
+    }
+    
+    // Second occurrence, also counting the first:
+    shard->singletons--;
+    
+    return addToKMer(shard, kmer, amount * 2);
+}
+
+// The outcomes of addToKMerAtomic:
+#define KMER_INCREMENTED 0                  // The k-mer was already counted.
+#define KMER_INSERTED 1                     // The k-mer claimed a new slot.
+#define KMER_HELD 2                         // The filter held back the k-mer.
+
+/* Atomically adds amount to the count of the k-mer, claiming an empty slot for 
+ * it if necessary. Any number of threads may do this at once, provided room 
+ * for the k-mer has been reserved in the shard. If the k-mer is gated, it is 
+ * only claimed if the filter has seen it before, and the thread that claims it 
+ * also counts the occurrence that was held back. The change of count is tallied 
+ * in the histogram. 
+ * Returns KMER_INSERTED, KMER_INCREMENTED or KMER_HELD. */
+static inline int addToKMerAtomic(KMerHashTableShard* shard, unsigned long long int kmer,
+        unsigned int amount, long long int* histogram)
+{
+    unsigned long long int hash = hashKMer(shard, kmer);
+    unsigned long long int mask = shard->capacity - 1;
+    unsigned long long int slot = getHomeSlot(shard, hash);
+    unsigned long long int current;
+    unsigned int claimed = amount;
+    
+    while(1)
+    {
+        current = __atomic_load_n(&(shard->kmers[slot]), __ATOMIC_RELAXED);
+        
+        // Try to claim an empty slot:
+        if(current == KMER_EMPTY)
+        {
+            if(isGated(shard, amount))
+            {
+                // First occurrence:
+                if(!testAndSetFilterAtomic(shard, hash))
+                {
+                    return KMER_HELD;
+                }
+                
+                claimed = amount * 2;
+            }
+            
+            current = __sync_val_compare_and_swap(&(shard->kmers[slot]), KMER_EMPTY, kmer);
+            
+            // Claimed:
+            if(current == KMER_EMPTY)
+            {
+                addToCountAtomic(shard, slot, kmer, claimed, histogram);
+                
+                return KMER_INSERTED;
+            }
+            
+            // Another thread claimed the slot first; it might be this k-mer.
+        }
+        
+        if(current == kmer)
+        {
+            addToCountAtomic(shard, slot, kmer, amount, histogram);
+            
+            return KMER_INCREMENTED;
+        }
+        
+        slot = (slot + 1) & mask;
+    }
+}
+
+/* Reserves room for the given number of new k-mers in the shard, growing it 
+ * if necessary. On return, the shard is held shared by the calling thread. */
+static void reserveShard(KMerHashTableShard* shard, unsigned long long int size)
+{
+    unsigned long long int reserved;
+    
+    while(1)
+    {
+        pthread_rwlock_rdlock(&(shard->lock));
+        
+        reserved = __sync_add_and_fetch(&(shard->reserved), size);
+        
+        if(__sync_fetch_and_add(&(shard->entries), 0) + reserved <= getShardLimit(shard))
+        {
+            return;
+        }
+        
+        // Not enough room. Give the reservation back and grow the shard:
+        __sync_sub_and_fetch(&(shard->reserved), size);
+        pthread_rwlock_unlock(&(shard->lock));
+        
+        pthread_rwlock_wrlock(&(shard->lock));
+        
+        // Another thread may have grown it while we were waiting:
+        if(shard->entries + shard->reserved + size > getShardLimit(shard))
+        {
+            if(!rebuildShard(shard, shard->capacity * 2, 1))
+            {
+                exit(1);
+            }
+        }
+        
+        pthread_rwlock_unlock(&(shard->lock));
+    }
+}
+
+/* Returns how many times a canonical k-mer is counted per occurrence. */
+static inline unsigned int getKMerAmount(unsigned long long int kmer, 
+        unsigned int kmerSize)
+{
+    // Palindromes are counted for both strands:
+    if(kmerSize % 2 == 0 && getReverseComplimentKMer(kmer, kmerSize) == kmer)
+    {
+        return 2;
+    }
+    
+    return 1;
+}
+
+void addKMersToTable(KMerHashTable* table, unsigned long long int* sequence, 
+        unsigned int sequenceLength, unsigned int kmerSize)
+{
+    //Variables:
+    int total = (int)sequenceLength - (int)kmerSize + 1;
+    
+    table->hasStatistics = 0;
+    
+    if(table->engine == KMER_ENGINE_WIDE)
+    {
+        KMerWideTableAddSequence(table->wide, sequence, sequenceLength);
+        return;
+    }
+    
+    if(total <= 0)
+    {
+        return;
+    }
+    
+    unsigned long long int kmers[total];
+    getCanonicalKMers(sequence, sequenceLength, kmerSize, kmers);
+    
+    addCanonicalKMersToTable(table, kmers, total);
+}
+
+/* Collects the k-mers in the sorting engine. Palindromes are collected twice. */
+static void addToSortedTable(KMerHashTable* table, unsigned long long int* kmers, 
+        unsigned int numKMers)
+{
+    KMerSortedTableAdd(table->sorted, kmers, numKMers);
+    
+    for(unsigned int i = 0; i < numKMers && table->kmerSize % 2 == 0; i++)
+    {
+        if(getKMerAmount(kmers[i], table->kmerSize) == 2)
+        {
+            KMerSortedTableAdd(table->sorted, &(kmers[i]), 1);
+        }
+    }
+}
+
+void addCanonicalKMersToTable(KMerHashTable* table, unsigned long long int* kmers, 
+        unsigned int numKMers)
+{
+    if(table->engine == KMER_ENGINE_SORT)
+    {
+        addToSortedTable(table, kmers, numKMers);
+        return;
+    }
+    
+    if(table->engine == KMER_ENGINE_QUOTIENT)
+    {
+        for(unsigned int i = 0; i < numKMers; i++)
+        {
+            KMerQuotientFilterAdd(table->quotient, hashKMerWith(table->hashFunction, kmers[i]),
+                    getKMerAmount(kmers[i], table->kmerSize));
+        }
+        
+        return;
+    }
+    
+    for(unsigned int i = 0; i < numKMers; i++)
+    {
+        // The shard could not grow, so the counts would be incomplete:
+        if(!countKMer(getShard(table, kmers[i]), kmers[i], getKMerAmount(kmers[i], table->kmerSize)))
+        {
+            exit(1);
+        }
+    }
+}
+
+unsigned int KMerTableGetShardIndex(KMerHashTable* kmerTable, unsigned long long int kmer)
+{
+    return getShardIndex(hashKMerWith(kmerTable->hashFunction, kmer));
+}
+
+unsigned long long int KMerTableGetMemory(KMerHashTable* kmerTable)
+{
+    unsigned long long int capacity = 0;
+    unsigned long long int words = 0;
+    
+    if(kmerTable->engine == KMER_ENGINE_SORT)
+    {
+        return KMerSortedTableGetMemory(kmerTable->sorted);
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_WIDE)
+    {
+        return KMerWideTableGetMemory(kmerTable->wide);
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_QUOTIENT)
+    {
+        return KMerQuotientFilterGetMemory(kmerTable->quotient);
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_PERFECT)
+    {
+        return KMerPerfectTableGetMemory(kmerTable->perfect);
+    }
+    
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
+    {
+        capacity += kmerTable->shards[i].capacity;
+        words += kmerTable->shards[i].filterWords;
+        words += kmerTable->shards[i].overflowCapacity * 2;
+    }
+    
+    return capacity * KMER_TABLE_SLOT_BYTES + words * sizeof(unsigned long long int);
+}
+
+/* Returns the number of k-mers a buffer collects for the table. */
+static unsigned long long int getBufferSize(KMerHashTable* kmerTable)
+{
+    // The sorting engine collects a single group:
+    return (kmerTable->engine == KMER_ENGINE_SORT) ? 
+            KMER_SORTED_BATCH_SIZE : KMER_TABLE_NUM_SHARDS * KMER_BUFFER_SIZE;
+}
+
+KMerHashTableBuffer* newKMerHashTableBuffer(KMerHashTable* kmerTable)
+{
+    KMerHashTableBuffer* buffer;
+    unsigned long long int size = getBufferSize(kmerTable);
+    
+    // Counting through the buffer changes the table:
+    kmerTable->hasStatistics = 0;
+    
+    if((buffer = malloc(sizeof *buffer)) != NULL)
+    {
+        buffer->table = kmerTable;
+        buffer->kmers = (unsigned long long int*)malloc(size * sizeof(unsigned long long int));
+        
+        if(buffer->kmers == NULL)
+        {
+            free(buffer);
+            return NULL;
+        }
+        
+        for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
+        {
+            buffer->sizes[i] = 0;
+        }
+    }
+    
+    return buffer;
+}
+
+unsigned long long int KMerBufferGetMemory(KMerHashTable* kmerTable)
+{
+    return sizeof(KMerHashTableBuffer) + getBufferSize(kmerTable) * sizeof(unsigned long long int);
+}
+
+/* Adds the k-mers collected for one shard to that shard. */
+static void flushShard(KMerHashTableBuffer* buffer, unsigned int shardIndex)
+{
+    KMerHashTableShard* shard = &(buffer->table->shards[shardIndex]);
+    unsigned long long int* kmers = &(buffer->kmers[shardIndex * KMER_BUFFER_SIZE]);
+    unsigned int size = buffer->sizes[shardIndex];
+    unsigned int kmerSize = buffer->table->kmerSize;
+    unsigned long long int inserted = 0;
+    long long int singletons = 0;
+    long long int histogram[KMER_COUNT_SATURATED] = {0};
+    unsigned int amount;
+    
+    // Every k-mer in the group might be new:
+    reserveShard(shard, size);
+    
+    for(unsigned int i = 0; i < size; i++)
+    {
+        amount = getKMerAmount(kmers[i], kmerSize);
+        
+        switch(addToKMerAtomic(shard, kmers[i], amount, histogram))
+        {
+            case KMER_INSERTED:
+                inserted++;
+                singletons -= isGated(shard, amount);
+                break;
+            case KMER_HELD:
+                singletons++;
+                break;
+        }
+    }
+    
+    // Record the new entries before releasing the reservation:
+    __sync_add_and_fetch(&(shard->entries), inserted);
+    __sync_add_and_fetch(&(shard->singletons), singletons);
+    __sync_sub_and_fetch(&(shard->reserved), size);
+    
+    // The group changed few counts, so few tallies need updating:
+    for(unsigned int count = 1; count < KMER_COUNT_SATURATED; count++)
+    {
+        if(histogram[count] != 0)
+        {
+            __sync_add_and_fetch(&(shard->histogram[count]), (unsigned long long int)histogram[count]);
+        }
+    }
+    
+    pthread_rwlock_unlock(&(shard->lock));
+    
+    buffer->sizes[shardIndex] = 0;
+}
+
+/* Collects the k-mers for the sorting engine, sorting each full group into a 
+ * run of its own. Palindromes are collected twice. */
+static void addToSortedBuffer(KMerHashTableBuffer* buffer, unsigned long long int* kmers, 
+        unsigned int numKMers)
+{
+    unsigned int kmerSize = buffer->table->kmerSize;
+    
+    for(unsigned int i = 0; i < numKMers; i++)
+    {
+        for(unsigned int j = getKMerAmount(kmers[i], kmerSize); j > 0; j--)
+        {
+            buffer->kmers[buffer->sizes[0]++] = kmers[i];
+            
+            if(buffer->sizes[0] == KMER_SORTED_BATCH_SIZE)
+            {
+                KMerSortedTableAddRun(buffer->table->sorted, buffer->kmers, buffer->sizes[0]);
+                buffer->sizes[0] = 0;
+            }
+        }
+    }
+}
+
+void KMerBufferAddSequence(KMerHashTableBuffer* buffer, 
+        unsigned long long int* sequence, unsigned int sequenceLength)
+{
+    unsigned int kmerSize = buffer->table->kmerSize;
+    int total = (int)sequenceLength - (int)kmerSize + 1;
+    unsigned int shardIndex;
+    
+    // The wide table is shared directly:
+    if(buffer->table->engine == KMER_ENGINE_WIDE)
+    {
+        KMerWideTableAddSequence(buffer->table->wide, sequence, sequenceLength);
+        return;
+    }
+    
+    if(total <= 0)
+    {
+        return;
+    }
+    
+    unsigned long long int kmers[total];
+    getCanonicalKMers(sequence, sequenceLength, kmerSize, kmers);
+    
+    if(buffer->table->engine == KMER_ENGINE_SORT)
+    {
+        addToSortedBuffer(buffer, kmers, total);
+        return;
+    }
+    
+    // The quotient filter locks its shards itself:
+    if(buffer->table->engine == KMER_ENGINE_QUOTIENT)
+    {
+        addCanonicalKMersToTable(buffer->table, kmers, total);
+        return;
+    }
+    
+    for(int i = 0; i < total; i++)
+    {
+        shardIndex = getShardIndex(hashKMerWith(buffer->table->hashFunction, kmers[i]));
+        
+        buffer->kmers[shardIndex * KMER_BUFFER_SIZE + buffer->sizes[shardIndex]] = kmers[i];
+        buffer->sizes[shardIndex]++;
+        
+        if(buffer->sizes[shardIndex] == KMER_BUFFER_SIZE)
+        {
+            flushShard(buffer, shardIndex);
+        }
+    }
+}
+
+void KMerBufferFlush(KMerHashTableBuffer* buffer)
+{
+    if(buffer->table->engine == KMER_ENGINE_SORT)
+    {
+        KMerSortedTableAddRun(buffer->table->sorted, buffer->kmers, buffer->sizes[0]);
+        buffer->sizes[0] = 0;
+        
+        return;
+    }
+    
+    for(unsigned int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
+    {
+        if(buffer->sizes[i] > 0)
+        {
+            flushShard(buffer, i);
+        }
+    }
+}
+
+void freeKMerHashTableBuffer(KMerHashTableBuffer* buffer)
+{
+    free(buffer->kmers);
+    free(buffer);
+}
+
+/* Adds the counts of the shard's k-mers, up to maxCount, to the histogram. 
+ * Only the tallies and the overflow map are read, never the slots. Returns the 
+ * highest count in the shard. */
+static unsigned long long int tallyShard(KMerHashTableShard* shard, 
+        unsigned long long int* histogram, unsigned long long int maxCount)
+{
+    unsigned long long int highest = 0;
+    unsigned long long int count;
+    
+    for(count = 1; count < KMER_COUNT_SATURATED; count++)
+    {
+        if(shard->histogram[count] == 0)
+        {
+            continue;
+        }
+        
+        highest = count;
+        
+        if(count <= maxCount)
+        {
+            histogram[count] += shard->histogram[count];
+        }
+    }
+    
+    // Saturated k-mers; the overflow counts of the others are 0:
+    for(unsigned long long int i = 0; i < shard->overflowCapacity; i++)
+    {
+        count = shard->overflowCounts[i];
+        
+        if(shard->overflowKMers[i] == KMER_EMPTY || count == 0)
+        {
+            continue;
+        }
+        
+        highest = (count > highest) ? count : highest;
+        
+        if(count <= maxCount)
+        {
+            histogram[count]++;
+        }
+    }
+    
+    return highest;
+}
+
+/* Replaces the k-mers kept from the shard's last pruning with those it is 
+ * about to remove, seen only once. */
+static int keepPrunedKMers(KMerHashTableShard* shard, unsigned long long int count)
+{
+    unsigned long long int next = 0;
+    
+    freeMemory(shard->pruned, shard->prunedEntries * sizeof(unsigned long long int));
+    shard->pruned = NULL;
+    shard->prunedEntries = 0;
+    
+    if(count == 0)
+    {
+        return 1;
+    }
+    
+    if((shard->pruned = (unsigned long long int*)allocateMemory(count * sizeof(unsigned long long int))) == NULL)
+    {
+        return 0;
+    }
+    
+    for(unsigned long long int slot = 0; slot < shard->capacity && next < count; slot++)
+    {
+        if(shard->kmers[slot] != KMER_EMPTY && shard->counts[slot] == 1)
+        {
+            shard->pruned[next++] = shard->kmers[slot];
+        }
+    }
+    
+    shard->prunedEntries = next;
+    
+    return 1;
+}
+
+/* As pruneKMers, optionally printing the progress through the shards. */
+static void pruneShards(KMerHashTable* kmerTable, unsigned int firstShard, 
+        unsigned int lastShard, unsigned long long int* histogram, 
+        unsigned long long int* unique, unsigned long long int* total, int progress)
+{
+    KMerHashTableShard* shard;
+    unsigned long long int shardUnique;
+    int printed = 0;
+    
+    // The sorting engine prunes every k-mer at once:
+    if(kmerTable->engine == KMER_ENGINE_SORT)
+    {
+        if(firstShard == 0 && !KMerSortedTableMerge(kmerTable->sorted, 2, 
+                histogram, KMER_HISTOGRAM_MAX_COUNT, unique, total))
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+            exit(1);
+        }
+        
+        return;
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_WIDE)
+    {
+        if(firstShard == 0 && !KMerWideTablePrune(kmerTable->wide, 2, 
+                histogram, KMER_HISTOGRAM_MAX_COUNT, unique, total))
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+            exit(1);
+        }
+        
+        return;
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_QUOTIENT)
+    {
+        if(!KMerQuotientFilterPrune(kmerTable->quotient, firstShard, lastShard, 2,
+                histogram, KMER_HISTOGRAM_MAX_COUNT, unique, total))
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+            exit(1);
+        }
+        
+        return;
+    }
+    
+    // Iterate Over Shards:
+    for(unsigned int i = firstShard; i < lastShard; i++)
+    {
+        if(progress)
+        {
+            printed = printProgress(i + 1 - firstShard, lastShard - firstShard, printed, 20);
+        }
+        
+        shard = &(kmerTable->shards[i]);
+        
+        // Tally Counts:
+        tallyShard(shard, histogram, KMER_HISTOGRAM_MAX_COUNT);
+        shardUnique = shard->histogram[1];
+        
+        *total += shard->entries;
+        *unique += shardUnique;
+        
+        // Keep the k-mers about to be removed, to be saved:
+        if(kmerTable->keepPruned && !keepPrunedKMers(shard, shardUnique))
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+            exit(1);
+        }
+        
+        // Remove unique k-mers while resizing:
+        rebuildShard(shard, getCapacityForEntries(shard->entries - shardUnique, 1, 2), 2);
+        
+        // Singletons held back by the filter were never added:
+        if(shard->filter != NULL)
+        {
+            if(shard->singletons > 0)
+            {
+                histogram[1] += shard->singletons;
+                *total += shard->singletons;
+                *unique += shard->singletons;
+            }
+            
+            shard->singletons = 0;
+            memset(shard->filter, 0, shard->filterWords * sizeof(unsigned long long int));
+        }
+    }
+}
+
+void pruneKMers(KMerHashTable* kmerTable, unsigned int firstShard, 
+        unsigned int lastShard, unsigned long long int* histogram, 
+        unsigned long long int* unique, unsigned long long int* total)
+{
+    kmerTable->hasStatistics = 0;
+    pruneShards(kmerTable, firstShard, lastShard, histogram, unique, total, 1);
+}
+
+// A range of shards, pruned by one thread:
+typedef struct
+{
+    KMerHashTable* kmerTable;
+    unsigned int firstShard;
+    unsigned int lastShard;
+    
+    unsigned long long int histogram[KMER_HISTOGRAM_SIZE];
+    unsigned long long int unique;
+    unsigned long long int total;
+} PruningThread;
+
+static void* pruneShardsThread(void* arg)
+{
+    PruningThread* thread = (PruningThread*)arg;
+    
+    pruneShards(thread->kmerTable, thread->firstShard, thread->lastShard, 
+            thread->histogram, &(thread->unique), &(thread->total), 0);
+    
+    return NULL;
+}
+
+void finishPreprocessingKMers(unsigned long long int* histogram, 
+        unsigned long long int unique, unsigned long long int total, 
+        Correction* correction)
+{
+    // Unique K-Mer Information:
+    printf("\n");    
+    printf("Removed %llu unique k-mers from the set of %llu total k-mers.\n", unique, total);
+    
+    unsigned int currentKMerCount = findKMerValley(histogram);
+    
+    if(currentKMerCount < KMER_HISTOGRAM_MAX_COUNT)
+    {
+        correction->lowKMerThreshold = currentKMerCount;
+    }
+    
+   printf("Low k-mer count value was observed to be %d.\n", currentKMerCount);
+}
+
+void preprocessKMers(KMerHashTable* kmerTable, Correction* correction, unsigned int numThreads)
+{
+    unsigned long long int histogram[KMER_HISTOGRAM_SIZE];
+    unsigned long long int unique = 0;
+    unsigned long long int total = 0;
+    
+    PruningThread* threads;
+    pthread_t handles[numThreads];
+    
+    kmerTable->hasStatistics = 0;
+    
+    // Initialize Counts:
+    for (int i = 0; i < KMER_HISTOGRAM_SIZE; i++)
+    {
+        histogram[i] = 0;
+    }
+    
+    // Single threaded:
+    if(numThreads <= 1 || (threads = calloc(numThreads, sizeof(PruningThread))) == NULL)
+    {
+        pruneKMers(kmerTable, 0, KMER_TABLE_NUM_SHARDS, histogram, &unique, &total);
+        finishPreprocessingKMers(histogram, unique, total, correction);
+        
+        return;
+    }
+    
+    // Multithreaded: each thread prunes a contiguous range of shards.
+    for(unsigned int t = 0; t < numThreads; t++)
+    {
+        threads[t].kmerTable = kmerTable;
+        threads[t].firstShard = KMER_TABLE_NUM_SHARDS * t / numThreads;
+        threads[t].lastShard = KMER_TABLE_NUM_SHARDS * (t + 1) / numThreads;
+        
+        pthread_create(&handles[t], NULL, pruneShardsThread, &threads[t]);
+    }
+    
+    for(unsigned int t = 0; t < numThreads; t++)
+    {
+        pthread_join(handles[t], NULL);
+        
+        for(int i = 0; i < KMER_HISTOGRAM_SIZE; i++)
+        {
+            histogram[i] += threads[t].histogram[i];
+        }
+        
+        unique += threads[t].unique;
+        total += threads[t].total;
+    }
+    
+    free(threads);
+    
+    finishPreprocessingKMers(histogram, unique, total, correction);
+}
+
+KMerHashTable* newKMerHashTable(unsigned int kmerSize)
+{
+    KMerHashTable* kmerTable;
+    
+    if((kmerTable = malloc(sizeof *kmerTable)) != NULL)
+    {
+        kmerTable->kmerSize = kmerSize;
+        kmerTable->engine = KMER_ENGINE_HASH;
+        kmerTable->sorted = NULL;
+        kmerTable->wide = NULL;
+        kmerTable->quotient = NULL;
+        kmerTable->perfect = NULL;
+        kmerTable->hashFunction = KMER_HASH_MURMUR;
+        kmerTable->slotReduction = KMER_SLOT_MASK;
+        kmerTable->hasStatistics = 0;
+        kmerTable->keepPruned = 0;
+        
+        for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
+        {
+            kmerTable->shards[i].hashFunction = KMER_HASH_MURMUR;
+            kmerTable->shards[i].slotReduction = KMER_SLOT_MASK;
+            
+            if(!allocateShard(&(kmerTable->shards[i]), KMER_TABLE_MINIMUM_CAPACITY))
+            {
+                printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+                exit(1);
+            }
+            
+            pthread_rwlock_init(&(kmerTable->shards[i].lock), NULL);
+            
+            kmerTable->shards[i].filter = NULL;
+            kmerTable->shards[i].filterWords = 0;
+            kmerTable->shards[i].singletons = 0;
+            
+            kmerTable->shards[i].overflowKMers = NULL;
+            kmerTable->shards[i].overflowCounts = NULL;
+            kmerTable->shards[i].overflowCapacity = 0;
+            kmerTable->shards[i].overflowEntries = 0;
+            pthread_mutex_init(&(kmerTable->shards[i].overflowLock), NULL);
+            
+            kmerTable->shards[i].pruned = NULL;
+            kmerTable->shards[i].prunedEntries = 0;
+            
+            memset(kmerTable->shards[i].histogram, 0, sizeof(kmerTable->shards[i].histogram));
+        }
+    }
+
+    return kmerTable;
+}
+
+int KMerTableSetHash(KMerHashTable* kmerTable, enum KMER_HASH_FUNCTION function,
+        enum KMER_SLOT_REDUCTION reduction)
+{
+    if(kmerTable->engine == KMER_ENGINE_SORT || !isKMerHashSupported(function) || 
+            KMerTableNumEntries(kmerTable) > 0)
+    {
+        return 0;
+    }
+    
+    kmerTable->hashFunction = function;
+    kmerTable->slotReduction = reduction;
+    
+    if(kmerTable->engine == KMER_ENGINE_WIDE)
+    {
+        kmerTable->wide->hashFunction = function;
+    }
+    
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
+    {
+        kmerTable->shards[i].hashFunction = function;
+        kmerTable->shards[i].slotReduction = reduction;
+    }
+    
+    return 1;
+}
+
+int KMerTableSetRemainderBits(KMerHashTable* kmerTable, unsigned int remainderBits)
+{
+    KMerQuotientFilter* filter;
+    
+    if(kmerTable->engine != KMER_ENGINE_QUOTIENT || KMerTableNumEntries(kmerTable) > 0)
+    {
+        return 0;
+    }
+    
+    if((filter = newKMerQuotientFilter(remainderBits)) == NULL)
+    {
+        return 0;
+    }
+    
+    freeKMerQuotientFilter(kmerTable->quotient);
+    kmerTable->quotient = filter;
+    
+    return 1;
+}
+
+unsigned int KMerTableGetHashID(KMerHashTable* kmerTable)
+{
+    return kmerTable->hashFunction | (kmerTable->slotReduction << 8);
+}
+
+void KMerTableGetProbeLengths(KMerHashTable* kmerTable, unsigned long long int* histogram)
+{
+    KMerHashTableShard* shard;
+    unsigned long long int length;
+    
+    for(int i = 0; i <= KMER_TABLE_MAX_PROBE_LENGTH; i++)
+    {
+        histogram[i] = 0;
+    }
+    
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS && kmerTable->engine == KMER_ENGINE_HASH; i++)
+    {
+        shard = &(kmerTable->shards[i]);
+        
+        for(unsigned long long int slot = 0; slot < shard->capacity; slot++)
+        {
+            if(shard->kmers[slot] != KMER_EMPTY)
+            {
+                // Slots examined by a lookup, wrapping around the end:
+                length = ((slot - getHomeSlot(shard, hashKMer(shard, shard->kmers[slot]))) 
+                        & (shard->capacity - 1)) + 1;
+                
+                histogram[length < KMER_TABLE_MAX_PROBE_LENGTH ? length : KMER_TABLE_MAX_PROBE_LENGTH]++;
+            }
+        }
+    }
+}
+
+void freeKMerHashTable(KMerHashTable* kmerTable)
+{
+    KMerHashTableShard* shard;
+    
+    if(kmerTable->engine == KMER_ENGINE_WIDE)
+    {
+        freeKMerWideTable(kmerTable->wide);
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_QUOTIENT)
+    {
+        freeKMerQuotientFilter(kmerTable->quotient);
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_PERFECT)
+    {
+        freeKMerPerfectTable(kmerTable->perfect);
+    }
+    
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS && kmerTable->engine == KMER_ENGINE_HASH; i++)
+    {
+        shard = &(kmerTable->shards[i]);
+        
+        freeMemory(shard->kmers, shard->capacity * sizeof(unsigned long long int));
+        freeMemory(shard->counts, shard->capacity * sizeof(KMerCount));
+        freeMemory(shard->overflowKMers, shard->overflowCapacity * sizeof(unsigned long long int));
+        freeMemory(shard->overflowCounts, shard->overflowCapacity * sizeof(unsigned long long int));
+        freeMemory(shard->pruned, shard->prunedEntries * sizeof(unsigned long long int));
+        
+        pthread_rwlock_destroy(&(shard->lock));
+        pthread_mutex_destroy(&(shard->overflowLock));
+    }
+    
+    // The filters of every shard are allocated together:
+    if(kmerTable->engine == KMER_ENGINE_HASH)
+    {
+        freeMemory(kmerTable->shards[0].filter, kmerTable->shards[0].filterWords * 
+                KMER_TABLE_NUM_SHARDS * sizeof(unsigned long long int));
+    }
+    
+    free(kmerTable);
+}
+
+KMerHashTable* newKMerTable(unsigned int kmerSize, enum KMER_TABLE_ENGINE engine)
+{
+    KMerHashTable* kmerTable;
+    
+    if(engine == KMER_ENGINE_HASH && kmerSize <= KMER_NARROW_MAX_SIZE)
+    {
+        return newKMerHashTable(kmerSize);
+    }
+    
+    // Longer k-mers are hashed in a wide table:
+    if(engine == KMER_ENGINE_HASH)
+    {
+        engine = KMER_ENGINE_WIDE;
+    }
+    
+    // The shards are left empty:
+    if((kmerTable = calloc(1, sizeof *kmerTable)) != NULL)
+    {
+        kmerTable->kmerSize = kmerSize;
+        kmerTable->engine = engine;
+        kmerTable->hashFunction = KMER_HASH_MURMUR;
+        kmerTable->slotReduction = KMER_SLOT_MASK;
+        
+        if(engine == KMER_ENGINE_WIDE)
+        {
+            kmerTable->wide = newKMerWideTable(kmerSize, KMER_HASH_MURMUR);
+        }
+        else if(engine == KMER_ENGINE_QUOTIENT)
+        {
+            kmerTable->quotient = newKMerQuotientFilter(KMER_QUOTIENT_DEFAULT_REMAINDER_BITS);
+        }
+        else
+        {
+            kmerTable->sorted = newKMerSortedTable();
+        }
+        
+        if(kmerTable->wide == NULL && kmerTable->sorted == NULL && kmerTable->quotient == NULL)
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+            exit(1);
+        }
+    }
+    
+    return kmerTable;
 }
 
-void addKMersToTable(KMerHashTable* table, unsigned long long int* sequence, 
-        unsigned int sequenceLength, unsigned int kmerSize)
+int KMerTableReserve(KMerHashTable* kmerTable, unsigned long long int distinct,
+        unsigned long long int repeated)
 {
-    //Variables:
-    unsigned long long int kmer;
-    unsigned long long int count;
+    KMerHashTableShard* shard;
+    unsigned long long int expected;
+    unsigned long long int capacity;
+    
+    // Every distinct k-mer takes a slot, and every repeated k-mer another for 
+    // its count:
+    if(kmerTable->engine == KMER_ENGINE_QUOTIENT)
+    {
+        return KMerQuotientFilterReserve(kmerTable->quotient, distinct + repeated);
+    }
     
-    for(int i = 0; i <= (int)sequenceLength - (int)kmerSize; i++)
+    // Runs are sized as they are sorted:
+    if(kmerTable->engine != KMER_ENGINE_HASH)
     {
-        // Get the next k-mer:
-        kmer = getKMer(sequence, i, i + kmerSize);
+        return 1;
+    }
+    
+    // Only repeated k-mers get past the filter:
+    expected = (kmerTable->shards[0].filter != NULL ? repeated : distinct) / KMER_TABLE_NUM_SHARDS;
+    
+    // Allow for the estimate's error and the uneven spread over shards:
+    expected += expected / 50 + (unsigned long long int)(4 * sqrt((double)expected)) + 16;
+    
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
+    {
+        shard = &(kmerTable->shards[i]);
+        capacity = getCapacityForEntries(shard->entries + expected, 
+                KMER_TABLE_MAX_LOAD_NUMERATOR, KMER_TABLE_MAX_LOAD_DENOMINATOR);
         
-        // Does the k-mer exist?
-        count = (unsigned long long int)hash_table_lookup(table->table, (HashTableKey)(kmer));
-
-        // The k-mer does exist:            
-        if(count != 0)
-        {                    
-            // Update:
-            KMerTableInsert(table, kmer, (count + 1));                
-        }
-        // The k-mer doesn't exist:
-        else
+        if(capacity > shard->capacity && !rebuildShard(shard, capacity, 1))
         {
-            // Initialize:
-            KMerTableInsert(table, kmer, 1);
+            return 0;
         }
-    }    
+    }
+    
+    return 1;
 }
 
-void preprocessKMers(KMerHashTable* kmerTable, Correction* correction)
+int KMerTableFreeze(KMerHashTable* kmerTable)
 {
-    // Data structures:
-    HashTable* hashTable = kmerTable->table;
-    HashTableIterator iterator;
-    
-    unsigned long long int MAX_KMER_COUNT = (1024 + 1);
-    unsigned long long int counts[MAX_KMER_COUNT];
-    
-    unsigned long long int kmer;    
+    KMerHashTableShard* shard;
+    unsigned long long int numKMers = KMerTableNumEntries(kmerTable);
+    unsigned long long int next = 0;
     unsigned long long int count;
+    unsigned long long int* kmers;
+    unsigned int* counts;
     
-    unsigned long long int current = 0;
-    unsigned long long int total = hash_table_num_entries(hashTable);
-    
-    unsigned long long int unique = 0;
+    // The other engines are read-only as they are:
+    if(kmerTable->engine != KMER_ENGINE_HASH)
+    {
+        return 1;
+    }
     
-    hash_table_iterate(hashTable, &iterator);
+    kmers = (unsigned long long int*)malloc((numKMers + 1) * sizeof(unsigned long long int));
+    counts = (unsigned int*)malloc((numKMers + 1) * sizeof(unsigned int));
     
-    // Initialize Counts:
-    for (int i = 0; i < MAX_KMER_COUNT; i++)
+    if(kmers == NULL || counts == NULL)
     {
-        counts[i] = 0;
+        free(kmers);
+        free(counts);
+        
+        return 0;
     }
     
-    // Iterate Over K-Mers:
-    while(hash_table_iter_has_more(&iterator))
+    // Release each shard as soon as its k-mers are copied:
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
     {
-        printProgress(current, total, 20);
-        current++;
+        shard = &(kmerTable->shards[i]);
         
-        kmer = (unsigned long long int)hash_table_iter_next_key(&iterator);
-        count = (unsigned long long int)hash_table_lookup(hashTable, (HashTableKey)(kmer));
-
-        // Tally Counts:
-        if(count <= MAX_KMER_COUNT)
+        for(unsigned long long int slot = 0; slot < shard->capacity; slot++)
         {
-            counts[count] += 1;
+            if(shard->kmers[slot] != KMER_EMPTY)
+            {
+                count = getCount(shard, slot);
+                
+                kmers[next] = shard->kmers[slot];
+                counts[next] = count < UINT_MAX ? (unsigned int)count : UINT_MAX;
+                next++;
+            }
         }
         
-        // Remove Unique:
-        if(count == 1)
-        {
-            hash_table_remove(hashTable, (HashTableKey)(kmer), false);
-            unique++;
-        }
+        freeMemory(shard->kmers, shard->capacity * sizeof(unsigned long long int));
+        freeMemory(shard->counts, shard->capacity * sizeof(KMerCount));
+        freeMemory(shard->overflowKMers, shard->overflowCapacity * sizeof(unsigned long long int));
+        freeMemory(shard->overflowCounts, shard->overflowCapacity * sizeof(unsigned long long int));
+        freeMemory(shard->pruned, shard->prunedEntries * sizeof(unsigned long long int));
+        
+        pthread_rwlock_destroy(&(shard->lock));
+        pthread_mutex_destroy(&(shard->overflowLock));
+        
+        shard->kmers = NULL;
+        shard->counts = NULL;
+        shard->capacity = 0;
+        shard->entries = 0;
+        shard->pruned = NULL;
+        shard->prunedEntries = 0;
     }
     
-    // Unique K-Mer Information:
-    printf("\n");    
-    printf("Removed %llu unique k-mers from the set of %llu total k-mers.\n", unique, total);
+    freeMemory(kmerTable->shards[0].filter, kmerTable->shards[0].filterWords * 
+            KMER_TABLE_NUM_SHARDS * sizeof(unsigned long long int));
     
-    printf("Resizing...\n");
-    hash_table_resize(hashTable);
-    printf("Finished resizing...\n");
+    kmerTable->perfect = newKMerPerfectTable(kmers, counts, next, kmerTable->hashFunction);
+    kmerTable->engine = KMER_ENGINE_PERFECT;
     
-    unsigned int currentKMerCount = 1;
-        
-    // Loop until we find a low-to-high number transitions:
-    while (currentKMerCount <= MAX_KMER_COUNT && counts[currentKMerCount] > counts[currentKMerCount + 1])
+    free(kmers);
+    free(counts);
+    
+    return kmerTable->perfect != NULL;
+}
+
+KMerHashTable* KMerTableReplicate(KMerHashTable* kmerTable, int node)
+{
+    KMerHashTable* copy;
+    
+    if(kmerTable->engine != KMER_ENGINE_PERFECT || (copy = malloc(sizeof *copy)) == NULL)
     {
-        currentKMerCount++;
+        return NULL;
     }
     
-    if(currentKMerCount < MAX_KMER_COUNT)
+    // The shards were released when the table was frozen:
+    *copy = *kmerTable;
+    
+    if((copy->perfect = copyKMerPerfectTable(kmerTable->perfect, node)) == NULL)
     {
-        correction->lowKMerThreshold = currentKMerCount;
+        free(copy);
+        return NULL;
     }
     
-   printf("Low k-mer count value was observed to be %d.\n", currentKMerCount);
+    return copy;
 }
 
-int KMerHashFunctionEquals(HashTableValue value1, HashTableValue value2)
+int KMerTablePlace(KMerHashTable* kmerTable, int node)
 {
-    return (value1 == value2);
+    return kmerTable->engine == KMER_ENGINE_PERFECT && 
+            KMerPerfectTablePlace(kmerTable->perfect, node);
 }
 
-unsigned long KMerHashFunctionHash(HashTableKey kmer)
+double KMerTableGetLocality(KMerHashTable* kmerTable, unsigned int node)
 {
-    return (unsigned long)kmer;
+    if(kmerTable->engine != KMER_ENGINE_PERFECT)
+    {
+        return -1;
+    }
+    
+    return KMerPerfectTableGetLocality(kmerTable->perfect, node);
 }
 
-KMerHashTable* newKMerHashTable()
+int KMerTableSetFilter(KMerHashTable* kmerTable, unsigned long long int size)
 {
-    HashTable* hashTable = hash_table_new(KMerHashFunctionHash, KMerHashFunctionEquals);    
-    KMerHashTable* kmerTable;
+    unsigned long long int words = 1;
+    unsigned long long int* filter;
     
-    if((kmerTable = malloc(sizeof *kmerTable)) != NULL)
+    if(kmerTable->engine != KMER_ENGINE_HASH || kmerTable->shards[0].filter != NULL)
+    {
+        return 0;
+    }
+    
+    // The largest power of two that fits each shard's share:
+    while(words * 2 * sizeof(unsigned long long int) * KMER_TABLE_NUM_SHARDS <= size)
+    {
+        words *= 2;
+    }
+    
+    // One allocation, shared out between the shards:
+    if((filter = (unsigned long long int*)allocateMemory(
+            words * KMER_TABLE_NUM_SHARDS * sizeof(unsigned long long int))) == NULL)
+    {
+        return 0;
+    }
+    
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
     {
-        kmerTable->table = hashTable;
+        kmerTable->shards[i].filter = &(filter[i * words]);
+        kmerTable->shards[i].filterWords = words;
     }
+    
+    return 1;
+}
 
-    return kmerTable;
+void KMerTableKeepPruned(KMerHashTable* kmerTable, int keep)
+{
+    KMerHashTableShard* shard;
+    
+    if(kmerTable->engine != KMER_ENGINE_HASH || kmerTable->shards[0].filter != NULL)
+    {
+        return;
+    }
+    
+    kmerTable->keepPruned = keep;
+    
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS && !keep; i++)
+    {
+        shard = &(kmerTable->shards[i]);
+        
+        freeMemory(shard->pruned, shard->prunedEntries * sizeof(unsigned long long int));
+        shard->pruned = NULL;
+        shard->prunedEntries = 0;
+    }
 }
 
 int KMerTableInsert(KMerHashTable* kmerTable, unsigned long long int kmer, unsigned long long int count)
 {
-    return hash_table_insert(kmerTable->table, (HashTableKey)(kmer), (HashTableValue)(count));
+    KMerHashTableShard* shard;
+    unsigned long long int slot;
+    
+    if(kmerTable->engine != KMER_ENGINE_HASH)
+    {
+        return 0;
+    }
+    
+    kmerTable->hasStatistics = 0;
+    kmer = getCanonicalKMer(kmer, kmerTable->kmerSize);
+    shard = getShard(kmerTable, kmer);
+    slot = findSlot(shard, kmer);
+    
+    // Overwrite:
+    if(shard->kmers[slot] == kmer)
+    {
+        setCount(shard, slot, count);
+        
+        return 1;
+    }
+    
+    return addToKMer(shard, kmer, count);
 }
 
 /**
  * 
  * BE EXTREMELY CAREFUL USING THIS LOCALLY!!
  * 
- * SAFER: count = (unsigned long long int)hash_table_lookup(kmerTable->table, (HashTableKey)(kmer));
- *      - Might miss singletons.
+ * Missing k-mers (singletons, which are removed during preprocessing) are 
+ * reported as having a count of 1.
  * 
  */
 unsigned long long int KMerTableLookup(KMerHashTable* kmerTable, unsigned long long int kmer)
 {
-    unsigned long long int count;    
-    HashTableValue value = hash_table_lookup(kmerTable->table, (HashTableKey)(kmer));
+    return KMerTableLookupCanonical(kmerTable, getCanonicalKMer(kmer, kmerTable->kmerSize));
+}
+
+unsigned long long int KMerTableLookupCanonical(KMerHashTable* kmerTable, unsigned long long int kmer)
+{
+    KMerHashTableShard* shard;
+    unsigned long long int slot;
+    unsigned long long int count;
     
-    count = (unsigned long long int)value;
+    if(kmerTable->engine == KMER_ENGINE_SORT)
+    {
+        count = KMerSortedTableLookup(kmerTable->sorted, kmer);
+        
+        return count > 0 ? count : 1;
+    }
     
-    if(count == 0)
+    // Wide k-mers do not fit in the argument (see KMerTableLookupSequence):
+    if(kmerTable->engine == KMER_ENGINE_WIDE)
+    {
+        return 1;
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_PERFECT)
+    {
+        count = KMerPerfectTableLookup(kmerTable->perfect, kmer);
+        
+        return count > 0 ? count : 1;
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_QUOTIENT)
+    {
+        count = KMerQuotientFilterLookup(kmerTable->quotient, 
+                hashKMerWith(kmerTable->hashFunction, kmer));
+        
+        return count > 0 ? count : 1;
+    }
+    
+    shard = getShard(kmerTable, kmer);
+    slot = findSlot(shard, kmer);
+    
+    if(shard->kmers[slot] == KMER_EMPTY)
     {
-        count = 1;
+        return 1;
     }
     
-    return count;
+    return getCount(shard, slot);
 }
 
-unsigned int getMaxKMerCount(KMerHashTable* kmerTable)
+void KMerTableLookupBatch(KMerHashTable* kmerTable, unsigned long long int* kmers,
+        unsigned int numKMers, unsigned int* counts)
 {
-    HashTable* hashTable = kmerTable->table;
-    HashTableIterator iterator;
-    unsigned long long int kmer;
+    KMerHashTableShard* shards[KMER_LOOKUP_GROUP];
+    unsigned long long int slots[KMER_LOOKUP_GROUP];
+    unsigned long long int hash;
+    unsigned int size;
     
-    unsigned long long int current = 0;
-    unsigned long long int max = 0;    
+    if(kmerTable->engine == KMER_ENGINE_PERFECT)
+    {
+        KMerPerfectTableLookupBatch(kmerTable->perfect, kmers, numKMers, counts);
+        
+        for(unsigned int i = 0; i < numKMers; i++)
+        {
+            counts[i] = counts[i] > 0 ? counts[i] : 1;
+        }
+        
+        return;
+    }
     
-    hash_table_iterate(hashTable, &iterator);
+    if(kmerTable->engine != KMER_ENGINE_HASH)
+    {
+        for(unsigned int i = 0; i < numKMers; i++)
+        {
+            counts[i] = KMerTableLookupCanonical(kmerTable, kmers[i]);
+        }
+        
+        return;
+    }
     
-    while(hash_table_iter_has_more(&iterator))
+    for(unsigned int start = 0; start < numKMers; start += KMER_LOOKUP_GROUP)
     {
-        kmer = (unsigned long long int)hash_table_iter_next_key(&iterator);
-        current = KMerTableLookup(kmerTable, kmer);
+        size = numKMers - start < KMER_LOOKUP_GROUP ? numKMers - start : KMER_LOOKUP_GROUP;
+        
+        // Find the first slot of every k-mer and start loading it:
+        for(unsigned int i = 0; i < size; i++)
+        {
+            hash = hashKMerWith(kmerTable->hashFunction, kmers[start + i]);
+            
+            shards[i] = &(kmerTable->shards[getShardIndex(hash)]);
+            slots[i] = getHomeSlot(shards[i], hash);
+            
+            __builtin_prefetch(&(shards[i]->kmers[slots[i]]));
+            __builtin_prefetch(&(shards[i]->counts[slots[i]]));
+        }
         
-        max = getMax(current, max);
+        // By now, the first slots have arrived or are on their way:
+        for(unsigned int i = 0; i < size; i++)
+        {
+            slots[i] = probeSlot(shards[i], kmers[start + i], slots[i]);
+            
+            if(shards[i]->kmers[slots[i]] == KMER_EMPTY)
+            {
+                counts[start + i] = 1;
+            }
+            else
+            {
+                counts[start + i] = getCount(shards[i], slots[i]);
+            }
+        }
+    }
+}
+
+void KMerTableLookupSequence(KMerHashTable* kmerTable, unsigned long long int* sequence,
+        unsigned int sequenceLength, unsigned int* counts)
+{
+    int total = (int)sequenceLength - (int)kmerTable->kmerSize + 1;
+    
+    if(kmerTable->engine == KMER_ENGINE_WIDE)
+    {
+        KMerWideTableLookupSequence(kmerTable->wide, sequence, sequenceLength, counts);
+        return;
+    }
+    
+    if(total <= 0)
+    {
+        return;
     }
     
-    return max;
+    unsigned long long int kmers[total];
+    getCanonicalKMers(sequence, sequenceLength, kmerTable->kmerSize, kmers);
+    
+    KMerTableLookupBatch(kmerTable, kmers, total, counts);
 }
 
-unsigned int* createDistribution(KMerHashTable* kmerTable, unsigned int max)
-{    
-    // Data structures:
-    HashTable* hashTable = kmerTable->table;
-    HashTableIterator iterator;
-    unsigned int* distribution = (unsigned int*)malloc((max + 1) * sizeof(unsigned int*));
+unsigned long long int KMerTableNumEntries(KMerHashTable* kmerTable)
+{
+    unsigned long long int entries = 0;
     
-    unsigned long long int kmer;    
-    unsigned long long int current;
+    if(kmerTable->engine == KMER_ENGINE_SORT)
+    {
+        return kmerTable->sorted->frozen.length;
+    }
     
-    // Initialize:
-    for(int i = 0; i <= max; i++)
+    if(kmerTable->engine == KMER_ENGINE_WIDE)
+    {
+        return KMerWideTableNumEntries(kmerTable->wide);
+    }
+    
+    if(kmerTable->engine == KMER_ENGINE_QUOTIENT)
     {
-        distribution[i] = 0;
+        return KMerQuotientFilterNumEntries(kmerTable->quotient);
     }
     
-    hash_table_iterate(hashTable, &iterator);
+    if(kmerTable->engine == KMER_ENGINE_PERFECT)
+    {
+        return kmerTable->perfect->numKMers;
+    }
     
-    while(hash_table_iter_has_more(&iterator))
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
     {
-        kmer = (unsigned long long int)hash_table_iter_next_key(&iterator);
-        current = KMerTableLookup(kmerTable, kmer);
+        entries += kmerTable->shards[i].entries;
+    }
+    
+    return entries;
+}
 
-        distribution[current]++;
+/* Advances the iterator to the next occupied slot, at or after its position. */
+static void findNextEntry(KMerHashTableIterator* iterator)
+{
+    KMerHashTableShard* shard;
+    
+    // The sorting engine has a single array:
+    if(iterator->table->engine == KMER_ENGINE_SORT)
+    {
+        if(iterator->next >= iterator->table->sorted->frozen.length)
+        {
+            iterator->shard = KMER_TABLE_NUM_SHARDS;
+        }
+        
+        return;
     }
     
-    return distribution;
+    // So does a perfect hash table:
+    if(iterator->table->engine == KMER_ENGINE_PERFECT)
+    {
+        if(iterator->next >= iterator->table->perfect->numKMers)
+        {
+            iterator->shard = KMER_TABLE_NUM_SHARDS;
+        }
+        
+        return;
+    }
+    
+    while(iterator->shard < KMER_TABLE_NUM_SHARDS && iterator->table->engine == KMER_ENGINE_QUOTIENT)
+    {
+        if(KMerQuotientShardSeek(&(iterator->table->quotient->shards[iterator->shard]), &(iterator->next)))
+        {
+            return;
+        }
+        
+        // Try the next shard:
+        iterator->shard++;
+        iterator->next = 0;
+        iterator->quotient = 0;
+    }
+    
+    while(iterator->shard < KMER_TABLE_NUM_SHARDS)
+    {
+        shard = &(iterator->table->shards[iterator->shard]);
+        
+        while(iterator->next < shard->capacity)
+        {
+            if(shard->kmers[iterator->next] != KMER_EMPTY)
+            {
+                return;
+            }
+            
+            iterator->next++;
+        }
+        
+        // Try the next shard:
+        iterator->shard++;
+        iterator->next = 0;
+    }
 }
 
-unsigned int getNumRepeats(KMerHashTable* kmerTable)
-{   
-    // Variables:
-    unsigned int repeats = 0;
-    unsigned int max = getMaxKMerCount(kmerTable);
+void KMerTableIterate(KMerHashTable* kmerTable, KMerHashTableIterator* iterator)
+{
+    iterator->table = kmerTable;
+    iterator->shard = 0;
+    iterator->next = 0;
+    iterator->quotient = 0;
+    
+    // Find the first entry:
+    findNextEntry(iterator);
+}
+
+bool KMerTableIterHasMore(KMerHashTableIterator* iterator)
+{
+    return iterator->shard < KMER_TABLE_NUM_SHARDS;
+}
+
+unsigned long long int KMerTableIterNext(KMerHashTableIterator* iterator, 
+        unsigned long long int* count)
+{
+    KMerHashTableShard* shard = &(iterator->table->shards[iterator->shard]);
+    unsigned long long int slot = iterator->next;
+    unsigned long long int fingerprint;
+    KMerRun* frozen;
+    
+    // The quotient filter only has the fingerprints of its k-mers:
+    if(iterator->table->engine == KMER_ENGINE_QUOTIENT)
+    {
+        KMerQuotientShardNext(&(iterator->table->quotient->shards[iterator->shard]),
+                &(iterator->next), &(iterator->quotient), &fingerprint, count);
+        findNextEntry(iterator);
+        
+        return fingerprint;
+    }
+    
+    if(iterator->table->engine == KMER_ENGINE_PERFECT)
+    {
+        *count = KMerPerfectTableGetCount(iterator->table->perfect, slot);
+        
+        iterator->next++;
+        findNextEntry(iterator);
+        
+        return iterator->table->perfect->kmers[slot];
+    }
+    
+    if(iterator->table->engine == KMER_ENGINE_SORT)
+    {
+        frozen = &(iterator->table->sorted->frozen);
+        *count = frozen->counts[slot];
+        
+        iterator->next++;
+        findNextEntry(iterator);
+        
+        return frozen->kmers[slot];
+    }
+    
+    *count = getCount(shard, slot);
+    
+    // Find the next entry:
+    iterator->next++;
+    findNextEntry(iterator);
     
-    // Data Structures:
-    unsigned int* distribution = createDistribution(kmerTable, max);    
+    return shard->kmers[slot];
+}
+
+/* Adds the counts of the k-mers in a range of shards to the statistics. The 
+ * engines with a single array are summarized by the thread given the first 
+ * shard. */
+static void gatherShards(KMerHashTable* kmerTable, unsigned int firstShard, 
+        unsigned int lastShard, KMerStatistics* statistics)
+{
+    KMerHashTableIterator iterator;
+    KMerHashTableShard* shard;
+    unsigned long long int count;
+    unsigned long long int tallied;
+    
+    if(kmerTable->engine == KMER_ENGINE_WIDE)
+    {
+        KMerWideTableGatherStatistics(kmerTable->wide, 
+                firstShard * KMER_WIDE_NUM_SHARDS / KMER_TABLE_NUM_SHARDS, 
+                lastShard * KMER_WIDE_NUM_SHARDS / KMER_TABLE_NUM_SHARDS, statistics);
+        return;
+    }
+    
+    // The tallies and the overflow map hold every count of a hashed shard:
+    if(kmerTable->engine == KMER_ENGINE_HASH)
+    {
+        for(unsigned int i = firstShard; i < lastShard; i++)
+        {
+            shard = &(kmerTable->shards[i]);
+            tallied = 0;
+            
+            for(count = 1; count < KMER_COUNT_SATURATED; count++)
+            {
+                KMerStatisticsAdd(statistics, count, shard->histogram[count]);
+                tallied += shard->histogram[count];
+            }
+            
+            // Saturated k-mers; the overflow counts of the others are 0:
+            for(unsigned long long int j = 0; j < shard->overflowCapacity; j++)
+            {
+                if(shard->overflowKMers[j] != KMER_EMPTY)
+                {
+                    KMerStatisticsAdd(statistics, shard->overflowCounts[j], 1);
+                }
+            }
+            
+            // A mapped index is never tallied (see readKMerIndex):
+            for(unsigned long long int j = 0; tallied == 0 && j < shard->capacity; j++)
+            {
+                if(shard->kmers[j] != KMER_EMPTY && shard->counts[j] != KMER_COUNT_SATURATED)
+                {
+                    KMerStatisticsAdd(statistics, shard->counts[j], 1);
+                }
+            }
+        }
+        
+        return;
+    }
+    
+    // The sorting engine and a perfect hash table have a single array:
+    if(kmerTable->engine != KMER_ENGINE_QUOTIENT && firstShard != 0)
+    {
+        return;
+    }
+    
+    iterator.table = kmerTable;
+    iterator.shard = firstShard;
+    iterator.next = 0;
+    iterator.quotient = 0;
+    
+    findNextEntry(&iterator);
+    
+    while(iterator.shard < lastShard)
+    {
+        KMerTableIterNext(&iterator, &count);
+        KMerStatisticsAdd(statistics, count, 1);
+    }
+}
+
+// A range of shards, summarized by one thread:
+typedef struct
+{
+    KMerHashTable* kmerTable;
+    unsigned int firstShard;
+    unsigned int lastShard;
+    
+    KMerStatistics statistics;
+} StatisticsThread;
+
+static void* gatherShardsThread(void* arg)
+{
+    StatisticsThread* thread = (StatisticsThread*)arg;
+    
+    gatherShards(thread->kmerTable, thread->firstShard, thread->lastShard, 
+            &(thread->statistics));
+    
+    return NULL;
+}
 
-    for(int i = 2; i <= max; i++)
+KMerStatistics* KMerTableGetStatistics(KMerHashTable* kmerTable, unsigned int numThreads)
+{
+    KMerStatistics* statistics = &(kmerTable->statistics);
+    StatisticsThread* threads;
+    
+    if(kmerTable->hasStatistics)
+    {
+        return statistics;
+    }
+    
+    clearKMerStatistics(statistics);
+    numThreads = (numThreads < KMER_TABLE_NUM_SHARDS) ? numThreads : KMER_TABLE_NUM_SHARDS;
+    
+    // Single threaded:
+    if(numThreads <= 1 || (threads = calloc(numThreads, sizeof(StatisticsThread))) == NULL)
+    {
+        gatherShards(kmerTable, 0, KMER_TABLE_NUM_SHARDS, statistics);
+    }
+    else
     {
-        repeats += distribution[i] * i;
+        pthread_t handles[numThreads];
+        
+        // Multithreaded: each thread summarizes a contiguous range of shards.
+        for(unsigned int t = 0; t < numThreads; t++)
+        {
+            threads[t].kmerTable = kmerTable;
+            threads[t].firstShard = KMER_TABLE_NUM_SHARDS * t / numThreads;
+            threads[t].lastShard = KMER_TABLE_NUM_SHARDS * (t + 1) / numThreads;
+            
+            pthread_create(&handles[t], NULL, gatherShardsThread, &threads[t]);
+        }
+        
+        for(unsigned int t = 0; t < numThreads; t++)
+        {
+            pthread_join(handles[t], NULL);
+            KMerStatisticsMerge(statistics, &(threads[t].statistics));
+        }
+        
+        free(threads);
     }
     
-    free(distribution);
+    KMerStatisticsFinish(statistics);
+    kmerTable->hasStatistics = 1;
+    
+    return statistics;
+}
+
+unsigned int getMaxKMerCount(KMerHashTable* kmerTable)
+{
+    return KMerTableGetStatistics(kmerTable, 1)->maxCount;
+}
+
+unsigned int* createDistribution(KMerHashTable* kmerTable, unsigned int max)
+{    
+    KMerStatistics* statistics = KMerTableGetStatistics(kmerTable, 1);
+    unsigned int* distribution = (unsigned int*)calloc(max + 1, sizeof(unsigned int));
     
-    return repeats;
+    for(unsigned int i = 0; i <= max && i <= KMER_HISTOGRAM_MAX_COUNT && distribution != NULL; i++)
+    {
+        distribution[i] = (unsigned int)statistics->histogram[i];
+    }
+    
+    return distribution;
+}
+
+unsigned int getNumRepeats(KMerHashTable* kmerTable)
+{   
+    return (unsigned int)KMerTableGetStatistics(kmerTable, 1)->repeats;
 }
 
 
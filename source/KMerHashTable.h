@@ -18,8 +18,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 */
 
+#include <pthread.h>
 #include "Globals.h"
-#include "hash-table.h"
+#include "Utility.h"
+#include "KMerSortedTable.h"
+#include "KMerHash.h"
+#include "KMerWideTable.h"
+#include "KMerQuotientFilter.h"
+#include "KMerPerfectTable.h"
+#include "KMerStatistics.h"
+#include "Numa.h"
 
 #ifndef KMERHASHTABLE_H
 #define	KMERHASHTABLE_H
@@ -27,18 +35,347 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef	__cplusplus
 extern "C" {
 #endif
+
+/**
+ * The k-mer table is a flat, open-addressing (linear probing) hash table. The 
+ * k-mer keys and their counts are stored in two parallel arrays, such that a 
+ * slot is identified by the same index in both arrays. An empty slot is marked 
+ * with the KMER_EMPTY key, which can never be produced by getKMer: k-mers are 
+ * at most 31 bases long and left-aligned, so their lowest two bits are always 0.
+ * 
+ * Only canonical k-mers (see getCanonicalKMer) are stored. A k-mer and its 
+ * reverse compliment share a single entry, and the public functions accept 
+ * either strand.
+ * 
+ * The table is partitioned into KMER_TABLE_NUM_SHARDS independent shards. The 
+ * high bits of a k-mer's hash select its shard and the remaining bits select 
+ * its slot within the shard (see KMerHash.h and KMerTableSetHash). Each shard 
+ * grows on its own.
+ * 
+ * Several threads may count into the table at once (see KMerHashTableBuffer). 
+ * They share each shard directly: a new k-mer claims its slot with a 
+ * compare-and-swap on the key, and counts are incremented atomically, so 
+ * inserting or incrementing a k-mer is a single atomic operation. A shard's 
+ * lock is only held exclusively while that shard grows; counting threads hold 
+ * it shared and never wait on each other.
+ * 
+ * Optionally, each shard has a Bloom filter (see KMerTableSetFilter) that keeps 
+ * k-mers out of the shard until their second occurrence, when they are added 
+ * with a count that includes the first. Most distinct k-mers are singletons 
+ * caused by sequencing errors, which are removed by preprocessing anyway, so 
+ * they are only recorded as a number. A k-mer's filter bits all lie in one 
+ * 64-bit word, so threads can test and set them with one atomic operation.
+ * 
+ * Counts are stored in 8-bit saturating counters. Almost every k-mer has a 
+ * count below KMER_COUNT_SATURATED; the few that reach it have their exact 
+ * count kept in a small overflow map in their shard, keyed by k-mer.
+ * 
+ * Each shard also tallies how many of its k-mers have each count below 
+ * KMER_COUNT_SATURATED, updating the tally whenever a count changes. Together 
+ * with the overflow map, this gives the distribution of counts without walking 
+ * the table, which is what preprocessing uses to find the low k-mer threshold.
+ * 
+ * The statistics of the whole table (see KMerStatistics.h) are gathered by 
+ * several threads in one pass and kept with the table until it is counted into 
+ * or pruned again, so that every reader shares the same pass.
+ * 
+ * Instead of hashing, a table may count its k-mers by sorting them (see 
+ * KMerSortedTable.h). The functions below behave the same for either engine, 
+ * except that a sorted table has no shards: it cannot be filtered, pruned one 
+ * shard at a time or saved as an index.
+ * 
+ * A table may also count into a counting quotient filter (see 
+ * KMerQuotientFilter.h), which keeps a short fingerprint of each k-mer's hash 
+ * in a fraction of the memory, at the cost of rare false positives: a k-mer 
+ * that shares its fingerprint with another takes that k-mer's count. Its 
+ * shards are the same as the table's, so it can be pruned one shard at a time, 
+ * but it cannot be filtered or saved as an index, and its iterator returns 
+ * fingerprints instead of k-mers.
+ * 
+ * Once counting is done, a hashed table can be frozen (see KMerTableFreeze) 
+ * into a read-only table indexed by a minimal perfect hash (see 
+ * KMerPerfectTable.h), which takes less memory and fewer probes to look up.
+ * 
+ * K-mers longer than KMER_NARROW_MAX_SIZE do not fit in the 64-bit keys. A 
+ * table created for them hashes them into a wide table (see KMerWideTable.h) 
+ * instead, with the same limitations as a sorted table. Such k-mers can only 
+ * be counted and looked up a sequence at a time.
+ */
+#define KMER_EMPTY 0xFFFFFFFFFFFFFFFFULL
+
+#define KMER_TABLE_SHARD_BITS 8
+#define KMER_TABLE_NUM_SHARDS (1 << KMER_TABLE_SHARD_BITS)
+
+// Partitioned counting relies on a quotient filter having the same shards:
+#if KMER_QUOTIENT_SHARD_BITS != KMER_TABLE_SHARD_BITS
+#error "The quotient filter and k-mer table shards differ."
+#endif
+
+enum KMER_TABLE_ENGINE
+{
+    KMER_ENGINE_HASH,
+    KMER_ENGINE_SORT,
+    KMER_ENGINE_WIDE,                       // Chosen by newKMerTable for long k-mers.
+    KMER_ENGINE_QUOTIENT,
+    KMER_ENGINE_PERFECT,                    // Set by KMerTableFreeze.
+};
+
+typedef unsigned char KMerCount;
+#define KMER_COUNT_SATURATED 255
+
+// The memory used by one slot: a k-mer key and its count.
+#define KMER_TABLE_SLOT_BYTES (sizeof(unsigned long long int) + sizeof(KMerCount))
+
+/* The most memory a new k-mer may need while it is being counted. A shard 
+ * grows when it is 7/10 full, and holds both its old and doubled arrays while 
+ * it grows: 3 * 10/7 slots per k-mer. */
+#define KMER_TABLE_PEAK_BYTES_PER_KMER (KMER_TABLE_SLOT_BYTES * 30 / 7 + 1)
+
+/* The most memory a k-mer kept by pruning may need. A pruned shard is rebuilt 
+ * at least 1/4 full: 4 slots per k-mer. */
+#define KMER_TABLE_KEPT_BYTES_PER_KMER (KMER_TABLE_SLOT_BYTES * 4)
+
+/* The overflow map of a shard holds the k-mers whose counts saturated, with 
+ * their exact counts. It starts with this many slots and doubles when half 
+ * full, holding both its old and new arrays while it grows: at most 6 slots 
+ * of 16 bytes per k-mer. */
+#define KMER_TABLE_OVERFLOW_MINIMUM_CAPACITY 16
+#define KMER_TABLE_OVERFLOW_PEAK_BYTES_PER_KMER (6 * 2 * sizeof(unsigned long long int))
+
+// Longer probe sequences are tallied together by KMerTableGetProbeLengths.
+#define KMER_TABLE_MAX_PROBE_LENGTH 64
+#define KMER_PROBE_HISTOGRAM_SIZE (KMER_TABLE_MAX_PROBE_LENGTH + 1)
+
+typedef struct
+{
+    unsigned long long int* kmers;          // Packed k-mer keys.
+    KMerCount* counts;                      // Counts, indexed by slot.
+    
+    unsigned long long int capacity;        // Number of slots (power of two).
+    unsigned long long int entries;         // Number of occupied slots.
+    
+    pthread_rwlock_t lock;                  // Exclusive only while growing.
+    unsigned long long int reserved;        // Slots promised to counting threads.
+    
+    unsigned long long int* filter;         // Bloom filter words, or NULL.
+    unsigned long long int filterWords;     // Number of words (power of two).
+    long long int singletons;               // K-mers held back by the filter.
+    
+    unsigned long long int* overflowKMers;  // Saturated k-mers.
+    unsigned long long int* overflowCounts; // Their exact counts.
+    unsigned long long int overflowCapacity;
+    unsigned long long int overflowEntries;
+    pthread_mutex_t overflowLock;           // Held while threads update it.
+    
+    unsigned long long int* pruned;         // K-mers pruned, if kept, or NULL.
+    unsigned long long int prunedEntries;   // Number of k-mers pruned.
     
+    // The number of k-mers with each count below KMER_COUNT_SATURATED:
+    unsigned long long int histogram[KMER_COUNT_SATURATED];
+    
+    // Copied from the table, for functions given only the shard:
+    enum KMER_HASH_FUNCTION hashFunction;
+    enum KMER_SLOT_REDUCTION slotReduction;
+} KMerHashTableShard;
+
 typedef struct
 {
-    HashTable* table;
+    KMerHashTableShard shards[KMER_TABLE_NUM_SHARDS];
+    
+    unsigned int kmerSize;                  // The length of the k-mers.
+    
+    enum KMER_TABLE_ENGINE engine;
+    KMerSortedTable* sorted;                // Used by KMER_ENGINE_SORT.
+    KMerWideTable* wide;                    // Used by KMER_ENGINE_WIDE.
+    KMerQuotientFilter* quotient;           // Used by KMER_ENGINE_QUOTIENT.
+    KMerPerfectTable* perfect;              // Used by KMER_ENGINE_PERFECT.
+    
+    enum KMER_HASH_FUNCTION hashFunction;
+    enum KMER_SLOT_REDUCTION slotReduction;
+    
+    KMerStatistics statistics;              // See KMerTableGetStatistics.
+    int hasStatistics;                      // Whether they are up to date.
+    
+    int keepPruned;                         // See KMerTableKeepPruned.
 } KMerHashTable;
 
+/**
+ * Structure used to iterate over the occupied slots of a k-mer table.
+ */
+typedef struct
+{
+    KMerHashTable* table;
+    unsigned int shard;                     // Shard of the next slot.
+    unsigned long long int next;            // Next slot to examine.
+    unsigned long long int quotient;        // Quotient of the last fingerprint.
+} KMerHashTableIterator;
+
+/**
+ * A per-thread staging area for counting k-mers into a shared table. K-mers 
+ * are collected by destination shard and each full group is added to its shard 
+ * at once. Room for the whole group is reserved up front, so the shard can 
+ * never fill while threads are inserting into it without holding it exclusively.
+ * 
+ * With the sorting engine, the k-mers are collected as a single group of 
+ * KMER_SORTED_BATCH_SIZE, which is sorted into a run when full.
+ */
+typedef struct
+{
+    KMerHashTable* table;
+    
+    unsigned long long int* kmers;          // KMER_TABLE_NUM_SHARDS groups.
+    unsigned int sizes[KMER_TABLE_NUM_SHARDS];
+} KMerHashTableBuffer;
+
 /**
  * Creates a new KMerHashTable.
  * 
- * @return 
+ * @param kmerSize The length of the k-mers the table will hold.
+ * @return The new k-mer table, or NULL if it could not be allocated.
+ */
+KMerHashTable* newKMerHashTable(unsigned int kmerSize);
+
+/**
+ * Changes how k-mers are placed in the table. New tables use KMER_HASH_MURMUR 
+ * with KMER_SLOT_MASK. This must be done before any k-mer is added.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param function The hash function.
+ * @param reduction How hashes are reduced to slots.
+ * @return Non-zero on success, 0 if the table is not empty, does not hash its 
+ *      k-mers or the hash function is not supported.
+ */
+int KMerTableSetHash(KMerHashTable* kmerTable, enum KMER_HASH_FUNCTION function,
+        enum KMER_SLOT_REDUCTION reduction);
+
+/**
+ * Changes the number of bits a quotient filter table stores for each k-mer. 
+ * New tables store KMER_QUOTIENT_DEFAULT_REMAINDER_BITS. This must be done 
+ * before any k-mer is added.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param remainderBits The number of bits, from 1 to 32.
+ * @return Non-zero on success, 0 if the table is not empty, is not a quotient 
+ *      filter or the filter could not be allocated.
+ */
+int KMerTableSetRemainderBits(KMerHashTable* kmerTable, unsigned int remainderBits);
+
+/**
+ * Returns a number identifying the hash function and slot reduction of the 
+ * table, as saved in k-mer indexes: the hash function in the low byte and the 
+ * slot reduction in the next.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @return The hash identifier.
+ */
+unsigned int KMerTableGetHashID(KMerHashTable* kmerTable);
+
+/**
+ * Tallies the number of slots a lookup examines to find each k-mer of the 
+ * table. Entry i of the histogram receives the number of k-mers found in i 
+ * slots; the last entry also receives every longer probe sequence.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param histogram The histogram, of size KMER_PROBE_HISTOGRAM_SIZE.
+ */
+void KMerTableGetProbeLengths(KMerHashTable* kmerTable, unsigned long long int* histogram);
+
+/**
+ * Releases a k-mer table created by newKMerHashTable.
+ * 
+ * @param kmerTable The kmer table to release.
  */
-KMerHashTable* newKMerHashTable();
+void freeKMerHashTable(KMerHashTable* kmerTable);
+
+/**
+ * Creates a new k-mer table that counts with the given engine.
+ * 
+ * @param kmerSize The length of the k-mers the table will hold.
+ * @param engine The counting engine.
+ * @return The new k-mer table, or NULL if it could not be allocated.
+ */
+KMerHashTable* newKMerTable(unsigned int kmerSize, enum KMER_TABLE_ENGINE engine);
+
+/**
+ * Grows the table once, up front, so that it can count the k-mers of a file 
+ * without growing again. Only the repeated k-mers are reserved for when the 
+ * table has a filter.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param distinct The estimated number of distinct k-mers in the file.
+ * @param repeated The estimated number of those seen more than once.
+ * @return Whether or not the table could be grown.
+ */
+int KMerTableReserve(KMerHashTable* kmerTable, unsigned long long int distinct,
+        unsigned long long int repeated);
+
+/**
+ * Freezes a hashed table once it will no longer be modified: its k-mers are 
+ * moved into a perfect hash table and the shards are released. The table can 
+ * still be looked up and iterated over. Tables of other engines are left as 
+ * they are. The table must own its arrays, so it cannot have been loaded from 
+ * an index.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @return Whether or not there was enough memory. The table cannot be used 
+ *      if there was not.
+ */
+int KMerTableFreeze(KMerHashTable* kmerTable);
+
+/**
+ * Copies a frozen table into memory placed on a NUMA node (see Numa.h), so 
+ * that threads on the node look it up locally. The copy is released with 
+ * freeKMerHashTable.
+ * 
+ * @param kmerTable The frozen kmer table to copy.
+ * @param node The node, or NUMA_INTERLEAVE.
+ * @return The copy, or NULL if the table is not frozen or there was not 
+ *      enough memory.
+ */
+KMerHashTable* KMerTableReplicate(KMerHashTable* kmerTable, int node);
+
+/**
+ * Moves the pages of a frozen table to a NUMA node, or interleaves them over 
+ * every node.
+ * 
+ * @param kmerTable The frozen kmer table to work with.
+ * @param node The node, or NUMA_INTERLEAVE.
+ * @return Whether or not the table was placed.
+ */
+int KMerTablePlace(KMerHashTable* kmerTable, int node);
+
+/**
+ * Estimates the fraction of the lookups made from a NUMA node that read memory 
+ * on that node.
+ * 
+ * @param kmerTable The frozen kmer table to work with.
+ * @param node The node.
+ * @return The fraction of local reads, or -1 if it is unknown or the table is 
+ *      not frozen.
+ */
+double KMerTableGetLocality(KMerHashTable* kmerTable, unsigned int node);
+
+/**
+ * Places a Bloom filter in front of every shard of the table, so that k-mers 
+ * are only added on their second occurrence. The k-mers held back are counted 
+ * as singletons by pruneKMers, which also clears the filter.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param size The total size of the filters in bytes.
+ * @return Whether or not the filters could be allocated.
+ */
+int KMerTableSetFilter(KMerHashTable* kmerTable, unsigned long long int size);
+
+/**
+ * Makes pruneKMers keep the k-mers it removes, seen only once, in the pruned 
+ * array of their shard, so that they can be saved with the table and counted 
+ * again when more reads are counted into it. Has no effect on a table that is 
+ * not hashed or that has a filter, whose singletons are never added to it.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param keep Whether to keep them. If not, any k-mers kept are released.
+ */
+void KMerTableKeepPruned(KMerHashTable* kmerTable, int keep);
 
 /**
  * Insters count at the location associated with kmer. 
@@ -60,9 +397,179 @@ int KMerTableInsert(KMerHashTable* kmerTable, unsigned long long int kmer, unsig
  */
 unsigned long long int KMerTableLookup(KMerHashTable* kmerTable, unsigned long long int kmer);
 
+/**
+ * Does a lookup of a k-mer that is already in canonical form. This avoids 
+ * recomputing the reverse compliment when the caller has canonical k-mers, 
+ * such as those produced by getCanonicalKMers.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param kmer The canonical kmer value.
+ * @return The count associated with the kmer.
+ */
+unsigned long long int KMerTableLookupCanonical(KMerHashTable* kmerTable, unsigned long long int kmer);
+
+/**
+ * Does a lookup of every k-mer of a sequence. This works for k-mers of any 
+ * size, including those too long for the other lookup functions.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param sequence The sequence whose k-mers to look up.
+ * @param sequenceLength The length of the sequence in nucleotide bases.
+ * @param counts The counts of the k-mers, filled in order: 
+ *      (sequenceLength - kmerSize + 1) entries.
+ */
+void KMerTableLookupSequence(KMerHashTable* kmerTable, unsigned long long int* sequence,
+        unsigned int sequenceLength, unsigned int* counts);
+
+/**
+ * Does a lookup of many k-mers that are already in canonical form, such as 
+ * the k-mers of a read. The slots of a group of k-mers are found and 
+ * prefetched before any of them are examined, so that their cache misses 
+ * overlap instead of being paid one after another.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param kmers The canonical kmer values.
+ * @param numKMers The number of k-mers.
+ * @param counts The counts associated with the k-mers, filled in the same order.
+ */
+void KMerTableLookupBatch(KMerHashTable* kmerTable, unsigned long long int* kmers,
+        unsigned int numKMers, unsigned int* counts);
+
+/**
+ * Returns the number of k-mers stored in the k-mer table.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @return The number of k-mers in the table.
+ */
+unsigned long long int KMerTableNumEntries(KMerHashTable* kmerTable);
+
+/**
+ * Initializes an iterator over all the k-mers in the k-mer table. The table 
+ * must not be modified while it is being iterated over.
+ * 
+ * @param kmerTable The kmer table to iterate over.
+ * @param iterator The iterator to initialize.
+ */
+void KMerTableIterate(KMerHashTable* kmerTable, KMerHashTableIterator* iterator);
+
+/**
+ * Determines whether or not there are more k-mers to iterate over.
+ * 
+ * @param iterator The k-mer table iterator.
+ * @return Whether or not there are more k-mers.
+ */
+bool KMerTableIterHasMore(KMerHashTableIterator* iterator);
+
+/**
+ * Retrieves the next k-mer and its count from the iterator.
+ * 
+ * @param iterator The k-mer table iterator.
+ * @param count Set to the count of the returned k-mer.
+ * @return The next k-mer.
+ */
+unsigned long long int KMerTableIterNext(KMerHashTableIterator* iterator, 
+        unsigned long long int* count);
+
+/**
+ * Counts every k-mer of the sequence in the table. Each k-mer is counted once, 
+ * under its canonical form, which also accounts for the reverse compliment of 
+ * the sequence. Palindromic k-mers (only possible with an even k-mer size) are 
+ * their own reverse compliment and are counted twice, matching the counts of 
+ * hashing both strands separately. The program exits if the table cannot grow 
+ * to hold the new k-mers.
+ * 
+ * @param table The kmer table to work with.
+ * @param sequence The sequence to count.
+ * @param sequenceLength The length of the sequence in nucleotide bases.
+ * @param kmerSize The length of the k-mers.
+ */
 void addKMersToTable(KMerHashTable* table, unsigned long long int* sequence, 
         unsigned int sequenceLength, unsigned int kmerSize);
 
+/**
+ * Counts k-mers that are already in canonical form, such as those produced by 
+ * getCanonicalKMers. This must not be used while other threads are counting. 
+ * The program exits if the table cannot grow to hold the new k-mers.
+ * 
+ * @param table The kmer table to work with.
+ * @param kmers The canonical k-mers to count.
+ * @param numKMers The number of k-mers.
+ */
+void addCanonicalKMersToTable(KMerHashTable* table, unsigned long long int* kmers, 
+        unsigned int numKMers);
+
+/**
+ * Returns the index of the shard that holds the canonical k-mer.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @param kmer The canonical kmer value.
+ * @return The shard index, less than KMER_TABLE_NUM_SHARDS.
+ */
+unsigned int KMerTableGetShardIndex(KMerHashTable* kmerTable, unsigned long long int kmer);
+
+/**
+ * Returns the number of bytes allocated for the slots of the table.
+ * 
+ * @param kmerTable The kmer table to work with.
+ * @return The size of the table in bytes.
+ */
+unsigned long long int KMerTableGetMemory(KMerHashTable* kmerTable);
+
+/**
+ * Creates a new buffer for counting k-mers into the table from one thread.
+ * 
+ * @param kmerTable The kmer table the buffer will count into.
+ * @return The new buffer, or NULL if it could not be allocated.
+ */
+KMerHashTableBuffer* newKMerHashTableBuffer(KMerHashTable* kmerTable);
+
+/**
+ * Returns the memory a buffer for counting into the table holds.
+ * 
+ * @param kmerTable The k-mer table the buffer would count into.
+ * @return The size of the buffer in bytes.
+ */
+unsigned long long int KMerBufferGetMemory(KMerHashTable* kmerTable);
+
+/**
+ * Counts every k-mer of the sequence into the buffer's table, exactly as 
+ * addKMersToTable does. Several threads may do this at the same time, each 
+ * with their own buffer. Counts are only guaranteed to be in the table after 
+ * KMerBufferFlush is called.
+ * 
+ * @param buffer The buffer to work with.
+ * @param sequence The sequence to count.
+ * @param sequenceLength The length of the sequence in nucleotide bases.
+ */
+void KMerBufferAddSequence(KMerHashTableBuffer* buffer, 
+        unsigned long long int* sequence, unsigned int sequenceLength);
+
+/**
+ * Adds all k-mers remaining in the buffer to the table.
+ * 
+ * @param buffer The buffer to flush.
+ */
+void KMerBufferFlush(KMerHashTableBuffer* buffer);
+
+/**
+ * Frees the buffer. The buffer should be flushed first.
+ * 
+ * @param buffer The buffer to free.
+ */
+void freeKMerHashTableBuffer(KMerHashTableBuffer* buffer);
+
+/**
+ * Returns the statistics of the k-mers in the table. They are gathered in a 
+ * single pass, with the shards divided among several threads, the first time 
+ * they are needed after the table was last counted into or pruned. Later calls 
+ * return the same statistics without reading the table.
+ * 
+ * @param kmerTable The k-mer table to work with.
+ * @param numThreads The number of threads gathering the statistics.
+ * @return The statistics, owned by the table.
+ */
+KMerStatistics* KMerTableGetStatistics(KMerHashTable* kmerTable, unsigned int numThreads);
+
 /**
  * This function returns the maximum k-mer count for the k-mer hash table.
  * 
@@ -92,6 +599,8 @@ unsigned int getMaxKMerCount(KMerHashTable* kmerTable);
  * 
  * result: [0, 1, 0, 2, 0, 1]
  * 
+ * Counts above KMER_HISTOGRAM_MAX_COUNT are left out of the distribution.
+ * 
  * @param kmerTable The k-mer table to work with.
  * @param max The maximum k-mer counts.
  * @return The k-mer count distribution.
@@ -99,14 +608,53 @@ unsigned int getMaxKMerCount(KMerHashTable* kmerTable);
 unsigned int* createDistribution(KMerHashTable* kmerTable, unsigned int max);
 
 /**
- * This function determines the number of repeats k-mers in the k-mer hash table.
+ * This function determines the number of repeats k-mers in the k-mer hash table: 
+ * the sum of the counts of the k-mers seen more than once.
  * 
  * @param kmerTable The k-mer table to work with.
  * @return The number of repeats.
  */
 unsigned int getNumRepeats(KMerHashTable* kmerTable);
 
-void preprocessKMers(KMerHashTable* kmerTable, Correction* correction);
+/**
+ * Removes the k-mers seen only once from a range of shards. The counts of the 
+ * k-mers in those shards are tallied into the histogram, and the number of 
+ * k-mers examined and removed are added to total and unique.
+ * 
+ * @param kmerTable The k-mer table to work with.
+ * @param firstShard The first shard to prune.
+ * @param lastShard One past the last shard to prune.
+ * @param histogram The KMER_HISTOGRAM_SIZE k-mer count tallies to add to.
+ * @param unique Incremented by the number of k-mers removed.
+ * @param total Incremented by the number of k-mers examined.
+ */
+void pruneKMers(KMerHashTable* kmerTable, unsigned int firstShard, 
+        unsigned int lastShard, unsigned long long int* histogram, 
+        unsigned long long int* unique, unsigned long long int* total);
+
+/**
+ * Reports the pruned k-mers and sets the low k-mer threshold of the correction 
+ * from the histogram of k-mer counts, once every shard has been pruned.
+ * 
+ * @param histogram The KMER_HISTOGRAM_SIZE k-mer count tallies.
+ * @param unique The number of k-mers removed.
+ * @param total The number of k-mers examined.
+ * @param correction The correction to update.
+ */
+void finishPreprocessingKMers(unsigned long long int* histogram, 
+        unsigned long long int unique, unsigned long long int total, 
+        Correction* correction);
+
+/**
+ * Removes the k-mers seen only once from the whole table and sets the low k-mer 
+ * threshold of the correction. This is meant to be done once every file has 
+ * been counted. The shards are pruned by several threads at once.
+ * 
+ * @param kmerTable The k-mer table to work with.
+ * @param correction The correction to update.
+ * @param numThreads The number of threads pruning shards.
+ */
+void preprocessKMers(KMerHashTable* kmerTable, Correction* correction, unsigned int numThreads);
 
 
 #ifdef	__cplusplus
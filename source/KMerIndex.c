@@ -0,0 +1,425 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "KMerIndex.h"
+#include "KMerHashTable.h"
+#include "Memory.h"
+
+/* Returns the offset rounded up to the alignment of the arrays. */
+static inline unsigned long long int alignOffset(unsigned long long int offset)
+{
+    return (offset + KMER_INDEX_ALIGNMENT - 1) / KMER_INDEX_ALIGNMENT * KMER_INDEX_ALIGNMENT;
+}
+
+/* Writes an array at the offset, padding the file up to it first. */
+static int writeArray(FILE* file, unsigned long long int* position, 
+        unsigned long long int offset, void* array, unsigned long long int size)
+{
+    static const char padding[KMER_INDEX_ALIGNMENT] = {0};
+    
+    if(fwrite(padding, 1, offset - *position, file) != offset - *position || 
+            fwrite(array, 1, size, file) != size)
+    {
+        return 0;
+    }
+    
+    *position = offset + size;
+    
+    return 1;
+}
+
+int saveKMerIndex(KMerHashTable* kmerTable, char* fileName, 
+        unsigned int lowKMerThreshold, unsigned int replacement)
+{
+    KMerIndexHeader header;
+    KMerIndexShard shards[KMER_TABLE_NUM_SHARDS];
+    KMerHashTableShard* shard;
+    
+    unsigned long long int offset;
+    unsigned long long int position = 0;
+    int success = 1;
+    
+    FILE* file;
+    
+    if(kmerTable->engine != KMER_ENGINE_HASH)
+    {
+        printf("ERROR: Only hashed k-mers can be saved.\n");
+        return 0;
+    }
+    
+    file = fopen(fileName, "wb");
+    
+    if(file == 0)
+    {
+        printf("Could not create file: %s\n", fileName);
+        return 0;
+    }
+    
+    // Lay out the arrays:
+    offset = sizeof(header) + sizeof(shards);
+    
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
+    {
+        shard = &(kmerTable->shards[i]);
+        
+        shards[i].capacity = shard->capacity;
+        shards[i].entries = shard->entries;
+        shards[i].overflowCapacity = shard->overflowCapacity;
+        shards[i].overflowEntries = shard->overflowEntries;
+        
+        shards[i].kmers = alignOffset(offset);
+        offset = shards[i].kmers + shard->capacity * sizeof(unsigned long long int);
+        shards[i].counts = alignOffset(offset);
+        offset = shards[i].counts + shard->capacity * sizeof(KMerCount);
+        
+        shards[i].overflowKMers = 0;
+        shards[i].overflowCounts = 0;
+        
+        if(shard->overflowCapacity > 0)
+        {
+            shards[i].overflowKMers = alignOffset(offset);
+            offset = shards[i].overflowKMers + shard->overflowCapacity * sizeof(unsigned long long int);
+            shards[i].overflowCounts = alignOffset(offset);
+            offset = shards[i].overflowCounts + shard->overflowCapacity * sizeof(unsigned long long int);
+        }
+        
+        shards[i].prunedEntries = shard->prunedEntries;
+        shards[i].pruned = 0;
+        
+        if(shard->prunedEntries > 0)
+        {
+            shards[i].pruned = alignOffset(offset);
+            offset = shards[i].pruned + shard->prunedEntries * sizeof(unsigned long long int);
+        }
+    }
+    
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, KMER_INDEX_MAGIC, sizeof(header.magic));
+    header.version = KMER_INDEX_VERSION;
+    header.kmerSize = kmerTable->kmerSize;
+    header.lowKMerThreshold = lowKMerThreshold;
+    header.replacement = replacement;
+    header.numShards = KMER_TABLE_NUM_SHARDS;
+    header.hashFunction = KMerTableGetHashID(kmerTable);
+    header.countBytes = sizeof(KMerCount);
+    header.hasPruned = kmerTable->keepPruned;
+    header.fileSize = offset;
+    
+    success = writeArray(file, &position, 0, &header, sizeof(header)) && 
+            writeArray(file, &position, sizeof(header), shards, sizeof(shards));
+    
+    // Write the arrays:
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS && success; i++)
+    {
+        shard = &(kmerTable->shards[i]);
+        
+        success = writeArray(file, &position, shards[i].kmers, shard->kmers, 
+                        shard->capacity * sizeof(unsigned long long int)) && 
+                writeArray(file, &position, shards[i].counts, shard->counts, 
+                        shard->capacity * sizeof(KMerCount));
+        
+        if(success && shard->overflowCapacity > 0)
+        {
+            success = writeArray(file, &position, shards[i].overflowKMers, shard->overflowKMers, 
+                            shard->overflowCapacity * sizeof(unsigned long long int)) && 
+                    writeArray(file, &position, shards[i].overflowCounts, shard->overflowCounts, 
+                            shard->overflowCapacity * sizeof(unsigned long long int));
+        }
+        
+        if(success && shard->prunedEntries > 0)
+        {
+            success = writeArray(file, &position, shards[i].pruned, shard->pruned, 
+                            shard->prunedEntries * sizeof(unsigned long long int));
+        }
+    }
+    
+    if(fclose(file) != 0 || !success)
+    {
+        printf("Could not write file: %s\n", fileName);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Checks that every array of the shard lies within the file. */
+static int isShardValid(KMerIndexShard* shard, unsigned long long int fileSize)
+{
+    if(shard->capacity == 0 || (shard->capacity & (shard->capacity - 1)) != 0 || 
+            shard->entries >= shard->capacity || 
+            shard->kmers + shard->capacity * sizeof(unsigned long long int) > fileSize || 
+            shard->counts + shard->capacity * sizeof(KMerCount) > fileSize)
+    {
+        return 0;
+    }
+    
+    if(shard->overflowCapacity > 0 && 
+            ((shard->overflowCapacity & (shard->overflowCapacity - 1)) != 0 || 
+            shard->overflowEntries >= shard->overflowCapacity || 
+            shard->overflowKMers + shard->overflowCapacity * sizeof(unsigned long long int) > fileSize || 
+            shard->overflowCounts + shard->overflowCapacity * sizeof(unsigned long long int) > fileSize))
+    {
+        return 0;
+    }
+    
+    if(shard->prunedEntries > 0 && 
+            shard->pruned + shard->prunedEntries * sizeof(unsigned long long int) > fileSize)
+    {
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Moves the arrays of a shard from the mapped file into memory of its own, 
+ * exactly as if they had been allocated while counting. */
+static int copyShard(KMerHashTableShard* shard)
+{
+    unsigned long long int* kmers = shard->kmers;
+    KMerCount* counts = shard->counts;
+    unsigned long long int* overflowKMers = shard->overflowKMers;
+    unsigned long long int* overflowCounts = shard->overflowCounts;
+    
+    shard->kmers = (unsigned long long int*)allocateMemory(shard->capacity * sizeof(unsigned long long int));
+    shard->counts = (KMerCount*)allocateMemory(shard->capacity * sizeof(KMerCount));
+    
+    if(shard->kmers == NULL || shard->counts == NULL)
+    {
+        return 0;
+    }
+    
+    memcpy(shard->kmers, kmers, shard->capacity * sizeof(unsigned long long int));
+    memcpy(shard->counts, counts, shard->capacity * sizeof(KMerCount));
+    
+    // The tallies are not saved, so they are taken from the counts:
+    for(unsigned long long int i = 0; i < shard->capacity; i++)
+    {
+        if(kmers[i] != KMER_EMPTY && counts[i] < KMER_COUNT_SATURATED)
+        {
+            shard->histogram[counts[i]]++;
+        }
+    }
+    
+    if(shard->overflowCapacity > 0)
+    {
+        shard->overflowKMers = (unsigned long long int*)allocateMemory(shard->overflowCapacity * sizeof(unsigned long long int));
+        shard->overflowCounts = (unsigned long long int*)allocateMemory(shard->overflowCapacity * sizeof(unsigned long long int));
+        
+        if(shard->overflowKMers == NULL || shard->overflowCounts == NULL)
+        {
+            return 0;
+        }
+        
+        memcpy(shard->overflowKMers, overflowKMers, shard->overflowCapacity * sizeof(unsigned long long int));
+        memcpy(shard->overflowCounts, overflowCounts, shard->overflowCapacity * sizeof(unsigned long long int));
+    }
+    
+    return 1;
+}
+
+/* Loads an index, either using the mapped arrays directly or copying them. */
+static KMerHashTable* openKMerIndex(char* fileName, unsigned int* lowKMerThreshold,
+        unsigned int* replacement, int copy)
+{
+    KMerHashTable* kmerTable;
+    KMerIndexHeader* header;
+    KMerIndexShard* shards;
+    KMerHashTableShard* shard;
+    unsigned long long int* pruned;
+    enum KMER_HASH_FUNCTION function;
+    enum KMER_SLOT_REDUCTION reduction;
+    
+    struct stat st;
+    char* data;
+    
+    int file = open(fileName, O_RDONLY);
+    
+    if(file < 0)
+    {
+        printf("Could not open file location: %s for reading.\n", fileName);
+        return NULL;
+    }
+    
+    if(fstat(file, &st) != 0 || st.st_size < sizeof(KMerIndexHeader) + sizeof(KMerIndexShard) * KMER_TABLE_NUM_SHARDS)
+    {
+        printf("ERROR: %s is not a k-mer index.\n", fileName);
+        close(file);
+        return NULL;
+    }
+    
+    data = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+        // The mapping remains after the file is closed.
+    
+    if(data == MAP_FAILED)
+    {
+        printf("Could not map file: %s\n", fileName);
+        return NULL;
+    }
+    
+    header = (KMerIndexHeader*)data;
+    shards = (KMerIndexShard*)(data + sizeof(KMerIndexHeader));
+    
+    if(memcmp(header->magic, KMER_INDEX_MAGIC, sizeof(header->magic)) != 0 || 
+            header->version != KMER_INDEX_VERSION || header->fileSize != st.st_size)
+    {
+        printf("ERROR: %s is not a k-mer index.\n", fileName);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    
+    function = (enum KMER_HASH_FUNCTION)(header->hashFunction & 0xFF);
+    reduction = (enum KMER_SLOT_REDUCTION)(header->hashFunction >> 8);
+    
+    if(header->numShards != KMER_TABLE_NUM_SHARDS || !isKMerHashSupported(function) || 
+            (reduction != KMER_SLOT_MASK && reduction != KMER_SLOT_SHIFT) || 
+            header->countBytes != sizeof(KMerCount) || header->kmerSize < 1 || header->kmerSize > 31)
+    {
+        printf("ERROR: The k-mer index %s was written by an incompatible version.\n", fileName);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    
+    // Counting into the index needs the k-mers it pruned:
+    if(copy && !header->hasPruned)
+    {
+        printf("ERROR: The k-mer index %s was saved without the k-mers seen once (with --bloom), so it cannot be extended.\n", fileName);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
+    {
+        if(!isShardValid(&(shards[i]), st.st_size))
+        {
+            printf("ERROR: The k-mer index %s is damaged.\n", fileName);
+            munmap(data, st.st_size);
+            return NULL;
+        }
+    }
+    
+    if((kmerTable = malloc(sizeof *kmerTable)) == NULL)
+    {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    
+    kmerTable->kmerSize = header->kmerSize;
+    kmerTable->engine = KMER_ENGINE_HASH;
+    kmerTable->sorted = NULL;
+    kmerTable->quotient = NULL;
+    kmerTable->perfect = NULL;
+    kmerTable->wide = NULL;
+    kmerTable->hashFunction = function;
+    kmerTable->slotReduction = reduction;
+    kmerTable->hasStatistics = 0;
+    kmerTable->keepPruned = 0;
+    
+    // Use the mapped arrays directly:
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS; i++)
+    {
+        shard = &(kmerTable->shards[i]);
+        
+        shard->kmers = (unsigned long long int*)(data + shards[i].kmers);
+        shard->counts = (KMerCount*)(data + shards[i].counts);
+        shard->capacity = shards[i].capacity;
+        shard->entries = shards[i].entries;
+        shard->reserved = 0;
+        shard->hashFunction = function;
+        shard->slotReduction = reduction;
+        pthread_rwlock_init(&(shard->lock), NULL);
+        
+        shard->filter = NULL;
+        shard->filterWords = 0;
+        shard->singletons = 0;
+        
+        shard->overflowKMers = NULL;
+        shard->overflowCounts = NULL;
+        shard->overflowCapacity = shards[i].overflowCapacity;
+        shard->overflowEntries = shards[i].overflowEntries;
+        pthread_mutex_init(&(shard->overflowLock), NULL);
+        
+        // Only read when counted into (see below):
+        shard->pruned = NULL;
+        shard->prunedEntries = 0;
+        
+        // Only tallied when counted into (see copyShard):
+        memset(shard->histogram, 0, sizeof(shard->histogram));
+        
+        if(shard->overflowCapacity > 0)
+        {
+            shard->overflowKMers = (unsigned long long int*)(data + shards[i].overflowKMers);
+            shard->overflowCounts = (unsigned long long int*)(data + shards[i].overflowCounts);
+        }
+        
+        if(copy && !copyShard(shard))
+        {
+            printf("ERROR: Not enough memory to read the k-mer index %s.\n", fileName);
+            munmap(data, st.st_size);
+            return NULL;
+        }
+    }
+    
+    // Count the pruned k-mers back in, as they were before pruning:
+    for(int i = 0; i < KMER_TABLE_NUM_SHARDS && copy; i++)
+    {
+        pruned = (unsigned long long int*)(data + shards[i].pruned);
+        
+        for(unsigned long long int j = 0; j < shards[i].prunedEntries; j++)
+        {
+            if(!KMerTableInsert(kmerTable, pruned[j], 1))
+            {
+                printf("ERROR: Not enough memory to read the k-mer index %s.\n", fileName);
+                munmap(data, st.st_size);
+                return NULL;
+            }
+        }
+    }
+    
+    *lowKMerThreshold = header->lowKMerThreshold;
+    *replacement = header->replacement;
+    
+    // Nothing refers to the file any longer:
+    if(copy)
+    {
+        munmap(data, st.st_size);
+    }
+    
+    return kmerTable;
+}
+
+KMerHashTable* loadKMerIndex(char* fileName, unsigned int* lowKMerThreshold,
+        unsigned int* replacement)
+{
+    return openKMerIndex(fileName, lowKMerThreshold, replacement, 0);
+}
+
+KMerHashTable* readKMerIndex(char* fileName, unsigned int* lowKMerThreshold,
+        unsigned int* replacement)
+{
+    return openKMerIndex(fileName, lowKMerThreshold, replacement, 1);
+}
@@ -0,0 +1,134 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "KMerHashTable.h"
+
+#ifndef KMERINDEX_H
+#define	KMERINDEX_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * A k-mer index file holds a counted and pruned k-mer table, so that reads can 
+ * be corrected again without counting their k-mers again. The arrays of every 
+ * shard are written exactly as they are held in memory, followed by the k-mers 
+ * that pruning removed from the shard (see KMerTableKeepPruned), which are 
+ * only read when more reads are counted into the index:
+ * 
+ * [KMerIndexHeader]
+ * [KMerIndexShard] * numShards
+ * [k-mers][counts][overflow k-mers][overflow counts][pruned k-mers] * numShards
+ * 
+ * Every array starts on a KMER_INDEX_ALIGNMENT boundary and is referred to by 
+ * its offset from the start of the file. A loaded index maps the file into 
+ * memory and uses these arrays directly, so only the pages that lookups touch 
+ * are ever read. Values are stored in the byte order of the machine that 
+ * wrote the file.
+ */
+#define KMER_INDEX_MAGIC "POLLUXKI"
+#define KMER_INDEX_VERSION 2
+#define KMER_INDEX_ALIGNMENT 64
+
+typedef struct
+{
+    char magic[8];
+    unsigned int version;
+    
+    unsigned int kmerSize;
+    unsigned int lowKMerThreshold;
+    unsigned int replacement;               // The next replacement for an N.
+    
+    // The table layout must match the reader's:
+    unsigned int numShards;
+    unsigned int hashFunction;              // See KMerTableGetHashID.
+    unsigned int countBytes;                // sizeof(KMerCount)
+    
+    unsigned int hasPruned;                 // Whether the pruned k-mers were kept.
+    
+    unsigned long long int fileSize;
+} KMerIndexHeader;
+
+typedef struct
+{
+    unsigned long long int capacity;
+    unsigned long long int entries;
+    unsigned long long int kmers;           // Offset of the k-mer array.
+    unsigned long long int counts;          // Offset of the count array.
+    
+    unsigned long long int overflowCapacity;
+    unsigned long long int overflowEntries;
+    unsigned long long int overflowKMers;   // Offset, or 0 if there are none.
+    unsigned long long int overflowCounts;  // Offset, or 0 if there are none.
+    
+    unsigned long long int prunedEntries;
+    unsigned long long int pruned;          // Offset, or 0 if there are none.
+} KMerIndexShard;
+
+/**
+ * Writes the k-mer table to an index file.
+ * 
+ * @param kmerTable The k-mer table to write. It should already be pruned, 
+ *      keeping the k-mers it removed if the index is to be extended.
+ * @param fileName The index file to create.
+ * @param lowKMerThreshold The low k-mer threshold found for the table.
+ * @param replacement The next replacement for an N after the reads were 
+ *      counted. Reads corrected after loading the index will then have their 
+ *      N's replaced exactly as if they had been counted again.
+ * @return Whether or not the index was written successfully.
+ */
+int saveKMerIndex(KMerHashTable* kmerTable, char* fileName, 
+        unsigned int lowKMerThreshold, unsigned int replacement);
+
+/**
+ * Maps an index file into memory as a k-mer table. The table can be used for 
+ * lookups and iteration, but must not be counted into.
+ * 
+ * @param fileName The index file to load.
+ * @param lowKMerThreshold Set to the low k-mer threshold of the table.
+ * @param replacement Set to the next replacement for an N.
+ * @return The k-mer table, or NULL if the index could not be loaded.
+ */
+KMerHashTable* loadKMerIndex(char* fileName, unsigned int* lowKMerThreshold,
+        unsigned int* replacement);
+
+/**
+ * Reads an index file into memory as a k-mer table that can be counted into, 
+ * exactly as if its k-mers had just been counted, before they were pruned. 
+ * Counting the k-mers of more files into it and pruning it then gives the table 
+ * and low k-mer threshold that counting every file at once would have given, 
+ * without counting the earlier files again. Only an index written with the 
+ * k-mers it pruned (see saveKMerIndex) can be read.
+ * 
+ * @param fileName The index file to read.
+ * @param lowKMerThreshold Set to the low k-mer threshold of the table.
+ * @param replacement Set to the next replacement for an N, which should be 
+ *      used for the reads counted next.
+ * @return The k-mer table, or NULL if the index could not be read.
+ */
+KMerHashTable* readKMerIndex(char* fileName, unsigned int* lowKMerThreshold,
+        unsigned int* replacement);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* KMERINDEX_H */
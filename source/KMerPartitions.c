@@ -0,0 +1,234 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "KMerPartitions.h"
+#include "KMerHashTable.h"
+#include "Utility.h"
+
+// The number of k-mers collected for a partition before writing them out.
+#define KMER_PARTITION_BUFFER_SIZE 4096
+
+/* Returns the memory needed to count the k-mers with the given number of 
+ * partitions: the spill buffers, one partition's worth of new k-mers, the 
+ * k-mers kept from the partitions counted before it, and the overflow maps. */
+static unsigned long long int getPartitionedMemory(unsigned long long int numKMers, 
+        unsigned long long int numKept, unsigned long long int numOccurrences, 
+        unsigned int numPartitions)
+{
+    unsigned long long int buffers = (numPartitions == 1) ? 0 : (unsigned long long int)numPartitions * 
+            (KMER_PARTITION_BUFFER_SIZE * sizeof(unsigned long long int) + BUFSIZ);
+    unsigned long long int partition = (numKMers + numPartitions - 1) / numPartitions;
+    unsigned long long int kept = numKept / numPartitions * (numPartitions - 1);
+    
+    // Only k-mers counted KMER_COUNT_SATURATED times or more overflow:
+    unsigned long long int overflow = numOccurrences / KMER_COUNT_SATURATED * 
+            KMER_TABLE_OVERFLOW_PEAK_BYTES_PER_KMER + KMER_TABLE_NUM_SHARDS * 
+            KMER_TABLE_OVERFLOW_MINIMUM_CAPACITY * 2 * sizeof(unsigned long long int);
+    
+    return buffers + partition * KMER_TABLE_PEAK_BYTES_PER_KMER + 
+            kept * KMER_TABLE_KEPT_BYTES_PER_KMER + overflow;
+}
+
+unsigned int getNumKMerPartitions(unsigned long long int numKMers, 
+        unsigned long long int numKept, unsigned long long int numOccurrences, 
+        unsigned long long int memory)
+{
+    for(unsigned int partitions = 1; partitions <= KMER_PARTITIONS_MAX; partitions *= 2)
+    {
+        if(getPartitionedMemory(numKMers, numKept, numOccurrences, partitions) <= memory)
+        {
+            return partitions;
+        }
+    }
+    
+    return 0;
+}
+
+KMerPartitions* newKMerPartitions(KMerHashTable* kmerTable, 
+        unsigned int numPartitions, char* directory)
+{
+    KMerPartitions* partitions;
+    unsigned int shift = KMER_TABLE_SHARD_BITS;
+    
+    if((partitions = malloc(sizeof *partitions)) == NULL)
+    {
+        return NULL;
+    }
+    
+    // Each partition covers (1 << shift) consecutive shards:
+    while((1U << (KMER_TABLE_SHARD_BITS - shift)) < numPartitions)
+    {
+        shift--;
+    }
+    
+    partitions->table = kmerTable;
+    partitions->numPartitions = numPartitions;
+    partitions->shift = shift;
+    
+    partitions->fileNames = (char**)calloc(numPartitions, sizeof(char*));
+    partitions->files = (FILE**)calloc(numPartitions, sizeof(FILE*));
+    partitions->buffers = (unsigned long long int*)malloc(
+            (unsigned long long int)numPartitions * KMER_PARTITION_BUFFER_SIZE * sizeof(unsigned long long int));
+    partitions->sizes = (unsigned int*)calloc(numPartitions, sizeof(unsigned int));
+    
+    if(partitions->fileNames == NULL || partitions->files == NULL || 
+            partitions->buffers == NULL || partitions->sizes == NULL)
+    {
+        freeKMerPartitions(partitions);
+        
+        return NULL;
+    }
+    
+    for(unsigned int i = 0; i < numPartitions; i++)
+    {
+        partitions->fileNames[i] = (char*)malloc(strlen(directory) + 64);
+        
+        if(partitions->fileNames[i] == NULL)
+        {
+            freeKMerPartitions(partitions);
+            
+            return NULL;
+        }
+        
+        sprintf(partitions->fileNames[i], "%s/pollux.%d.partition.%u", 
+                directory, (int)getpid(), i);
+        
+        if((partitions->files[i] = fopen(partitions->fileNames[i], "w+b")) == NULL)
+        {
+            printf("Could not create file: %s\n", partitions->fileNames[i]);
+            freeKMerPartitions(partitions);
+            
+            return NULL;
+        }
+    }
+    
+    return partitions;
+}
+
+/* Writes out the pending k-mers of the partition. */
+static void flushPartition(KMerPartitions* partitions, unsigned int partition)
+{
+    unsigned long long int* buffer = &(partitions->buffers[partition * KMER_PARTITION_BUFFER_SIZE]);
+    unsigned int size = partitions->sizes[partition];
+    
+    if(fwrite(buffer, sizeof(unsigned long long int), size, partitions->files[partition]) != size)
+    {
+        printf("CRITICAL: FAILED TO WRITE K-MER PARTITION!\n");
+        exit(1);
+    }
+    
+    partitions->sizes[partition] = 0;
+}
+
+void KMerPartitionsAddSequence(KMerPartitions* partitions, 
+        unsigned long long int* sequence, unsigned int sequenceLength)
+{
+    //Variables:
+    unsigned int kmerSize = partitions->table->kmerSize;
+    int total = (int)sequenceLength - (int)kmerSize + 1;
+    unsigned int partition;
+    
+    if(total <= 0)
+    {
+        return;
+    }
+    
+    unsigned long long int kmers[total];
+    getCanonicalKMers(sequence, sequenceLength, kmerSize, kmers);
+    
+    for(int i = 0; i < total; i++)
+    {
+        partition = KMerTableGetShardIndex(partitions->table, kmers[i]) >> partitions->shift;
+        
+        partitions->buffers[partition * KMER_PARTITION_BUFFER_SIZE + partitions->sizes[partition]] = kmers[i];
+        partitions->sizes[partition]++;
+        
+        if(partitions->sizes[partition] == KMER_PARTITION_BUFFER_SIZE)
+        {
+            flushPartition(partitions, partition);
+        }
+    }
+}
+
+int KMerPartitionsCount(KMerPartitions* partitions, unsigned long long int* histogram, 
+        unsigned long long int* unique, unsigned long long int* total)
+{
+    unsigned long long int* buffer;
+    FILE* file;
+    size_t read;
+    
+    for(unsigned int i = 0; i < partitions->numPartitions; i++)
+    {
+        buffer = &(partitions->buffers[i * KMER_PARTITION_BUFFER_SIZE]);
+        file = partitions->files[i];
+        
+        // Spill what remains and read the partition back from the start:
+        flushPartition(partitions, i);
+        rewind(file);
+        
+        while((read = fread(buffer, sizeof(unsigned long long int), KMER_PARTITION_BUFFER_SIZE, file)) > 0)
+        {
+            addCanonicalKMersToTable(partitions->table, buffer, (unsigned int)read);
+        }
+        
+        if(ferror(file))
+        {
+            printf("Could not read file: %s\n", partitions->fileNames[i]);
+            return 0;
+        }
+        
+        // Prune this partition's shards before counting the next:
+        pruneKMers(partitions->table, i << partitions->shift, (i + 1) << partitions->shift, 
+                histogram, unique, total);
+        
+        // Give the disk space of the partition back:
+        if((partitions->files[i] = freopen(partitions->fileNames[i], "w+b", file)) == NULL)
+        {
+            printf("Could not create file: %s\n", partitions->fileNames[i]);
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+void freeKMerPartitions(KMerPartitions* partitions)
+{
+    for(unsigned int i = 0; partitions->fileNames != NULL && i < partitions->numPartitions; i++)
+    {
+        if(partitions->files != NULL && partitions->files[i] != NULL)
+        {
+            fclose(partitions->files[i]);
+            remove(partitions->fileNames[i]);
+        }
+        
+        free(partitions->fileNames[i]);
+    }
+    
+    free(partitions->fileNames);
+    free(partitions->files);
+    free(partitions->buffers);
+    free(partitions->sizes);
+    free(partitions);
+}
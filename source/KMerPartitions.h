@@ -0,0 +1,133 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include "Globals.h"
+#include "KMerHashTable.h"
+
+#ifndef KMERPARTITIONS_H
+#define	KMERPARTITIONS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * External-memory k-mer counting. Counting a file directly into the k-mer table 
+ * holds every distinct k-mer of the file at once, including the singletons 
+ * that preprocessing removes afterwards. Instead, the k-mers can be counted in 
+ * two passes:
+ * 
+ * 1. Every canonical k-mer of every file is spilled to one of several 
+ *    partition files on disk, chosen by the shard that will hold it.
+ * 
+ * 2. Each partition file is counted into its own range of shards, which are 
+ *    pruned before the next partition is counted.
+ * 
+ * Only one partition's k-mers are ever held in memory before pruning, which 
+ * bounds the memory needed by the number of partitions. Since a partition 
+ * holds the k-mers of every file when it is counted, its shards are pruned 
+ * only once, and the resulting table is identical to counting the files 
+ * directly and pruning them together.
+ */
+#define KMER_PARTITIONS_MAX (KMER_TABLE_NUM_SHARDS)
+
+typedef struct
+{
+    KMerHashTable* table;
+    
+    unsigned int numPartitions;             // A power of two.
+    unsigned int shift;                     // Shard index to partition.
+    
+    char** fileNames;
+    FILE** files;
+    
+    unsigned long long int* buffers;        // Pending k-mers, per partition.
+    unsigned int* sizes;
+} KMerPartitions;
+
+/**
+ * Determines how many partitions are needed to count the k-mers into the 
+ * table within the given memory. Besides the k-mers of the partition being 
+ * counted, this allows for the spill buffers, the k-mers kept from the other 
+ * partitions and the overflow maps of the shards. A single partition is 
+ * counted directly, without spilling.
+ * 
+ * @param numKMers An upper bound on the number of distinct k-mers to count.
+ * @param numKept An upper bound on the number of them kept by pruning.
+ * @param numOccurrences An upper bound on the number of k-mers to count, 
+ *      repeats included.
+ * @param memory The memory left for counting the k-mers, in bytes.
+ * @return The number of partitions (a power of two), or 0 if even 
+ *      KMER_PARTITIONS_MAX partitions would need more memory.
+ */
+unsigned int getNumKMerPartitions(unsigned long long int numKMers, 
+        unsigned long long int numKept, unsigned long long int numOccurrences, 
+        unsigned long long int memory);
+
+/**
+ * Creates the partition files for counting k-mers into the table.
+ * 
+ * @param kmerTable The k-mer table the k-mers will be counted into.
+ * @param numPartitions The number of partitions (a power of two, no larger 
+ *      than KMER_PARTITIONS_MAX).
+ * @param directory The directory in which to create the partition files.
+ * @return The new partitions, or NULL if they could not be created.
+ */
+KMerPartitions* newKMerPartitions(KMerHashTable* kmerTable, 
+        unsigned int numPartitions, char* directory);
+
+/**
+ * Spills every canonical k-mer of the sequence to its partition.
+ * 
+ * @param partitions The partitions to work with.
+ * @param sequence The sequence to spill.
+ * @param sequenceLength The length of the sequence in nucleotide bases.
+ */
+void KMerPartitionsAddSequence(KMerPartitions* partitions, 
+        unsigned long long int* sequence, unsigned int sequenceLength);
+
+/**
+ * Counts the spilled k-mers into the table, one partition at a time, and 
+ * prunes each partition's shards as with pruneKMers. This is meant to be done 
+ * once every file has been spilled. The partition files are emptied as they 
+ * are counted.
+ * 
+ * @param partitions The partitions to count.
+ * @param histogram The KMER_HISTOGRAM_SIZE k-mer count tallies to add to.
+ * @param unique Incremented by the number of k-mers removed.
+ * @param total Incremented by the number of k-mers examined.
+ * @return Whether or not the partitions were read back successfully.
+ */
+int KMerPartitionsCount(KMerPartitions* partitions, unsigned long long int* histogram, 
+        unsigned long long int* unique, unsigned long long int* total);
+
+/**
+ * Closes and deletes the partition files and frees the partitions.
+ * 
+ * @param partitions The partitions to free.
+ */
+void freeKMerPartitions(KMerPartitions* partitions);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* KMERPARTITIONS_H */
@@ -0,0 +1,541 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "KMerPerfectTable.h"
+#include "Memory.h"
+#include "Numa.h"
+
+// Batched lookups load this many k-mers at once:
+#define KMER_PERFECT_LOOKUP_GROUP 16
+
+// Marks an index without a k-mer while building. It is never a k-mer, for the 
+// same reason as KMER_EMPTY.
+#define KMER_PERFECT_UNASSIGNED 0xFFFFFFFFFFFFFFFFULL
+
+/* Returns a different mix of the k-mer's hash for every level. The first level 
+ * uses the hash itself. */
+static inline unsigned long long int getLevelHash(unsigned long long int hash, unsigned int level)
+{
+    if(level == 0)
+    {
+        return hash;
+    }
+    
+    hash ^= level * 0x9E3779B97F4A7C15ULL;
+    
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    
+    return hash;
+}
+
+/* Returns the bit of the hash within the level, taken from the high hash bits. */
+static inline unsigned long long int getLevelBit(KMerPerfectTable* table, 
+        unsigned long long int hash, unsigned int level)
+{
+    return (unsigned long long int)(((unsigned __int128)getLevelHash(hash, level) 
+            * table->levelSizes[level]) >> 64);
+}
+
+static inline int testBit(unsigned long long int* words, unsigned long long int bit)
+{
+    return (words[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static inline void setBit(unsigned long long int* words, unsigned long long int bit)
+{
+    words[bit >> 6] |= 1ULL << (bit & 63);
+}
+
+/* Returns the number of bits set before the given bit. */
+static inline unsigned long long int getRank(KMerPerfectTable* table, unsigned long long int bit)
+{
+    unsigned long long int word = bit >> 6;
+    unsigned long long int* sample = &(table->ranks[2 * (word / KMER_PERFECT_RANK_WORDS)]);
+    unsigned int offset = word % KMER_PERFECT_RANK_WORDS;
+    unsigned long long int rank = sample[0];
+    
+    if(offset > 0)
+    {
+        rank += (sample[1] >> (9 * (offset - 1))) & 0x1FF;
+    }
+    
+    return rank + __builtin_popcountll(table->bits[word] & ((1ULL << (bit & 63)) - 1));
+}
+
+/* Returns the index of the k-mer with the given hash. A k-mer left out of the 
+ * levels is found among the fallback hashes, at the first index holding it or 
+ * nothing yet. Returns numKMers if the hash is in neither. */
+static inline unsigned long long int findIndex(KMerPerfectTable* table, unsigned long long int kmer,
+        unsigned long long int hash)
+{
+    unsigned long long int bit;
+    unsigned long long int low = 0;
+    unsigned long long int high = table->numFallback;
+    unsigned long long int middle;
+    unsigned long long int index;
+    
+    for(unsigned int level = 0; level < table->numLevels; level++)
+    {
+        bit = table->levelOffsets[level] + getLevelBit(table, hash, level);
+        
+        if(testBit(table->bits, bit))
+        {
+            return getRank(table, bit);
+        }
+    }
+    
+    while(low < high)
+    {
+        middle = low + (high - low) / 2;
+        
+        if(table->fallback[middle] < hash)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    
+    // Distinct k-mers may share a hash:
+    for(; low < table->numFallback && table->fallback[low] == hash; low++)
+    {
+        index = table->numPlaced + low;
+        
+        if(table->kmers[index] == kmer || table->kmers[index] == KMER_PERFECT_UNASSIGNED)
+        {
+            return index;
+        }
+    }
+    
+    return table->numKMers;
+}
+
+static inline unsigned long long int getNumCountWords(KMerPerfectTable* table)
+{
+    return ((table->numKMers + 1) * table->countBits + 63) / 64 + 1;
+}
+
+static inline unsigned long long int getNumRanks(KMerPerfectTable* table)
+{
+    return 2 * (table->numWords / KMER_PERFECT_RANK_WORDS + 1);
+}
+
+static void setCount(KMerPerfectTable* table, unsigned long long int index, unsigned int count)
+{
+    unsigned long long int bit = index * table->countBits;
+    unsigned long long int word = bit >> 6;
+    unsigned int offset = bit & 63;
+    
+    table->counts[word] |= (unsigned long long int)count << offset;
+    
+    if(offset + table->countBits > 64)
+    {
+        table->counts[word + 1] |= (unsigned long long int)count >> (64 - offset);
+    }
+}
+
+static int compareHashes(const void* a, const void* b)
+{
+    unsigned long long int x = *(const unsigned long long int*)a;
+    unsigned long long int y = *(const unsigned long long int*)b;
+    
+    return (x > y) - (x < y);
+}
+
+/* Builds the levels over the hashes, leaving the hashes placed by no level at 
+ * the start of the array. Returns the number left, or -1 without memory. */
+static long long int buildLevels(KMerPerfectTable* table, unsigned long long int* hashes)
+{
+    unsigned long long int remaining = table->numKMers;
+    unsigned long long int* bits = NULL;
+    unsigned long long int* resized;
+    unsigned long long int* levelBits;
+    unsigned long long int* collisions;
+    unsigned long long int words;
+    unsigned long long int bit;
+    unsigned long long int kept;
+    
+    table->numWords = 0;
+    table->numLevels = 0;
+    
+    for(unsigned int level = 0; level < KMER_PERFECT_MAX_LEVELS && remaining > 0; level++)
+    {
+        words = (remaining * KMER_PERFECT_GAMMA + 63) / 64;
+        
+        resized = (unsigned long long int*)realloc(bits, (table->numWords + words) * sizeof(unsigned long long int));
+        collisions = (unsigned long long int*)calloc(words, sizeof(unsigned long long int));
+        
+        if(resized == NULL || collisions == NULL)
+        {
+            free(resized != NULL ? resized : bits);
+            free(collisions);
+            
+            return -1;
+        }
+        
+        bits = resized;
+        levelBits = bits + table->numWords;
+        memset(levelBits, 0, words * sizeof(unsigned long long int));
+        
+        table->levelOffsets[level] = table->numWords * 64;
+        table->levelSizes[level] = words * 64;
+        table->numLevels = level + 1;
+        
+        // Every hash sets its bit, and bits hit twice are marked as collisions:
+        for(unsigned long long int i = 0; i < remaining; i++)
+        {
+            bit = getLevelBit(table, hashes[i], level);
+            
+            if(testBit(levelBits, bit))
+            {
+                setBit(collisions, bit);
+            }
+            else
+            {
+                setBit(levelBits, bit);
+            }
+        }
+        
+        for(unsigned long long int i = 0; i < words; i++)
+        {
+            levelBits[i] &= ~collisions[i];
+        }
+        
+        // The hashes that collided go to the next level:
+        kept = 0;
+        
+        for(unsigned long long int i = 0; i < remaining; i++)
+        {
+            if(!testBit(levelBits, getLevelBit(table, hashes[i], level)))
+            {
+                hashes[kept++] = hashes[i];
+            }
+        }
+        
+        remaining = kept;
+        table->numWords += words;
+        
+        free(collisions);
+    }
+    
+    // Keep the levels where the rest of the table is:
+    table->bits = (unsigned long long int*)allocateMemory((table->numWords + 1) * sizeof(unsigned long long int));
+    
+    if(table->bits == NULL)
+    {
+        free(bits);
+        return -1;
+    }
+    
+    if(table->numWords > 0)
+    {
+        memcpy(table->bits, bits, table->numWords * sizeof(unsigned long long int));
+    }
+    
+    free(bits);
+    
+    return (long long int)remaining;
+}
+
+KMerPerfectTable* newKMerPerfectTable(unsigned long long int* kmers, unsigned int* counts,
+        unsigned long long int numKMers, enum KMER_HASH_FUNCTION function)
+{
+    KMerPerfectTable* table;
+    unsigned long long int* hashes;
+    unsigned long long int rank = 0;
+    unsigned long long int* sample = NULL;
+    unsigned long long int index;
+    unsigned int maxCount = 1;
+    long long int remaining;
+    
+    if((table = calloc(1, sizeof *table)) == NULL)
+    {
+        return NULL;
+    }
+    
+    table->numKMers = numKMers;
+    table->hashFunction = function;
+    
+    if((hashes = (unsigned long long int*)malloc((numKMers + 1) * sizeof(unsigned long long int))) == NULL)
+    {
+        free(table);
+        return NULL;
+    }
+    
+    for(unsigned long long int i = 0; i < numKMers; i++)
+    {
+        hashes[i] = hashKMerWith(function, kmers[i]);
+        maxCount = counts[i] > maxCount ? counts[i] : maxCount;
+    }
+    
+    table->countBits = 32 - __builtin_clz(maxCount);
+    
+    if((remaining = buildLevels(table, hashes)) < 0)
+    {
+        free(hashes);
+        freeKMerPerfectTable(table);
+        
+        return NULL;
+    }
+    
+    table->ranks = (unsigned long long int*)allocateMemory(getNumRanks(table) * sizeof(unsigned long long int));
+    table->kmers = (unsigned long long int*)allocateMemory((numKMers + 1) * sizeof(unsigned long long int));
+    table->counts = (unsigned long long int*)allocateMemory(getNumCountWords(table) * sizeof(unsigned long long int));
+    table->fallback = (unsigned long long int*)malloc((remaining + 1) * sizeof(unsigned long long int));
+    
+    if(table->ranks == NULL || table->kmers == NULL || table->counts == NULL || table->fallback == NULL)
+    {
+        free(hashes);
+        freeKMerPerfectTable(table);
+        
+        return NULL;
+    }
+    
+    // Each sample is the rank of its first word, followed by the ranks of the 
+    // next words relative to it, 9 bits each:
+    for(unsigned long long int i = 0; i <= table->numWords; i++)
+    {
+        if(i % KMER_PERFECT_RANK_WORDS == 0)
+        {
+            sample = &(table->ranks[2 * (i / KMER_PERFECT_RANK_WORDS)]);
+            sample[0] = rank;
+            sample[1] = 0;
+        }
+        else
+        {
+            sample[1] |= (rank - sample[0]) << (9 * (i % KMER_PERFECT_RANK_WORDS - 1));
+        }
+        
+        rank += (i < table->numWords) ? __builtin_popcountll(table->bits[i]) : 0;
+    }
+    
+    table->numPlaced = rank;
+    
+    // The k-mers placed by no level follow the others, in order of hash:
+    memcpy(table->fallback, hashes, remaining * sizeof(unsigned long long int));
+    qsort(table->fallback, remaining, sizeof(unsigned long long int), compareHashes);
+    table->numFallback = remaining;
+    
+    free(hashes);
+    
+    for(unsigned long long int i = 0; i < numKMers; i++)
+    {
+        table->kmers[i] = KMER_PERFECT_UNASSIGNED;
+    }
+    
+    for(unsigned long long int i = 0; i < numKMers; i++)
+    {
+        index = findIndex(table, kmers[i], hashKMerWith(function, kmers[i]));
+        
+        table->kmers[index] = kmers[i];
+        setCount(table, index, counts[i]);
+    }
+    
+    return table;
+}
+
+static inline unsigned int getCount(KMerPerfectTable* table, unsigned long long int index)
+{
+    unsigned long long int bit = index * table->countBits;
+    unsigned long long int word = bit >> 6;
+    unsigned int offset = bit & 63;
+    unsigned long long int value = table->counts[word] >> offset;
+    
+    if(offset + table->countBits > 64)
+    {
+        value |= table->counts[word + 1] << (64 - offset);
+    }
+    
+    return (unsigned int)(value & ((1ULL << table->countBits) - 1));
+}
+
+unsigned int KMerPerfectTableGetCount(KMerPerfectTable* table, unsigned long long int index)
+{
+    return getCount(table, index);
+}
+
+unsigned int KMerPerfectTableLookup(KMerPerfectTable* table, unsigned long long int kmer)
+{
+    unsigned long long int index = findIndex(table, kmer, hashKMerWith(table->hashFunction, kmer));
+    
+    if(index >= table->numKMers || table->kmers[index] != kmer)
+    {
+        return 0;
+    }
+    
+    return getCount(table, index);
+}
+
+void KMerPerfectTableLookupBatch(KMerPerfectTable* table, unsigned long long int* kmers,
+        unsigned int numKMers, unsigned int* counts)
+{
+    unsigned long long int hashes[KMER_PERFECT_LOOKUP_GROUP];
+    unsigned long long int indices[KMER_PERFECT_LOOKUP_GROUP];
+    unsigned long long int bit;
+    unsigned int size;
+    
+    for(unsigned int start = 0; start < numKMers; start += KMER_PERFECT_LOOKUP_GROUP)
+    {
+        size = numKMers - start < KMER_PERFECT_LOOKUP_GROUP ? numKMers - start : KMER_PERFECT_LOOKUP_GROUP;
+        
+        // Start loading the bits of the first two levels and their rank samples, 
+        // which find most k-mers:
+        for(unsigned int i = 0; i < size; i++)
+        {
+            hashes[i] = hashKMerWith(table->hashFunction, kmers[start + i]);
+            
+            for(unsigned int level = 0; level < 2 && level < table->numLevels; level++)
+            {
+                bit = table->levelOffsets[level] + getLevelBit(table, hashes[i], level);
+                
+                __builtin_prefetch(&(table->bits[bit >> 6]));
+                __builtin_prefetch(&(table->ranks[2 * ((bit >> 6) / KMER_PERFECT_RANK_WORDS)]));
+            }
+        }
+        
+        // Find every index and start loading its k-mer and count:
+        for(unsigned int i = 0; i < size; i++)
+        {
+            indices[i] = findIndex(table, kmers[start + i], hashes[i]);
+            
+            if(indices[i] < table->numKMers)
+            {
+                __builtin_prefetch(&(table->kmers[indices[i]]));
+                __builtin_prefetch(&(table->counts[indices[i] * table->countBits >> 6]));
+            }
+        }
+        
+        for(unsigned int i = 0; i < size; i++)
+        {
+            if(indices[i] < table->numKMers && table->kmers[indices[i]] == kmers[start + i])
+            {
+                counts[start + i] = getCount(table, indices[i]);
+            }
+            else
+            {
+                counts[start + i] = 0;
+            }
+        }
+    }
+}
+
+/* Copies an array into memory placed on the node. The pages are bound before 
+ * they are first touched, so none of them has to move. */
+static unsigned long long int* copyArray(unsigned long long int* array, 
+        unsigned long long int numWords, int node)
+{
+    unsigned long long int size = numWords * sizeof(unsigned long long int);
+    unsigned long long int* copy = (unsigned long long int*)allocateMemory(size);
+    
+    if(copy != NULL)
+    {
+        placeMemory(copy, size, node);
+        memcpy(copy, array, size);
+    }
+    
+    return copy;
+}
+
+KMerPerfectTable* copyKMerPerfectTable(KMerPerfectTable* table, int node)
+{
+    KMerPerfectTable* copy;
+    
+    if((copy = malloc(sizeof *copy)) == NULL)
+    {
+        return NULL;
+    }
+    
+    *copy = *table;
+    
+    copy->bits = copyArray(table->bits, table->numWords + 1, node);
+    copy->ranks = copyArray(table->ranks, getNumRanks(table), node);
+    copy->kmers = copyArray(table->kmers, table->numKMers + 1, node);
+    copy->counts = copyArray(table->counts, getNumCountWords(table), node);
+    copy->fallback = (unsigned long long int*)malloc((table->numFallback + 1) * sizeof(unsigned long long int));
+    
+    if(copy->bits == NULL || copy->ranks == NULL || copy->kmers == NULL || 
+            copy->counts == NULL || copy->fallback == NULL)
+    {
+        freeKMerPerfectTable(copy);
+        return NULL;
+    }
+    
+    memcpy(copy->fallback, table->fallback, table->numFallback * sizeof(unsigned long long int));
+    
+    return copy;
+}
+
+int KMerPerfectTablePlace(KMerPerfectTable* table, int node)
+{
+    return placeMemory(table->bits, (table->numWords + 1) * sizeof(unsigned long long int), node) &&
+            placeMemory(table->ranks, getNumRanks(table) * sizeof(unsigned long long int), node) &&
+            placeMemory(table->kmers, (table->numKMers + 1) * sizeof(unsigned long long int), node) &&
+            placeMemory(table->counts, getNumCountWords(table) * sizeof(unsigned long long int), node);
+}
+
+double KMerPerfectTableGetLocality(KMerPerfectTable* table, unsigned int node)
+{
+    // Nearly every lookup reads one word of each array:
+    double fractions[4] = {
+        getLocalFraction(table->bits, (table->numWords + 1) * sizeof(unsigned long long int), node),
+        getLocalFraction(table->ranks, getNumRanks(table) * sizeof(unsigned long long int), node),
+        getLocalFraction(table->kmers, (table->numKMers + 1) * sizeof(unsigned long long int), node),
+        getLocalFraction(table->counts, getNumCountWords(table) * sizeof(unsigned long long int), node)
+    };
+    double total = 0;
+    int known = 0;
+    
+    for(int i = 0; i < 4; i++)
+    {
+        if(fractions[i] >= 0)
+        {
+            total += fractions[i];
+            known++;
+        }
+    }
+    
+    return (known == 0) ? -1 : total / known;
+}
+
+unsigned long long int KMerPerfectTableGetMemory(KMerPerfectTable* table)
+{
+    return sizeof(KMerPerfectTable) + ((table->numWords + 1) + getNumRanks(table) + 
+            (table->numKMers + 1) + getNumCountWords(table) + table->numFallback) 
+            * sizeof(unsigned long long int);
+}
+
+void freeKMerPerfectTable(KMerPerfectTable* table)
+{
+    freeMemory(table->bits, (table->numWords + 1) * sizeof(unsigned long long int));
+    freeMemory(table->ranks, getNumRanks(table) * sizeof(unsigned long long int));
+    freeMemory(table->kmers, (table->numKMers + 1) * sizeof(unsigned long long int));
+    freeMemory(table->counts, getNumCountWords(table) * sizeof(unsigned long long int));
+    free(table->fallback);
+    free(table);
+}
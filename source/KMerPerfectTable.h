@@ -0,0 +1,172 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "KMerHash.h"
+
+#ifndef KMERPERFECTTABLE_H
+#define	KMERPERFECTTABLE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * A read-only k-mer table, built once counting is done (see KMerTableFreeze). 
+ * Its k-mers are indexed by a minimal perfect hash function: every k-mer of the 
+ * table has its own index from 0 to numKMers - 1, and the k-mers and their 
+ * counts are stored in dense arrays at those indices.
+ * 
+ * The perfect hash is built as in Limasset et al., "Fast and scalable minimal 
+ * perfect hashing for massive key sets" (BBHash). Each level is a bit array 
+ * KMER_PERFECT_GAMMA times as long as the number of k-mers given to it. Every 
+ * k-mer is hashed to a bit of the level, and the k-mers that have a bit to 
+ * themselves set it; the others are passed to the next level. The index of a 
+ * k-mer is the number of bits set before its bit, across all levels. It is 
+ * found with one popcount, from a rank sample every KMER_PERFECT_RANK_WORDS 
+ * words that also holds the relative rank of each of its words. The few k-mers 
+ * left after KMER_PERFECT_MAX_LEVELS levels are indexed by a sorted array of 
+ * their hashes. The levels and ranks alone take about 4 bits per k-mer.
+ * 
+ * A k-mer that is not in the table still maps to some index, so the k-mer at 
+ * that index is compared to it before its count is returned. Counts are 
+ * bit-packed, using as many bits as the largest count needs.
+ * 
+ * The whole 64-bit k-mer is kept for that comparison, rather than a short 
+ * fingerprint, so the table takes about 9 to 10 bytes per k-mer: 8 for the 
+ * k-mer, half a byte for the levels and ranks, and about one for its count. 
+ * That is a half to a third of the hash table it is built from, which takes 
+ * 9 bytes per slot at a load of at most 0.7, but it is not a compact index of 
+ * a few bits per k-mer.
+ */
+#define KMER_PERFECT_GAMMA 2
+#define KMER_PERFECT_MAX_LEVELS 32
+#define KMER_PERFECT_RANK_WORDS 8
+
+typedef struct
+{
+    unsigned long long int* bits;           // Every level, one after the other.
+    unsigned long long int* ranks;          // Two words per rank sample.
+    unsigned long long int numWords;
+    unsigned long long int levelOffsets[KMER_PERFECT_MAX_LEVELS];
+    unsigned long long int levelSizes[KMER_PERFECT_MAX_LEVELS];
+    unsigned int numLevels;
+    unsigned long long int numPlaced;       // K-mers indexed by the levels.
+    
+    unsigned long long int* fallback;       // Sorted hashes of the other k-mers.
+    unsigned long long int numFallback;
+    
+    unsigned long long int* kmers;          // Indexed by the perfect hash.
+    unsigned long long int* counts;         // Bit-packed, countBits each.
+    unsigned int countBits;
+    unsigned long long int numKMers;
+    
+    enum KMER_HASH_FUNCTION hashFunction;
+} KMerPerfectTable;
+
+/**
+ * Builds a perfect table over a set of distinct k-mers.
+ * 
+ * @param kmers The k-mers.
+ * @param counts The count of each k-mer.
+ * @param numKMers The number of k-mers.
+ * @param function The function hashing the k-mers.
+ * @return The new table, or NULL if it could not be allocated.
+ */
+KMerPerfectTable* newKMerPerfectTable(unsigned long long int* kmers, unsigned int* counts,
+        unsigned long long int numKMers, enum KMER_HASH_FUNCTION function);
+
+/**
+ * Returns the count of the k-mer stored at the given index.
+ * 
+ * @param table The table to work with.
+ * @param index The index, below numKMers.
+ * @return The count.
+ */
+unsigned int KMerPerfectTableGetCount(KMerPerfectTable* table, unsigned long long int index);
+
+/**
+ * Returns the count of a k-mer.
+ * 
+ * @param table The table to work with.
+ * @param kmer The k-mer, as stored.
+ * @return The count, or 0 if the k-mer is not in the table.
+ */
+unsigned int KMerPerfectTableLookup(KMerPerfectTable* table, unsigned long long int kmer);
+
+/**
+ * Looks up a batch of k-mers, loading the memory for several of them at once.
+ * 
+ * @param table The table to work with.
+ * @param kmers The k-mers, as stored.
+ * @param numKMers The number of k-mers.
+ * @param counts Set to the count of each k-mer, or 0 if it is not in the table.
+ */
+void KMerPerfectTableLookupBatch(KMerPerfectTable* table, unsigned long long int* kmers,
+        unsigned int numKMers, unsigned int* counts);
+
+/**
+ * Copies the table into memory placed on a NUMA node.
+ * 
+ * @param table The table to copy.
+ * @param node The node, or NUMA_INTERLEAVE.
+ * @return The copy, or NULL if it could not be allocated.
+ */
+KMerPerfectTable* copyKMerPerfectTable(KMerPerfectTable* table, int node);
+
+/**
+ * Moves the large arrays of the table to a NUMA node, or interleaves them.
+ * 
+ * @param table The table to work with.
+ * @param node The node, or NUMA_INTERLEAVE.
+ * @return Whether or not the table was placed.
+ */
+int KMerPerfectTablePlace(KMerPerfectTable* table, int node);
+
+/**
+ * Estimates the fraction of lookups from a NUMA node that read local memory, 
+ * from where the pages of the table are.
+ * 
+ * @param table The table to work with.
+ * @param node The node.
+ * @return The fraction of local reads, or -1 if it is unknown.
+ */
+double KMerPerfectTableGetLocality(KMerPerfectTable* table, unsigned int node);
+
+/**
+ * Returns the number of bytes used by the table.
+ * 
+ * @param table The table to work with.
+ * @return The size of the table in bytes.
+ */
+unsigned long long int KMerPerfectTableGetMemory(KMerPerfectTable* table);
+
+/**
+ * Releases the table.
+ * 
+ * @param table The table to release.
+ */
+void freeKMerPerfectTable(KMerPerfectTable* table);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* KMERPERFECTTABLE_H */
+
@@ -0,0 +1,684 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "KMerQuotientFilter.h"
+#include "Memory.h"
+
+// The smallest shard has (1 << KMER_QUOTIENT_MINIMUM_QUOTIENT_BITS) slots:
+#define KMER_QUOTIENT_MINIMUM_QUOTIENT_BITS 6
+
+// Shards are enlarged when more than 3/4 of their canonical slots are used:
+#define KMER_QUOTIENT_LOAD_NUMERATOR 3
+#define KMER_QUOTIENT_LOAD_DENOMINATOR 4
+
+static inline int getBit(unsigned long long int* bits, unsigned long long int index)
+{
+    return (bits[index >> 6] >> (index & 63)) & 1;
+}
+
+static inline void setBit(unsigned long long int* bits, unsigned long long int index, int value)
+{
+    if(value)
+    {
+        bits[index >> 6] |= 1ULL << (index & 63);
+    }
+    else
+    {
+        bits[index >> 6] &= ~(1ULL << (index & 63));
+    }
+}
+
+static inline unsigned long long int getRemainder(KMerQuotientShard* shard, unsigned long long int slot)
+{
+    unsigned long long int bit = slot * shard->remainderBits;
+    unsigned long long int word = bit >> 6;
+    unsigned int offset = bit & 63;
+    unsigned long long int value = shard->remainders[word] >> offset;
+    
+    if(offset + shard->remainderBits > 64)
+    {
+        value |= shard->remainders[word + 1] << (64 - offset);
+    }
+    
+    return value & ((1ULL << shard->remainderBits) - 1);
+}
+
+static inline void setRemainder(KMerQuotientShard* shard, unsigned long long int slot, 
+        unsigned long long int value)
+{
+    unsigned long long int bit = slot * shard->remainderBits;
+    unsigned long long int word = bit >> 6;
+    unsigned int offset = bit & 63;
+    unsigned long long int mask = (1ULL << shard->remainderBits) - 1;
+    
+    shard->remainders[word] = (shard->remainders[word] & ~(mask << offset)) | (value << offset);
+    
+    if(offset + shard->remainderBits > 64)
+    {
+        shard->remainders[word + 1] = (shard->remainders[word + 1] & ~(mask >> (64 - offset)))
+                | (value >> (64 - offset));
+    }
+}
+
+static inline int isEmpty(KMerQuotientShard* shard, unsigned long long int slot)
+{
+    return !getBit(shard->occupieds, slot) && !getBit(shard->continuations, slot)
+            && !getBit(shard->shifteds, slot);
+}
+
+/* Returns the number of counter slots needed after a remainder with the given 
+ * count. */
+static inline unsigned int getNumDigits(KMerQuotientShard* shard, unsigned long long int count)
+{
+    unsigned int digits = 0;
+    
+    if(count > 1)
+    {
+        while(count > 0)
+        {
+            digits++;
+            count >>= shard->remainderBits;
+        }
+    }
+    
+    return digits;
+}
+
+/* Returns the count stored after the remainder in the given slot, and sets next 
+ * to the slot following its counter slots. */
+static inline unsigned long long int readCount(KMerQuotientShard* shard, 
+        unsigned long long int slot, unsigned long long int* next)
+{
+    unsigned long long int count = 0;
+    unsigned int digit = 0;
+    
+    slot++;
+    
+    while(slot < shard->numSlots && getBit(shard->counters, slot))
+    {
+        count |= getRemainder(shard, slot) << (digit * shard->remainderBits);
+        
+        digit++;
+        slot++;
+    }
+    
+    *next = slot;
+    
+    return (digit == 0) ? 1 : count;
+}
+
+static inline void writeCount(KMerQuotientShard* shard, unsigned long long int slot, 
+        unsigned long long int count, unsigned int digits)
+{
+    unsigned long long int mask = (1ULL << shard->remainderBits) - 1;
+    
+    for(unsigned int i = 0; i < digits; i++)
+    {
+        setRemainder(shard, slot + 1 + i, (count >> (i * shard->remainderBits)) & mask);
+    }
+}
+
+/* Returns the slot where the run of the quotient starts, or where it would 
+ * start if the quotient is marked occupied but has no run yet. */
+static unsigned long long int findRunStart(KMerQuotientShard* shard, unsigned long long int quotient)
+{
+    unsigned long long int bucket = quotient;
+    unsigned long long int slot;
+    
+    // Walk back to the start of the cluster, which is never shifted:
+    while(bucket > 0 && getBit(shard->shifteds, bucket))
+    {
+        bucket--;
+    }
+    
+    // Walk forward one run for every occupied quotient before this one:
+    slot = bucket;
+    
+    while(bucket != quotient)
+    {
+        do
+        {
+            slot++;
+        } while(getBit(shard->continuations, slot));
+        
+        do
+        {
+            bucket++;
+        } while(!getBit(shard->occupieds, bucket));
+    }
+    
+    return slot;
+}
+
+/* Returns whether or not there are the given number of empty slots between 
+ * the slot and the end of the shard. */
+static int hasRoom(KMerQuotientShard* shard, unsigned long long int slot, unsigned int needed)
+{
+    unsigned int found = 0;
+    
+    for(; slot < shard->numSlots && found < needed; slot++)
+    {
+        found += isEmpty(shard, slot);
+    }
+    
+    return found == needed;
+}
+
+/* Places the contents of a slot at the given position, shifting everything up 
+ * to the next empty slot one slot to the right. */
+static void insertSlot(KMerQuotientShard* shard, unsigned long long int slot,
+        unsigned long long int quotient, unsigned long long int remainder, 
+        int continuation, int counter)
+{
+    unsigned long long int empty = slot;
+    
+    while(!isEmpty(shard, empty))
+    {
+        empty++;
+    }
+    
+    for(unsigned long long int i = empty; i > slot; i--)
+    {
+        setRemainder(shard, i, getRemainder(shard, i - 1));
+        setBit(shard->continuations, i, getBit(shard->continuations, i - 1));
+        setBit(shard->counters, i, getBit(shard->counters, i - 1));
+        setBit(shard->shifteds, i, 1);
+    }
+    
+    setRemainder(shard, slot, remainder);
+    setBit(shard->continuations, slot, continuation);
+    setBit(shard->counters, slot, counter);
+    setBit(shard->shifteds, slot, slot != quotient);
+    
+    shard->usedSlots++;
+}
+
+/* Adds amount to the count of the remainder in the quotient's run. Returns 0, 
+ * leaving the shard unchanged, if there is no room to shift into. */
+static int addToShard(KMerQuotientShard* shard, unsigned long long int quotient,
+        unsigned long long int remainder, unsigned long long int amount)
+{
+    unsigned long long int start;
+    unsigned long long int slot;
+    unsigned long long int next;
+    unsigned long long int count;
+    unsigned int digits;
+    unsigned int oldDigits;
+    
+    if(getBit(shard->occupieds, quotient))
+    {
+        start = findRunStart(shard, quotient);
+        slot = start;
+        
+        // Remainders are sorted within their run:
+        while(1)
+        {
+            count = readCount(shard, slot, &next);
+            
+            if(getRemainder(shard, slot) == remainder)
+            {
+                oldDigits = next - slot - 1;
+                digits = getNumDigits(shard, count + amount);
+                
+                if(digits > oldDigits && !hasRoom(shard, next, digits - oldDigits))
+                {
+                    return 0;
+                }
+                
+                for(unsigned int i = oldDigits; i < digits; i++)
+                {
+                    insertSlot(shard, slot + 1 + i, quotient, 0, 1, 1);
+                }
+                
+                writeCount(shard, slot, count + amount, digits);
+                
+                return 1;
+            }
+            
+            if(getRemainder(shard, slot) > remainder)
+            {
+                break;
+            }
+            
+            slot = next;
+            
+            if(next >= shard->numSlots || !getBit(shard->continuations, next))
+            {
+                break;
+            }
+        }
+        
+        digits = getNumDigits(shard, amount);
+        
+        if(!hasRoom(shard, slot, 1 + digits))
+        {
+            return 0;
+        }
+        
+        insertSlot(shard, slot, quotient, remainder, slot != start, 0);
+        
+        // The old start of the run now continues it:
+        if(slot == start)
+        {
+            setBit(shard->continuations, slot + 1, 1);
+        }
+    }
+    else
+    {
+        // The run goes where it would start if the quotient were occupied, 
+        // but the canonical slot must still look empty while shifting:
+        setBit(shard->occupieds, quotient, 1);
+        slot = findRunStart(shard, quotient);
+        setBit(shard->occupieds, quotient, 0);
+        
+        digits = getNumDigits(shard, amount);
+        
+        if(!hasRoom(shard, slot, 1 + digits))
+        {
+            return 0;
+        }
+        
+        insertSlot(shard, slot, quotient, remainder, 0, 0);
+        setBit(shard->occupieds, quotient, 1);
+    }
+    
+    for(unsigned int i = 0; i < digits; i++)
+    {
+        insertSlot(shard, slot + 1 + i, quotient, 0, 1, 1);
+    }
+    
+    writeCount(shard, slot, amount, digits);
+    shard->entries++;
+    
+    return 1;
+}
+
+static unsigned long long int getShardBytes(unsigned long long int numSlots, unsigned int remainderBits)
+{
+    unsigned long long int remainderWords = (numSlots * remainderBits + 63) / 64 + 1;
+    unsigned long long int bitWords = (numSlots + 63) / 64;
+    
+    return (remainderWords + 4 * bitWords) * sizeof(unsigned long long int);
+}
+
+/* Allocates empty arrays for a shard, leaving its lock alone. */
+static int allocateShard(KMerQuotientShard* shard, unsigned int quotientBits, unsigned int remainderBits)
+{
+    unsigned long long int canonical = 1ULL << quotientBits;
+    unsigned long long int numSlots = canonical + canonical / 8 + 64;
+    unsigned long long int bitWords = (numSlots + 63) / 64;
+    unsigned long long int* memory;
+    
+    if((memory = (unsigned long long int*)allocateMemory(getShardBytes(numSlots, remainderBits))) == NULL)
+    {
+        return 0;
+    }
+    
+    shard->occupieds = memory;
+    shard->continuations = memory + bitWords;
+    shard->shifteds = memory + 2 * bitWords;
+    shard->counters = memory + 3 * bitWords;
+    shard->remainders = memory + 4 * bitWords;
+    
+    shard->quotientBits = quotientBits;
+    shard->remainderBits = remainderBits;
+    shard->numSlots = numSlots;
+    shard->usedSlots = 0;
+    shard->entries = 0;
+    
+    return 1;
+}
+
+static void releaseShard(KMerQuotientShard* shard)
+{
+    if(shard->occupieds != NULL)
+    {
+        freeMemory(shard->occupieds, getShardBytes(shard->numSlots, shard->remainderBits));
+        shard->occupieds = NULL;
+    }
+}
+
+/* Moves every fingerprint with a count of at least minimumCount into new 
+ * arrays with the given sizes. The fingerprint keeps its bits, so the quotient 
+ * and remainder bits must add up to the same as before, unless the shard is 
+ * empty. */
+static int rebuildShard(KMerQuotientShard* shard, unsigned int quotientBits,
+        unsigned int remainderBits, unsigned long long int minimumCount)
+{
+    KMerQuotientShard rebuilt;
+    unsigned long long int position = 0;
+    unsigned long long int quotient = 0;
+    unsigned long long int fingerprint;
+    unsigned long long int count;
+    
+    if(!allocateShard(&rebuilt, quotientBits, remainderBits))
+    {
+        return 0;
+    }
+    
+    while(KMerQuotientShardNext(shard, &position, &quotient, &fingerprint, &count))
+    {
+        if(count >= minimumCount && !addToShard(&rebuilt, fingerprint >> remainderBits,
+                fingerprint & ((1ULL << remainderBits) - 1), count))
+        {
+            releaseShard(&rebuilt);
+            return 0;
+        }
+    }
+    
+    releaseShard(shard);
+    
+    shard->remainders = rebuilt.remainders;
+    shard->occupieds = rebuilt.occupieds;
+    shard->continuations = rebuilt.continuations;
+    shard->shifteds = rebuilt.shifteds;
+    shard->counters = rebuilt.counters;
+    shard->quotientBits = rebuilt.quotientBits;
+    shard->remainderBits = rebuilt.remainderBits;
+    shard->numSlots = rebuilt.numSlots;
+    shard->usedSlots = rebuilt.usedSlots;
+    shard->entries = rebuilt.entries;
+    
+    return 1;
+}
+
+/* Enlarges the shard to the given number of quotient bits. An empty shard is 
+ * simply replaced; otherwise, each extra quotient bit is taken from the 
+ * remainders, keeping at least one. */
+static int growShard(KMerQuotientFilter* filter, KMerQuotientShard* shard, unsigned int quotientBits)
+{
+    unsigned int fingerprintBits = shard->quotientBits + shard->remainderBits;
+    
+    if(shard->entries == 0)
+    {
+        if(quotientBits + filter->remainderBits > KMER_QUOTIENT_MAX_FINGERPRINT_BITS)
+        {
+            quotientBits = KMER_QUOTIENT_MAX_FINGERPRINT_BITS - filter->remainderBits;
+        }
+        
+        return rebuildShard(shard, quotientBits, filter->remainderBits, 1);
+    }
+    
+    if(quotientBits >= fingerprintBits)
+    {
+        quotientBits = fingerprintBits - 1;
+    }
+    
+    if(quotientBits <= shard->quotientBits)
+    {
+        return 1;
+    }
+    
+    return rebuildShard(shard, quotientBits, fingerprintBits - quotientBits, 1);
+}
+
+static inline int isFull(KMerQuotientShard* shard, unsigned long long int needed)
+{
+    return (shard->usedSlots + needed) * KMER_QUOTIENT_LOAD_DENOMINATOR
+            > (1ULL << shard->quotientBits) * KMER_QUOTIENT_LOAD_NUMERATOR;
+}
+
+KMerQuotientFilter* newKMerQuotientFilter(unsigned int remainderBits)
+{
+    KMerQuotientFilter* filter;
+    
+    if(remainderBits < 1 || remainderBits > 32)
+    {
+        return NULL;
+    }
+    
+    if((filter = calloc(1, sizeof *filter)) == NULL)
+    {
+        return NULL;
+    }
+    
+    filter->remainderBits = remainderBits;
+    
+    for(int i = 0; i < KMER_QUOTIENT_NUM_SHARDS; i++)
+    {
+        if(!allocateShard(&(filter->shards[i]), KMER_QUOTIENT_MINIMUM_QUOTIENT_BITS, remainderBits))
+        {
+            freeKMerQuotientFilter(filter);
+            return NULL;
+        }
+        
+        pthread_mutex_init(&(filter->shards[i].lock), NULL);
+    }
+    
+    return filter;
+}
+
+int KMerQuotientFilterReserve(KMerQuotientFilter* filter, unsigned long long int numSlots)
+{
+    unsigned long long int needed = numSlots / KMER_QUOTIENT_NUM_SHARDS + 1;
+    KMerQuotientShard* shard;
+    unsigned int quotientBits;
+    
+    for(int i = 0; i < KMER_QUOTIENT_NUM_SHARDS; i++)
+    {
+        shard = &(filter->shards[i]);
+        quotientBits = shard->quotientBits;
+        
+        while((shard->usedSlots + needed) * KMER_QUOTIENT_LOAD_DENOMINATOR
+                > (1ULL << quotientBits) * KMER_QUOTIENT_LOAD_NUMERATOR)
+        {
+            quotientBits++;
+        }
+        
+        if(quotientBits > shard->quotientBits && !growShard(filter, shard, quotientBits))
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+void KMerQuotientFilterAdd(KMerQuotientFilter* filter, unsigned long long int hash,
+        unsigned int amount)
+{
+    KMerQuotientShard* shard = &(filter->shards[hash >> (64 - KMER_QUOTIENT_SHARD_BITS)]);
+    unsigned long long int fingerprint;
+    unsigned int fingerprintBits;
+    
+    pthread_mutex_lock(&(shard->lock));
+    
+    while(1)
+    {
+        fingerprintBits = shard->quotientBits + shard->remainderBits;
+        fingerprint = (hash << KMER_QUOTIENT_SHARD_BITS) >> (64 - fingerprintBits);
+        
+        if(!isFull(shard, 1 + getNumDigits(shard, amount))
+                && addToShard(shard, fingerprint >> shard->remainderBits,
+                fingerprint & ((1ULL << shard->remainderBits) - 1), amount))
+        {
+            break;
+        }
+        
+        if(shard->remainderBits <= 1 || !growShard(filter, shard, shard->quotientBits + 1))
+        {
+            printf("CRITICAL: FAILED TO ENLARGE QUOTIENT FILTER!\n");
+            exit(1);
+        }
+    }
+    
+    pthread_mutex_unlock(&(shard->lock));
+}
+
+unsigned long long int KMerQuotientFilterLookup(KMerQuotientFilter* filter, unsigned long long int hash)
+{
+    KMerQuotientShard* shard = &(filter->shards[hash >> (64 - KMER_QUOTIENT_SHARD_BITS)]);
+    unsigned int fingerprintBits = shard->quotientBits + shard->remainderBits;
+    unsigned long long int fingerprint = (hash << KMER_QUOTIENT_SHARD_BITS) >> (64 - fingerprintBits);
+    unsigned long long int quotient = fingerprint >> shard->remainderBits;
+    unsigned long long int remainder = fingerprint & ((1ULL << shard->remainderBits) - 1);
+    unsigned long long int slot;
+    unsigned long long int next;
+    unsigned long long int count;
+    
+    if(!getBit(shard->occupieds, quotient))
+    {
+        return 0;
+    }
+    
+    slot = findRunStart(shard, quotient);
+    
+    while(1)
+    {
+        count = readCount(shard, slot, &next);
+        
+        if(getRemainder(shard, slot) == remainder)
+        {
+            return count;
+        }
+        
+        if(getRemainder(shard, slot) > remainder || next >= shard->numSlots
+                || !getBit(shard->continuations, next))
+        {
+            return 0;
+        }
+        
+        slot = next;
+    }
+}
+
+int KMerQuotientShardSeek(KMerQuotientShard* shard, unsigned long long int* position)
+{
+    while(*position < shard->numSlots && isEmpty(shard, *position))
+    {
+        (*position)++;
+    }
+    
+    return *position < shard->numSlots;
+}
+
+int KMerQuotientShardNext(KMerQuotientShard* shard, unsigned long long int* position,
+        unsigned long long int* quotient, unsigned long long int* fingerprint, 
+        unsigned long long int* count)
+{
+    unsigned long long int slot;
+    
+    if(!KMerQuotientShardSeek(shard, position))
+    {
+        return 0;
+    }
+    
+    slot = *position;
+    
+    // A remainder in its canonical slot starts a cluster; any other start of a 
+    // run belongs to the next occupied quotient:
+    if(!getBit(shard->shifteds, slot))
+    {
+        *quotient = slot;
+    }
+    else if(!getBit(shard->continuations, slot))
+    {
+        do
+        {
+            (*quotient)++;
+        } while(!getBit(shard->occupieds, *quotient));
+    }
+    
+    *fingerprint = (*quotient << shard->remainderBits) | getRemainder(shard, slot);
+    *count = readCount(shard, slot, position);
+    
+    return 1;
+}
+
+int KMerQuotientFilterPrune(KMerQuotientFilter* filter, unsigned int firstShard,
+        unsigned int lastShard, unsigned int minimumCount, 
+        unsigned long long int* histogram, unsigned long long int histogramMax,
+        unsigned long long int* unique, unsigned long long int* total)
+{
+    KMerQuotientShard* shard;
+    unsigned long long int position;
+    unsigned long long int quotient;
+    unsigned long long int fingerprint;
+    unsigned long long int count;
+    
+    for(unsigned int i = firstShard; i < lastShard; i++)
+    {
+        shard = &(filter->shards[i]);
+        position = 0;
+        quotient = 0;
+        
+        while(KMerQuotientShardNext(shard, &position, &quotient, &fingerprint, &count))
+        {
+            if(count <= histogramMax)
+            {
+                histogram[count]++;
+            }
+            
+            if(count < minimumCount)
+            {
+                (*unique)++;
+            }
+            
+            (*total)++;
+        }
+        
+        if(!rebuildShard(shard, shard->quotientBits, shard->remainderBits, minimumCount))
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+unsigned long long int KMerQuotientFilterNumEntries(KMerQuotientFilter* filter)
+{
+    unsigned long long int entries = 0;
+    
+    for(int i = 0; i < KMER_QUOTIENT_NUM_SHARDS; i++)
+    {
+        entries += filter->shards[i].entries;
+    }
+    
+    return entries;
+}
+
+unsigned long long int KMerQuotientFilterGetMemory(KMerQuotientFilter* filter)
+{
+    unsigned long long int bytes = sizeof(KMerQuotientFilter);
+    
+    for(int i = 0; i < KMER_QUOTIENT_NUM_SHARDS; i++)
+    {
+        bytes += getShardBytes(filter->shards[i].numSlots, filter->shards[i].remainderBits);
+    }
+    
+    return bytes;
+}
+
+void freeKMerQuotientFilter(KMerQuotientFilter* filter)
+{
+    for(int i = 0; i < KMER_QUOTIENT_NUM_SHARDS; i++)
+    {
+        if(filter->shards[i].occupieds != NULL)
+        {
+            releaseShard(&(filter->shards[i]));
+            pthread_mutex_destroy(&(filter->shards[i].lock));
+        }
+    }
+    
+    free(filter);
+}
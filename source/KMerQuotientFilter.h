@@ -0,0 +1,204 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <pthread.h>
+
+#ifndef KMERQUOTIENTFILTER_H
+#define	KMERQUOTIENTFILTER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * A counting quotient filter: an approximate k-mer table that stores a short 
+ * fingerprint of each k-mer's hash instead of the k-mer itself.
+ * 
+ * The filter is partitioned into KMER_QUOTIENT_NUM_SHARDS shards by the high 
+ * bits of the hash, the same way as the k-mer table. Within a shard, the next 
+ * (quotientBits + remainderBits) bits of the hash are the fingerprint. The 
+ * quotient selects the canonical slot and only the remainder is stored: all 
+ * the remainders of one quotient are kept sorted in one run of consecutive 
+ * slots, which starts at the canonical slot or is shifted right by the runs 
+ * before it. Three bits per slot (occupied, continuation and shifted) are 
+ * enough to find any run, as in Bender et al., "Don't Thrash: How to Cache 
+ * Your Hash on Flash".
+ * 
+ * Counts are stored in place: a remainder with a count above 1 is followed in 
+ * its run by as many slots as the count needs, each holding remainderBits of 
+ * the count, least significant first. A fourth bit marks these counter slots. 
+ * Most k-mers are seen once and take a single slot.
+ * 
+ * A slot takes (remainderBits + 4) bits. A k-mer that was never counted is 
+ * mistaken for another k-mer whose fingerprint is the same, with a 
+ * probability of about (entries / 2^quotientBits) * 2^-remainderBits for each 
+ * lookup or insertion, which is below 2^-remainderBits. Such a k-mer takes the 
+ * other k-mer's count, and adds to it while counting. With 8 remainder bits, 
+ * this is at most 0.4% at the highest load. A shard cannot be enlarged 
+ * without taking a bit from its remainders, doubling its false-positive rate, 
+ * so the filter should be reserved for every k-mer up front.
+ * 
+ * Several threads may add to the filter at once: each shard has a mutex held 
+ * while adding to it. Lookups must not run while adding.
+ */
+#define KMER_QUOTIENT_SHARD_BITS 8
+#define KMER_QUOTIENT_NUM_SHARDS (1 << KMER_QUOTIENT_SHARD_BITS)
+
+#define KMER_QUOTIENT_MAX_FINGERPRINT_BITS (64 - KMER_QUOTIENT_SHARD_BITS)
+#define KMER_QUOTIENT_DEFAULT_REMAINDER_BITS 8
+
+typedef struct
+{
+    unsigned long long int* remainders;     // Bit-packed, remainderBits per slot.
+    unsigned long long int* occupieds;      // Bit per canonical slot: has a run.
+    unsigned long long int* continuations;  // Bit per slot: not the first of its run.
+    unsigned long long int* shifteds;       // Bit per slot: not in its canonical slot.
+    unsigned long long int* counters;       // Bit per slot: holds part of a count.
+    
+    unsigned int quotientBits;
+    unsigned int remainderBits;
+    unsigned long long int numSlots;        // (1 << quotientBits) and room to shift into.
+    unsigned long long int usedSlots;
+    unsigned long long int entries;         // Number of distinct fingerprints.
+    
+    pthread_mutex_t lock;                   // Held while adding to the shard.
+} KMerQuotientShard;
+
+typedef struct
+{
+    KMerQuotientShard shards[KMER_QUOTIENT_NUM_SHARDS];
+    
+    unsigned int remainderBits;             // For shards that have not grown.
+} KMerQuotientFilter;
+
+/**
+ * Creates a new, empty quotient filter.
+ * 
+ * @param remainderBits The number of bits stored for each k-mer, from 1 to 32.
+ * @return The new filter, or NULL if it could not be allocated.
+ */
+KMerQuotientFilter* newKMerQuotientFilter(unsigned int remainderBits);
+
+/**
+ * Makes room for the given number of slots, spread over the shards. Empty 
+ * shards are sized without losing remainder bits.
+ * 
+ * @param filter The filter to work with.
+ * @param numSlots The number of slots to make room for: one for every 
+ *      distinct k-mer and another for every repeated k-mer.
+ * @return Whether or not there was enough memory.
+ */
+int KMerQuotientFilterReserve(KMerQuotientFilter* filter, unsigned long long int numSlots);
+
+/**
+ * Adds amount to the count of the hash's fingerprint. Several threads may do 
+ * this at the same time.
+ * 
+ * @param filter The filter to work with.
+ * @param hash The 64-bit hash of the k-mer.
+ * @param amount The amount to add.
+ */
+void KMerQuotientFilterAdd(KMerQuotientFilter* filter, unsigned long long int hash,
+        unsigned int amount);
+
+/**
+ * Returns the count of the hash's fingerprint.
+ * 
+ * @param filter The filter to work with.
+ * @param hash The 64-bit hash of the k-mer.
+ * @return The count, or 0 if the fingerprint is absent.
+ */
+unsigned long long int KMerQuotientFilterLookup(KMerQuotientFilter* filter, unsigned long long int hash);
+
+/**
+ * Advances a position in a shard to the next slot holding a fingerprint.
+ * 
+ * @param shard The shard to work with.
+ * @param position The slot to advance from, 0 to start.
+ * @return Whether or not there was another fingerprint.
+ */
+int KMerQuotientShardSeek(KMerQuotientShard* shard, unsigned long long int* position);
+
+/**
+ * Finds the next fingerprint of a shard, in order.
+ * 
+ * @param shard The shard to work with.
+ * @param position The slot to continue from, 0 to start. It is advanced past 
+ *      the fingerprint.
+ * @param quotient The quotient of the previous fingerprint, updated with the 
+ *      quotient of the next one.
+ * @param fingerprint The next fingerprint.
+ * @param count The count of the next fingerprint.
+ * @return Whether or not there was another fingerprint.
+ */
+int KMerQuotientShardNext(KMerQuotientShard* shard, unsigned long long int* position,
+        unsigned long long int* quotient, unsigned long long int* fingerprint, 
+        unsigned long long int* count);
+
+/**
+ * Removes the fingerprints whose count is below minimumCount from a range of 
+ * shards. The counts of every fingerprint are tallied into the histogram, and 
+ * the number of fingerprints examined and removed are added to total and 
+ * unique.
+ * 
+ * @param filter The filter to work with.
+ * @param firstShard The first shard to prune.
+ * @param lastShard One past the last shard to prune.
+ * @param minimumCount The smallest count kept.
+ * @param histogram The count tallies to add to.
+ * @param histogramMax The largest count tallied.
+ * @param unique Incremented by the number of fingerprints removed.
+ * @param total Incremented by the number of fingerprints examined.
+ * @return Whether or not there was enough memory to rebuild the shards.
+ */
+int KMerQuotientFilterPrune(KMerQuotientFilter* filter, unsigned int firstShard,
+        unsigned int lastShard, unsigned int minimumCount, 
+        unsigned long long int* histogram, unsigned long long int histogramMax,
+        unsigned long long int* unique, unsigned long long int* total);
+
+/**
+ * Returns the number of fingerprints in the filter.
+ * 
+ * @param filter The filter to work with.
+ * @return The number of fingerprints.
+ */
+unsigned long long int KMerQuotientFilterNumEntries(KMerQuotientFilter* filter);
+
+/**
+ * Returns the number of bytes used by the filter.
+ * 
+ * @param filter The filter to work with.
+ * @return The size of the filter in bytes.
+ */
+unsigned long long int KMerQuotientFilterGetMemory(KMerQuotientFilter* filter);
+
+/**
+ * Releases the filter.
+ * 
+ * @param filter The filter to release.
+ */
+void freeKMerQuotientFilter(KMerQuotientFilter* filter);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* KMERQUOTIENTFILTER_H */
+
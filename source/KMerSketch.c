@@ -0,0 +1,313 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "KMerSketch.h"
+
+/* Mixes the bits of the k-mer (SplitMix64 finalizer). This is deliberately 
+ * different from the k-mer table's hash. */
+static inline unsigned long long int hashSketchKMer(unsigned long long int kmer)
+{
+    kmer ^= kmer >> 30;
+    kmer *= 0xBF58476D1CE4E5B9ULL;
+    kmer ^= kmer >> 27;
+    kmer *= 0x94D049BB133111EBULL;
+    kmer ^= kmer >> 31;
+    
+    return kmer;
+}
+
+/* Returns whether the nucleotide is an N. */
+static inline int isN(char nucleotide)
+{
+    return nucleotide == 'N' || nucleotide == 'n';
+}
+
+/* Returns the 2-bit code of the nucleotide, or -1 if it is not A, C, G or T. */
+static inline int getNucleotideCode(char nucleotide)
+{
+    switch(nucleotide)
+    {
+        case 'A': case 'a': return 0x0;
+        case 'G': case 'g': return 0x1;
+        case 'C': case 'c': return 0x2;
+        case 'T': case 't': return 0x3;
+    }
+    
+    return -1;
+}
+
+/* The sample is probed with hash bits that select neither the register nor 
+ * the sample. */
+static inline unsigned int getSampleSlot(unsigned long long int hash)
+{
+    return (unsigned int)(hash >> 24) & (KMER_SKETCH_SAMPLE_CAPACITY - 1);
+}
+
+static void addToSample(KMerSketch* sketch, unsigned long long int kmer, 
+        unsigned long long int hash, unsigned int count)
+{
+    unsigned int slot = getSampleSlot(hash);
+    
+    while(sketch->sampleKMers[slot] != 0 && sketch->sampleKMers[slot] != kmer + 1)
+    {
+        slot = (slot + 1) & (KMER_SKETCH_SAMPLE_CAPACITY - 1);
+    }
+    
+    if(sketch->sampleKMers[slot] == 0)
+    {
+        sketch->sampleKMers[slot] = kmer + 1;
+        sketch->sampleEntries++;
+    }
+    
+    sketch->sampleCounts[slot] += count;
+}
+
+/* Halves the sample by requiring one more hash bit to be 0. */
+static void shrinkSample(KMerSketch* sketch)
+{
+    unsigned long long int* kmers = sketch->sampleKMers;
+    unsigned int* counts = sketch->sampleCounts;
+    unsigned long long int hash;
+    
+    sketch->sampleKMers = (unsigned long long int*)calloc(KMER_SKETCH_SAMPLE_CAPACITY, sizeof(unsigned long long int));
+    sketch->sampleCounts = (unsigned int*)calloc(KMER_SKETCH_SAMPLE_CAPACITY, sizeof(unsigned int));
+    
+    if(sketch->sampleKMers == NULL || sketch->sampleCounts == NULL)
+    {
+        printf("CRITICAL: FAILED TO ALLOCATE K-MER SKETCH!\n");
+        exit(1);
+    }
+    
+    sketch->sampleEntries = 0;
+    sketch->sampleBits++;
+    
+    for(unsigned int i = 0; i < KMER_SKETCH_SAMPLE_CAPACITY; i++)
+    {
+        if(kmers[i] == 0)
+        {
+            continue;
+        }
+        
+        hash = hashSketchKMer(kmers[i] - 1);
+        
+        if((hash & ((1ULL << sketch->sampleBits) - 1)) == 0)
+        {
+            addToSample(sketch, kmers[i] - 1, hash, counts[i]);
+        }
+    }
+    
+    free(kmers);
+    free(counts);
+}
+
+static inline void addKMer(KMerSketch* sketch, unsigned long long int kmer)
+{
+    unsigned long long int hash = hashSketchKMer(kmer);
+    
+    // HyperLogLog: the top bits select a register, which keeps the longest run 
+    // of leading zeros seen in the remaining bits.
+    unsigned int index = (unsigned int)(hash >> (64 - KMER_SKETCH_PRECISION));
+    unsigned long long int rest = (hash << KMER_SKETCH_PRECISION) | (1ULL << (KMER_SKETCH_PRECISION - 1));
+    unsigned char rank = (unsigned char)(__builtin_clzll(rest) + 1);
+    
+    if(rank > sketch->registers[index])
+    {
+        sketch->registers[index] = rank;
+    }
+    
+    // Sample:
+    if((hash & ((1ULL << sketch->sampleBits) - 1)) == 0)
+    {
+        addToSample(sketch, kmer, hash, 1);
+        
+        if(sketch->sampleEntries > KMER_SKETCH_SAMPLE_CAPACITY / 2)
+        {
+            shrinkSample(sketch);
+        }
+    }
+}
+
+KMerSketch* newKMerSketch(unsigned int kmerSize)
+{
+    KMerSketch* sketch;
+    
+    if((sketch = malloc(sizeof *sketch)) != NULL)
+    {
+        sketch->kmerSize = kmerSize;
+        sketch->sampleKMers = (unsigned long long int*)malloc(KMER_SKETCH_SAMPLE_CAPACITY * sizeof(unsigned long long int));
+        sketch->sampleCounts = (unsigned int*)malloc(KMER_SKETCH_SAMPLE_CAPACITY * sizeof(unsigned int));
+        
+        if(sketch->sampleKMers == NULL || sketch->sampleCounts == NULL)
+        {
+            freeKMerSketch(sketch);
+            return NULL;
+        }
+        
+        KMerSketchReset(sketch);
+    }
+    
+    return sketch;
+}
+
+void KMerSketchAddSequence(KMerSketch* sketch, char* sequence, unsigned int length)
+{
+    unsigned int kmerSize = sketch->kmerSize;
+    unsigned long long int mask = (kmerSize < 32) ? ((1ULL << (2 * kmerSize)) - 1) : ~0ULL;
+    unsigned long long int forward = 0;
+    unsigned long long int reverse = 0;
+    unsigned int valid = 0;
+    unsigned int start = 0;
+    int code;
+    
+    // Leading and trailing N's are trimmed when reads are loaded:
+    while(length > 0 && (isN(sequence[length - 1]) || 
+            sequence[length - 1] == '\n' || sequence[length - 1] == '\r'))
+    {
+        length--;
+    }
+    
+    while(start < length && isN(sequence[start]))
+    {
+        start++;
+    }
+    
+    for(unsigned int i = start; i < length; i++)
+    {
+        code = getNucleotideCode(sequence[i]);
+        
+        // Other N's are replaced by A, C, G and T in turn:
+        if(isN(sequence[i]))
+        {
+            code = getNucleotideCode("ACGT"[sketch->replacement]);
+            sketch->replacement = (sketch->replacement + 1) % 4;
+        }
+        
+        if(code < 0)
+        {
+            // Start over after the unknown base:
+            valid = 0;
+            continue;
+        }
+        
+        // Roll both strands (right-aligned):
+        forward = ((forward << 2) | code) & mask;
+        reverse = (reverse >> 2) | ((unsigned long long int)(0x3 - code) << (2 * (kmerSize - 1)));
+        valid++;
+        
+        if(valid >= kmerSize)
+        {
+            addKMer(sketch, forward < reverse ? forward : reverse);
+        }
+    }
+}
+
+unsigned long long int KMerSketchGetDistinct(KMerSketch* sketch)
+{
+    const double m = KMER_SKETCH_REGISTERS;
+    const double alpha = 0.7213 / (1.0 + 1.079 / m);
+    
+    double sum = 0;
+    unsigned int zeros = 0;
+    double estimate;
+    
+    for(int i = 0; i < KMER_SKETCH_REGISTERS; i++)
+    {
+        sum += ldexp(1.0, -sketch->registers[i]);
+        
+        if(sketch->registers[i] == 0)
+        {
+            zeros++;
+        }
+    }
+    
+    estimate = alpha * m * m / sum;
+    
+    // Small cardinalities are better estimated from the empty registers:
+    if(estimate <= 2.5 * m && zeros > 0)
+    {
+        estimate = m * log(m / zeros);
+    }
+    
+    return (unsigned long long int)(estimate + 0.5);
+}
+
+unsigned long long int KMerSketchGetRepeated(KMerSketch* sketch)
+{
+    unsigned int repeated = 0;
+    
+    if(sketch->sampleEntries == 0)
+    {
+        return 0;
+    }
+    
+    for(unsigned int i = 0; i < KMER_SKETCH_SAMPLE_CAPACITY; i++)
+    {
+        if(sketch->sampleKMers[i] != 0 && sketch->sampleCounts[i] > 1)
+        {
+            repeated++;
+        }
+    }
+    
+    return (unsigned long long int)((double)KMerSketchGetDistinct(sketch) * repeated / sketch->sampleEntries + 0.5);
+}
+
+void KMerSketchExtrapolate(KMerSketch* sketch, double scale, 
+        unsigned long long int* distinct, unsigned long long int* repeated)
+{
+    unsigned long long int singletons;
+    
+    *distinct = KMerSketchGetDistinct(sketch);
+    *repeated = KMerSketchGetRepeated(sketch);
+    
+    // The whole file was sketched:
+    if(scale <= 1.0)
+    {
+        return;
+    }
+    
+    singletons = (*distinct > *repeated) ? *distinct - *repeated : 0;
+    
+    // The rest of the file has (scale - 1) times as many k-mers as the part 
+    // sketched, of which a fraction singletons / k-mers are new:
+    *distinct += (unsigned long long int)(singletons * (scale - 1.0) + 0.5);
+    *repeated += singletons;
+}
+
+void KMerSketchReset(KMerSketch* sketch)
+{
+    memset(sketch->registers, 0, sizeof(sketch->registers));
+    memset(sketch->sampleKMers, 0, KMER_SKETCH_SAMPLE_CAPACITY * sizeof(unsigned long long int));
+    memset(sketch->sampleCounts, 0, KMER_SKETCH_SAMPLE_CAPACITY * sizeof(unsigned int));
+    
+    sketch->sampleEntries = 0;
+    sketch->sampleBits = 0;
+    sketch->replacement = 0;
+}
+
+void freeKMerSketch(KMerSketch* sketch)
+{
+    free(sketch->sampleKMers);
+    free(sketch->sampleCounts);
+    free(sketch);
+}
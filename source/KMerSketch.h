@@ -0,0 +1,135 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Utility.h"
+
+#ifndef KMERSKETCH_H
+#define	KMERSKETCH_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * A small, fixed-size summary of the k-mers of a file, used to size the k-mer 
+ * table before counting. It is built from the raw sequence text while the file 
+ * is first scanned.
+ * 
+ * The number of distinct k-mers is estimated with HyperLogLog. The number of 
+ * repeated (non-singleton) k-mers is estimated from an exact count of a sample 
+ * of the k-mers, chosen by their hash so that every occurrence of a sampled 
+ * k-mer is counted. Whenever the sample fills, it is halved by also requiring 
+ * the next bit of the hash to be 0.
+ * 
+ * A sketch of only the beginning of a file can be extrapolated to the whole 
+ * file (see KMerSketchExtrapolate).
+ * 
+ * Sequences are read as they will be loaded: leading and trailing N's are 
+ * trimmed and other N's are replaced by A, C, G and T in turn. K-mers 
+ * containing anything else are skipped.
+ */
+#define KMER_SKETCH_PRECISION 14
+#define KMER_SKETCH_REGISTERS (1 << KMER_SKETCH_PRECISION)
+
+#define KMER_SKETCH_SAMPLE_CAPACITY (1 << 17)
+
+typedef struct
+{
+    unsigned int kmerSize;
+    
+    unsigned char registers[KMER_SKETCH_REGISTERS];
+    
+    unsigned long long int* sampleKMers;    // Sampled k-mers (+1, 0 is empty).
+    unsigned int* sampleCounts;             // Their counts.
+    unsigned int sampleEntries;
+    unsigned int sampleBits;                // Low hash bits that must be 0.
+    
+    unsigned int replacement;               // Next replacement for an N.
+} KMerSketch;
+
+/**
+ * Creates a new, empty k-mer sketch.
+ * 
+ * @param kmerSize The length of the k-mers.
+ * @return The new sketch, or NULL if it could not be allocated.
+ */
+KMerSketch* newKMerSketch(unsigned int kmerSize);
+
+/**
+ * Adds every k-mer of the sequence text, and its reverse compliment, to the 
+ * sketch.
+ * 
+ * @param sketch The sketch to work with.
+ * @param sequence The sequence as text.
+ * @param length The length of the sequence text.
+ */
+void KMerSketchAddSequence(KMerSketch* sketch, char* sequence, unsigned int length);
+
+/**
+ * Estimates the number of distinct canonical k-mers added to the sketch.
+ * 
+ * @param sketch The sketch to work with.
+ * @return The estimated number of distinct k-mers.
+ */
+unsigned long long int KMerSketchGetDistinct(KMerSketch* sketch);
+
+/**
+ * Estimates the number of distinct canonical k-mers added to the sketch more 
+ * than once.
+ * 
+ * @param sketch The sketch to work with.
+ * @return The estimated number of repeated k-mers.
+ */
+unsigned long long int KMerSketchGetRepeated(KMerSketch* sketch);
+
+/**
+ * Estimates the number of distinct and repeated canonical k-mers of a whole 
+ * file from a sketch of its beginning. New k-mers are assumed to keep appearing 
+ * at the rate at which the sketch saw k-mers only once (the Good-Turing 
+ * estimate of unseen k-mers), and every k-mer seen once by the sketch is 
+ * assumed to be seen again.
+ * 
+ * @param sketch The sketch of the beginning of the file.
+ * @param scale The size of the file over the size of the part sketched.
+ * @param distinct Set to the estimated number of distinct k-mers.
+ * @param repeated Set to the estimated number of repeated k-mers.
+ */
+void KMerSketchExtrapolate(KMerSketch* sketch, double scale, 
+        unsigned long long int* distinct, unsigned long long int* repeated);
+
+/**
+ * Empties the sketch so that it can summarize another file.
+ * 
+ * @param sketch The sketch to reset.
+ */
+void KMerSketchReset(KMerSketch* sketch);
+
+/**
+ * Frees the sketch.
+ * 
+ * @param sketch The sketch to free.
+ */
+void freeKMerSketch(KMerSketch* sketch);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* KMERSKETCH_H */
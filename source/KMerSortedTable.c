@@ -0,0 +1,442 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "KMerSortedTable.h"
+
+// The number of interpolation steps before falling back to binary search.
+#define KMER_SORTED_INTERPOLATION_STEPS 4
+
+/* Sorts the keys with a least significant digit radix sort, one byte at a 
+ * time, using the scratch array. Passes over a byte that is the same in every 
+ * key are skipped; left-aligned k-mers have several such bytes at the bottom. 
+ * Returns whichever of the two arrays holds the sorted keys. */
+static unsigned long long int* radixSort(unsigned long long int* keys, 
+        unsigned long long int* scratch, unsigned long long int length)
+{
+    unsigned long long int counts[256];
+    unsigned long long int* swap;
+    unsigned long long int sum;
+    unsigned long long int next;
+    unsigned int digit;
+    
+    for(unsigned int shift = 0; shift < 64; shift += 8)
+    {
+        memset(counts, 0, sizeof(counts));
+        
+        for(unsigned long long int i = 0; i < length; i++)
+        {
+            counts[(keys[i] >> shift) & 0xFF]++;
+        }
+        
+        // Every key has the same digit:
+        if(length == 0 || counts[(keys[0] >> shift) & 0xFF] == length)
+        {
+            continue;
+        }
+        
+        // Starting positions:
+        sum = 0;
+        
+        for(digit = 0; digit < 256; digit++)
+        {
+            next = sum + counts[digit];
+            counts[digit] = sum;
+            sum = next;
+        }
+        
+        for(unsigned long long int i = 0; i < length; i++)
+        {
+            scratch[counts[(keys[i] >> shift) & 0xFF]++] = keys[i];
+        }
+        
+        swap = keys;
+        keys = scratch;
+        scratch = swap;
+    }
+    
+    return keys;
+}
+
+KMerSortedTable* newKMerSortedTable()
+{
+    KMerSortedTable* table;
+    
+    if((table = malloc(sizeof *table)) != NULL)
+    {
+        table->pending = NULL;
+        table->pendingSize = 0;
+        
+        table->runs = NULL;
+        table->numRuns = 0;
+        table->runsCapacity = 0;
+        pthread_mutex_init(&(table->lock), NULL);
+        
+        table->frozen.kmers = NULL;
+        table->frozen.counts = NULL;
+        table->frozen.length = 0;
+        
+        table->directory = (unsigned long long int*)calloc(
+                KMER_SORTED_DIRECTORY_SIZE + 1, sizeof(unsigned long long int));
+        
+        if(table->directory == NULL)
+        {
+            free(table);
+            return NULL;
+        }
+    }
+    
+    return table;
+}
+
+void KMerSortedTableAdd(KMerSortedTable* table, unsigned long long int* kmers, 
+        unsigned long long int numKMers)
+{
+    if(table->pending == NULL)
+    {
+        table->pending = (unsigned long long int*)malloc(
+                KMER_SORTED_BATCH_SIZE * sizeof(unsigned long long int));
+        
+        if(table->pending == NULL)
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+            exit(1);
+        }
+    }
+    
+    for(unsigned long long int i = 0; i < numKMers; i++)
+    {
+        table->pending[table->pendingSize++] = kmers[i];
+        
+        if(table->pendingSize == KMER_SORTED_BATCH_SIZE)
+        {
+            KMerSortedTableAddRun(table, table->pending, table->pendingSize);
+            table->pendingSize = 0;
+        }
+    }
+}
+
+void KMerSortedTableAddRun(KMerSortedTable* table, unsigned long long int* kmers, 
+        unsigned long long int numKMers)
+{
+    unsigned long long int* scratch;
+    unsigned long long int* sorted;
+    unsigned long long int distinct = 0;
+    KMerRun run;
+    
+    if(numKMers == 0)
+    {
+        return;
+    }
+    
+    if((scratch = (unsigned long long int*)malloc(numKMers * sizeof(unsigned long long int))) == NULL)
+    {
+        printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+        exit(1);
+    }
+    
+    sorted = radixSort(kmers, scratch, numKMers);
+    
+    for(unsigned long long int i = 0; i < numKMers; i++)
+    {
+        distinct += (i == 0 || sorted[i] != sorted[i - 1]);
+    }
+    
+    run.kmers = (unsigned long long int*)malloc(distinct * sizeof(unsigned long long int));
+    run.counts = (unsigned int*)malloc(distinct * sizeof(unsigned int));
+    run.length = 0;
+    
+    if(run.kmers == NULL || run.counts == NULL)
+    {
+        printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+        exit(1);
+    }
+    
+    // Run-length encode:
+    for(unsigned long long int i = 0; i < numKMers; i++)
+    {
+        if(i > 0 && sorted[i] == sorted[i - 1])
+        {
+            run.counts[run.length - 1]++;
+            continue;
+        }
+        
+        run.kmers[run.length] = sorted[i];
+        run.counts[run.length] = 1;
+        run.length++;
+    }
+    
+    free(scratch);
+    
+    pthread_mutex_lock(&(table->lock));
+    
+    if(table->numRuns == table->runsCapacity)
+    {
+        table->runsCapacity = table->runsCapacity > 0 ? table->runsCapacity * 2 : 16;
+        table->runs = (KMerRun*)realloc(table->runs, table->runsCapacity * sizeof(KMerRun));
+        
+        if(table->runs == NULL)
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+            exit(1);
+        }
+    }
+    
+    table->runs[table->numRuns++] = run;
+    
+    pthread_mutex_unlock(&(table->lock));
+}
+
+/* Restores the heap of run positions, ordered by their current k-mer, below 
+ * the given node. */
+static void siftDown(KMerRun** sources, unsigned long long int* positions, 
+        unsigned int* heap, unsigned int size, unsigned int node)
+{
+    unsigned int child;
+    unsigned int top;
+    
+    while((child = 2 * node + 1) < size)
+    {
+        if(child + 1 < size && sources[heap[child + 1]]->kmers[positions[heap[child + 1]]] < 
+                sources[heap[child]]->kmers[positions[heap[child]]])
+        {
+            child++;
+        }
+        
+        if(sources[heap[node]]->kmers[positions[heap[node]]] <= 
+                sources[heap[child]]->kmers[positions[heap[child]]])
+        {
+            return;
+        }
+        
+        top = heap[node];
+        heap[node] = heap[child];
+        heap[child] = top;
+        node = child;
+    }
+}
+
+/* Points every directory entry at the first k-mer with that prefix or larger. */
+static void buildDirectory(KMerSortedTable* table)
+{
+    unsigned long long int position = 0;
+    
+    for(unsigned long long int prefix = 0; prefix <= KMER_SORTED_DIRECTORY_SIZE; prefix++)
+    {
+        while(position < table->frozen.length && 
+                (table->frozen.kmers[position] >> (64 - KMER_SORTED_DIRECTORY_BITS)) < prefix)
+        {
+            position++;
+        }
+        
+        table->directory[prefix] = position;
+    }
+}
+
+int KMerSortedTableMerge(KMerSortedTable* table, unsigned int minimumCount, 
+        unsigned long long int* histogram, unsigned long long int histogramMax,
+        unsigned long long int* unique, unsigned long long int* total)
+{
+    unsigned int numSources = 0;
+    unsigned long long int length = table->frozen.length;
+    
+    // The k-mers still being collected form the last run:
+    KMerSortedTableAddRun(table, table->pending, table->pendingSize);
+    table->pendingSize = 0;
+    
+    KMerRun* sources[table->numRuns + 1];
+    unsigned long long int positions[table->numRuns + 1];
+    unsigned int heap[table->numRuns + 1];
+    
+    KMerRun merged;
+    unsigned long long int kmer;
+    unsigned long long int count;
+    unsigned int source;
+    
+    // The frozen k-mers are merged like any other run:
+    if(table->frozen.length > 0)
+    {
+        sources[numSources++] = &(table->frozen);
+    }
+    
+    for(unsigned int i = 0; i < table->numRuns; i++)
+    {
+        sources[numSources++] = &(table->runs[i]);
+        length += table->runs[i].length;
+    }
+    
+    merged.kmers = (unsigned long long int*)malloc((length + 1) * sizeof(unsigned long long int));
+    merged.counts = (unsigned int*)malloc((length + 1) * sizeof(unsigned int));
+    merged.length = 0;
+    
+    if(merged.kmers == NULL || merged.counts == NULL)
+    {
+        free(merged.kmers);
+        free(merged.counts);
+        
+        return 0;
+    }
+    
+    for(unsigned int i = 0; i < numSources; i++)
+    {
+        positions[i] = 0;
+        heap[i] = i;
+    }
+    
+    for(int i = (int)numSources / 2 - 1; i >= 0; i--)
+    {
+        siftDown(sources, positions, heap, numSources, i);
+    }
+    
+    // K-way merge:
+    while(numSources > 0)
+    {
+        kmer = sources[heap[0]]->kmers[positions[heap[0]]];
+        count = 0;
+        
+        // Sum the k-mer over every run that has it:
+        while(numSources > 0 && sources[heap[0]]->kmers[positions[heap[0]]] == kmer)
+        {
+            source = heap[0];
+            count += sources[source]->counts[positions[source]];
+            positions[source]++;
+            
+            // This run is finished:
+            if(positions[source] == sources[source]->length)
+            {
+                heap[0] = heap[--numSources];
+            }
+            
+            siftDown(sources, positions, heap, numSources, 0);
+        }
+        
+        *total += 1;
+        
+        if(count <= histogramMax)
+        {
+            histogram[count]++;
+        }
+        
+        if(count < minimumCount)
+        {
+            *unique += (count == 1);
+            continue;
+        }
+        
+        merged.kmers[merged.length] = kmer;
+        merged.counts[merged.length] = (unsigned int)count;
+        merged.length++;
+    }
+    
+    // Release the merged runs:
+    for(unsigned int i = 0; i < table->numRuns; i++)
+    {
+        free(table->runs[i].kmers);
+        free(table->runs[i].counts);
+    }
+    
+    table->numRuns = 0;
+    
+    free(table->frozen.kmers);
+    free(table->frozen.counts);
+    
+    // Give back what the removed k-mers would have used:
+    table->frozen.kmers = (unsigned long long int*)realloc(merged.kmers, 
+            (merged.length + 1) * sizeof(unsigned long long int));
+    table->frozen.counts = (unsigned int*)realloc(merged.counts, 
+            (merged.length + 1) * sizeof(unsigned int));
+    table->frozen.length = merged.length;
+    
+    buildDirectory(table);
+    
+    return 1;
+}
+
+unsigned long long int KMerSortedTableLookup(KMerSortedTable* table, unsigned long long int kmer)
+{
+    unsigned long long int* kmers = table->frozen.kmers;
+    unsigned long long int prefix = kmer >> (64 - KMER_SORTED_DIRECTORY_BITS);
+    unsigned long long int low = table->directory[prefix];
+    unsigned long long int high = table->directory[prefix + 1];
+        // The k-mer can only be within [low, high).
+    unsigned long long int middle;
+    
+    // Interpolation search, while k-mers are spread evenly:
+    for(int step = 0; step < KMER_SORTED_INTERPOLATION_STEPS && low < high; step++)
+    {
+        if(kmer < kmers[low] || kmer > kmers[high - 1])
+        {
+            return 0;
+        }
+        
+        middle = low + (unsigned long long int)((double)(kmer - kmers[low]) / 
+                ((double)(kmers[high - 1] - kmers[low]) + 1.0) * (high - low));
+        
+        if(kmers[middle] == kmer)
+        {
+            return table->frozen.counts[middle];
+        }
+        else if(kmers[middle] < kmer)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    
+    // Binary search:
+    while(low < high)
+    {
+        middle = low + (high - low) / 2;
+        
+        if(kmers[middle] == kmer)
+        {
+            return table->frozen.counts[middle];
+        }
+        else if(kmers[middle] < kmer)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    
+    return 0;
+}
+
+unsigned long long int KMerSortedTableGetMemory(KMerSortedTable* table)
+{
+    unsigned long long int entries = table->frozen.length;
+    
+    for(unsigned int i = 0; i < table->numRuns; i++)
+    {
+        entries += table->runs[i].length;
+    }
+    
+    return entries * (sizeof(unsigned long long int) + sizeof(unsigned int)) + 
+            (KMER_SORTED_DIRECTORY_SIZE + 1) * sizeof(unsigned long long int) + 
+            (table->pending != NULL ? KMER_SORTED_BATCH_SIZE * sizeof(unsigned long long int) : 0);
+}
@@ -0,0 +1,139 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <pthread.h>
+
+#ifndef KMERSORTEDTABLE_H
+#define	KMERSORTEDTABLE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * A k-mer counting engine based on sorting rather than hashing. K-mers are 
+ * collected into plain arrays, which are radix sorted and run-length encoded 
+ * into sorted runs of (k-mer, count) pairs. When the counts are needed, every 
+ * run is merged, along with the k-mers kept from earlier files, into a single 
+ * frozen sorted array. All of these steps access memory sequentially, and the 
+ * memory needed is known from the number of k-mers collected.
+ * 
+ * Lookups into the frozen array start from a directory indexed by the first 
+ * KMER_SORTED_DIRECTORY_BITS bits of the k-mer, which narrows the search to 
+ * the k-mers sharing that prefix, followed by an interpolation search.
+ */
+#define KMER_SORTED_DIRECTORY_BITS 16
+#define KMER_SORTED_DIRECTORY_SIZE (1 << KMER_SORTED_DIRECTORY_BITS)
+
+// The number of k-mers collected before they are sorted into a run.
+#define KMER_SORTED_BATCH_SIZE (1 << 20)
+
+typedef struct
+{
+    unsigned long long int* kmers;          // Sorted, without duplicates.
+    unsigned int* counts;
+    unsigned long long int length;
+} KMerRun;
+
+typedef struct
+{
+    // Counting:
+    unsigned long long int* pending;        // K-mers not yet in a run.
+    unsigned int pendingSize;
+    
+    KMerRun* runs;
+    unsigned int numRuns;
+    unsigned int runsCapacity;
+    pthread_mutex_t lock;                   // Held while adding a run.
+    
+    // Lookups:
+    KMerRun frozen;
+    unsigned long long int* directory;      // KMER_SORTED_DIRECTORY_SIZE + 1
+} KMerSortedTable;
+
+/**
+ * Creates a new, empty sorted k-mer table.
+ * 
+ * @return The new table, or NULL if it could not be allocated.
+ */
+KMerSortedTable* newKMerSortedTable();
+
+/**
+ * Collects k-mers to be counted. This must not be used while other threads 
+ * are counting into the table.
+ * 
+ * @param table The table to work with.
+ * @param kmers The k-mers to count.
+ * @param numKMers The number of k-mers.
+ */
+void KMerSortedTableAdd(KMerSortedTable* table, unsigned long long int* kmers, 
+        unsigned long long int numKMers);
+
+/**
+ * Sorts the k-mers into a new run of the table. The array is sorted in place. 
+ * Several threads may do this at the same time.
+ * 
+ * @param table The table to work with.
+ * @param kmers The k-mers to count.
+ * @param numKMers The number of k-mers.
+ */
+void KMerSortedTableAddRun(KMerSortedTable* table, unsigned long long int* kmers, 
+        unsigned long long int numKMers);
+
+/**
+ * Merges every run into the frozen array, removing the k-mers whose total 
+ * count is below minimumCount. The counts of the merged k-mers are tallied 
+ * into the histogram, and the number of k-mers merged and removed are added to 
+ * total and unique.
+ * 
+ * @param table The table to work with.
+ * @param minimumCount The smallest count kept.
+ * @param histogram The k-mer count tallies to add to.
+ * @param histogramMax The largest count tallied.
+ * @param unique Incremented by the number of k-mers removed.
+ * @param total Incremented by the number of k-mers merged.
+ * @return Whether or not there was enough memory to merge the runs.
+ */
+int KMerSortedTableMerge(KMerSortedTable* table, unsigned int minimumCount, 
+        unsigned long long int* histogram, unsigned long long int histogramMax,
+        unsigned long long int* unique, unsigned long long int* total);
+
+/**
+ * Returns the count of the k-mer in the frozen array, or 0 if it is absent.
+ * 
+ * @param table The table to work with.
+ * @param kmer The k-mer to find.
+ * @return The count of the k-mer.
+ */
+unsigned long long int KMerSortedTableLookup(KMerSortedTable* table, unsigned long long int kmer);
+
+/**
+ * Returns the number of bytes used by the table.
+ * 
+ * @param table The table to work with.
+ * @return The size of the table in bytes.
+ */
+unsigned long long int KMerSortedTableGetMemory(KMerSortedTable* table);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* KMERSORTEDTABLE_H */
@@ -0,0 +1,89 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <string.h>
+#include "KMerStatistics.h"
+
+void clearKMerStatistics(KMerStatistics* statistics)
+{
+    memset(statistics, 0, sizeof *statistics);
+}
+
+void KMerStatisticsAdd(KMerStatistics* statistics, unsigned long long int count, 
+        unsigned long long int numKMers)
+{
+    if(count == 0 || numKMers == 0)
+    {
+        return;
+    }
+    
+    if(count <= KMER_HISTOGRAM_MAX_COUNT)
+    {
+        statistics->histogram[count] += numKMers;
+    }
+    
+    if(count > statistics->maxCount)
+    {
+        statistics->maxCount = count;
+    }
+    
+    statistics->distinct += numKMers;
+    statistics->total += count * numKMers;
+    
+    if(count > 1)
+    {
+        statistics->repeats += count * numKMers;
+    }
+}
+
+void KMerStatisticsMerge(KMerStatistics* statistics, KMerStatistics* other)
+{
+    for(int i = 0; i < KMER_HISTOGRAM_SIZE; i++)
+    {
+        statistics->histogram[i] += other->histogram[i];
+    }
+    
+    if(other->maxCount > statistics->maxCount)
+    {
+        statistics->maxCount = other->maxCount;
+    }
+    
+    statistics->distinct += other->distinct;
+    statistics->total += other->total;
+    statistics->repeats += other->repeats;
+}
+
+void KMerStatisticsFinish(KMerStatistics* statistics)
+{
+    statistics->valley = findKMerValley(statistics->histogram);
+}
+
+unsigned int findKMerValley(unsigned long long int* histogram)
+{
+    unsigned int currentKMerCount = 1;
+        
+    // Loop until we find a low-to-high number transitions:
+    while (currentKMerCount <= KMER_HISTOGRAM_MAX_COUNT && histogram[currentKMerCount] > histogram[currentKMerCount + 1])
+    {
+        currentKMerCount++;
+    }
+    
+    return currentKMerCount;
+}
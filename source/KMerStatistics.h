@@ -0,0 +1,102 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Utility.h"
+
+#ifndef KMERSTATISTICS_H
+#define	KMERSTATISTICS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * A summary of the counts of the k-mers in a table: the k-mer spectrum. Every 
+ * statistic is gathered in the same pass over the k-mers, so the table is only 
+ * walked once however many of them are needed (see KMerTableGetStatistics). 
+ * Several threads may each summarize part of a table into their own statistics 
+ * and merge them afterwards.
+ */
+
+// K-mer counts above this are not tallied when finding the low k-mer threshold.
+#define KMER_HISTOGRAM_MAX_COUNT (1024 + 1)
+#define KMER_HISTOGRAM_SIZE (KMER_HISTOGRAM_MAX_COUNT + 2)
+
+typedef struct
+{
+    // The number of k-mers with each count, up to KMER_HISTOGRAM_MAX_COUNT:
+    unsigned long long int histogram[KMER_HISTOGRAM_SIZE];
+    
+    unsigned long long int maxCount;        // The highest count.
+    unsigned long long int distinct;        // The number of k-mers.
+    unsigned long long int total;           // The sum of their counts.
+    unsigned long long int repeats;         // The sum of the counts above 1.
+    unsigned int valley;                    // See findKMerValley.
+} KMerStatistics;
+
+/**
+ * Empties the statistics, as for a table with no k-mers.
+ * 
+ * @param statistics The statistics to clear.
+ */
+void clearKMerStatistics(KMerStatistics* statistics);
+
+/**
+ * Adds a number of k-mers that share the same count to the statistics.
+ * 
+ * @param statistics The statistics to update.
+ * @param count The count of the k-mers.
+ * @param numKMers The number of k-mers with that count.
+ */
+void KMerStatisticsAdd(KMerStatistics* statistics, unsigned long long int count, 
+        unsigned long long int numKMers);
+
+/**
+ * Adds the k-mers summarized by other statistics, such as those of another 
+ * part of the table. The valley must be found again with KMerStatisticsFinish.
+ * 
+ * @param statistics The statistics to update.
+ * @param other The statistics to add.
+ */
+void KMerStatisticsMerge(KMerStatistics* statistics, KMerStatistics* other);
+
+/**
+ * Finds the valley of the statistics, once every k-mer has been added.
+ * 
+ * @param statistics The statistics to finish.
+ */
+void KMerStatisticsFinish(KMerStatistics* statistics);
+
+/**
+ * Finds the first count, starting from 1, at which the number of k-mers stops 
+ * falling. Counts below it are mostly k-mers with sequencing errors. When the 
+ * number of k-mers keeps falling through KMER_HISTOGRAM_MAX_COUNT, no valley 
+ * was observed and the result is at least KMER_HISTOGRAM_MAX_COUNT.
+ * 
+ * @param histogram The KMER_HISTOGRAM_SIZE k-mer count tallies.
+ * @return The count at the bottom of the valley.
+ */
+unsigned int findKMerValley(unsigned long long int* histogram);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* KMERSTATISTICS_H */
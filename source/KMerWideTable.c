@@ -0,0 +1,338 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "KMerWideTable.h"
+#include "Memory.h"
+
+// The smallest number of slots a shard will have.
+#define KMER_WIDE_MINIMUM_CAPACITY 64ULL
+
+// The number of k-mers whose slots are prefetched together by lookups.
+#define KMER_WIDE_LOOKUP_GROUP 16
+
+/* Mixes both words of the k-mer into a 64-bit hash. */
+static inline unsigned long long int hashKMerWide(KMerWideTable* table, KMerWide kmer)
+{
+    return hashKMerWith(table->hashFunction, 
+            (unsigned long long int)(kmer >> 64) ^ hashKMerMurmur((unsigned long long int)kmer));
+}
+
+static inline KMerWideTableShard* getShard(KMerWideTable* table, unsigned long long int hash)
+{
+    return &(table->shards[hash >> (64 - KMER_WIDE_SHARD_BITS)]);
+}
+
+/* Returns the slot containing the k-mer, or the empty slot where it would be 
+ * inserted. The shard must contain at least one empty slot. */
+static inline unsigned long long int findSlot(KMerWideTableShard* shard, 
+        KMerWide kmer, unsigned long long int hash)
+{
+    unsigned long long int mask = shard->capacity - 1;
+    unsigned long long int slot = hash & mask;
+    
+    while(shard->kmers[slot] != kmer && shard->kmers[slot] != KMER_WIDE_EMPTY)
+    {
+        slot = (slot + 1) & mask;
+    }
+    
+    return slot;
+}
+
+/* Moves every k-mer with a count of at least minimumCount into a new set of 
+ * arrays with the given capacity. The old arrays are released. */
+static int rebuildShard(KMerWideTable* table, KMerWideTableShard* shard, 
+        unsigned long long int capacity, unsigned int minimumCount)
+{
+    KMerWide* kmers = (KMerWide*)allocateMemory(capacity * sizeof(KMerWide));
+    unsigned int* counts = (unsigned int*)allocateMemory(capacity * sizeof(unsigned int));
+    
+    KMerWide* oldKMers = shard->kmers;
+    unsigned int* oldCounts = shard->counts;
+    unsigned long long int oldCapacity = shard->capacity;
+    unsigned long long int slot;
+    
+    if(kmers == NULL || counts == NULL)
+    {
+        freeMemory(kmers, capacity * sizeof(KMerWide));
+        freeMemory(counts, capacity * sizeof(unsigned int));
+        
+        return 0;
+    }
+    
+    for(unsigned long long int i = 0; i < capacity; i++)
+    {
+        kmers[i] = KMER_WIDE_EMPTY;
+    }
+    
+    shard->kmers = kmers;
+    shard->counts = counts;
+    shard->capacity = capacity;
+    shard->entries = 0;
+    
+    for(unsigned long long int i = 0; i < oldCapacity; i++)
+    {
+        if(oldKMers[i] != KMER_WIDE_EMPTY && oldCounts[i] >= minimumCount)
+        {
+            slot = findSlot(shard, oldKMers[i], hashKMerWide(table, oldKMers[i]));
+            
+            shard->kmers[slot] = oldKMers[i];
+            shard->counts[slot] = oldCounts[i];
+            shard->entries++;
+        }
+    }
+    
+    freeMemory(oldKMers, oldCapacity * sizeof(KMerWide));
+    freeMemory(oldCounts, oldCapacity * sizeof(unsigned int));
+    
+    return 1;
+}
+
+KMerWideTable* newKMerWideTable(unsigned int kmerSize, enum KMER_HASH_FUNCTION function)
+{
+    KMerWideTable* table;
+    
+    if((table = calloc(1, sizeof *table)) == NULL)
+    {
+        return NULL;
+    }
+    
+    table->kmerSize = kmerSize;
+    table->hashFunction = function;
+    
+    for(int i = 0; i < KMER_WIDE_NUM_SHARDS; i++)
+    {
+        if(!rebuildShard(table, &(table->shards[i]), KMER_WIDE_MINIMUM_CAPACITY, 1))
+        {
+            freeKMerWideTable(table);
+            return NULL;
+        }
+        
+        pthread_mutex_init(&(table->shards[i].lock), NULL);
+    }
+    
+    return table;
+}
+
+void KMerWideTableAddSequence(KMerWideTable* table, unsigned long long int* sequence,
+        unsigned int length)
+{
+    int total = (int)length - (int)table->kmerSize + 1;
+    
+    KMerWideTableShard* shard;
+    unsigned long long int hash;
+    unsigned long long int slot;
+    unsigned int amount;
+    
+    if(total <= 0)
+    {
+        return;
+    }
+    
+    KMerWide kmers[total];
+    getCanonicalKMersWide(sequence, length, table->kmerSize, kmers);
+    
+    for(int i = 0; i < total; i++)
+    {
+        hash = hashKMerWide(table, kmers[i]);
+        shard = getShard(table, hash);
+        
+        // Palindromes are their own reverse compliment:
+        amount = 1;
+        
+        if(table->kmerSize % 2 == 0 && getReverseComplimentKMerWide(kmers[i], table->kmerSize) == kmers[i])
+        {
+            amount = 2;
+        }
+        
+        pthread_mutex_lock(&(shard->lock));
+        
+        slot = findSlot(shard, kmers[i], hash);
+        
+        if(shard->kmers[slot] == KMER_WIDE_EMPTY)
+        {
+            // Grow when more than 7/10 full:
+            if((shard->entries + 1) * 10 > shard->capacity * 7)
+            {
+                if(!rebuildShard(table, shard, shard->capacity * 2, 1))
+                {
+                    printf("CRITICAL: FAILED TO ALLOCATE HASH TABLE!\n");
+                    exit(1);
+                }
+                
+                slot = findSlot(shard, kmers[i], hash);
+            }
+            
+            shard->kmers[slot] = kmers[i];
+            shard->entries++;
+        }
+        
+        shard->counts[slot] += amount;
+        
+        pthread_mutex_unlock(&(shard->lock));
+    }
+}
+
+void KMerWideTableLookupSequence(KMerWideTable* table, unsigned long long int* sequence,
+        unsigned int length, unsigned int* counts)
+{
+    int total = (int)length - (int)table->kmerSize + 1;
+    
+    KMerWideTableShard* shards[KMER_WIDE_LOOKUP_GROUP];
+    unsigned long long int hashes[KMER_WIDE_LOOKUP_GROUP];
+    unsigned long long int slot;
+    int size;
+    
+    if(total <= 0)
+    {
+        return;
+    }
+    
+    KMerWide kmers[total];
+    getCanonicalKMersWide(sequence, length, table->kmerSize, kmers);
+    
+    for(int start = 0; start < total; start += KMER_WIDE_LOOKUP_GROUP)
+    {
+        size = total - start < KMER_WIDE_LOOKUP_GROUP ? total - start : KMER_WIDE_LOOKUP_GROUP;
+        
+        // Start loading the first slot of every k-mer:
+        for(int i = 0; i < size; i++)
+        {
+            hashes[i] = hashKMerWide(table, kmers[start + i]);
+            shards[i] = getShard(table, hashes[i]);
+            
+            __builtin_prefetch(&(shards[i]->kmers[hashes[i] & (shards[i]->capacity - 1)]));
+        }
+        
+        for(int i = 0; i < size; i++)
+        {
+            slot = findSlot(shards[i], kmers[start + i], hashes[i]);
+            
+            counts[start + i] = (shards[i]->kmers[slot] == KMER_WIDE_EMPTY) ? 1 : shards[i]->counts[slot];
+        }
+    }
+}
+
+int KMerWideTablePrune(KMerWideTable* table, unsigned int minimumCount, 
+        unsigned long long int* histogram, unsigned long long int histogramMax,
+        unsigned long long int* unique, unsigned long long int* total)
+{
+    KMerWideTableShard* shard;
+    unsigned long long int kept;
+    unsigned long long int capacity;
+    
+    for(int i = 0; i < KMER_WIDE_NUM_SHARDS; i++)
+    {
+        shard = &(table->shards[i]);
+        kept = 0;
+        
+        for(unsigned long long int j = 0; j < shard->capacity; j++)
+        {
+            if(shard->kmers[j] == KMER_WIDE_EMPTY)
+            {
+                continue;
+            }
+            
+            if(shard->counts[j] <= histogramMax)
+            {
+                histogram[shard->counts[j]]++;
+            }
+            
+            if(shard->counts[j] >= minimumCount)
+            {
+                kept++;
+            }
+        }
+        
+        *total += shard->entries;
+        *unique += shard->entries - kept;
+        
+        // Leave the shard no more than half full:
+        capacity = KMER_WIDE_MINIMUM_CAPACITY;
+        
+        while(capacity < kept * 2)
+        {
+            capacity *= 2;
+        }
+        
+        if(!rebuildShard(table, shard, capacity, minimumCount))
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+void KMerWideTableGatherStatistics(KMerWideTable* table, unsigned int firstShard, 
+        unsigned int lastShard, KMerStatistics* statistics)
+{
+    KMerWideTableShard* shard;
+    
+    for(unsigned int i = firstShard; i < lastShard; i++)
+    {
+        shard = &(table->shards[i]);
+        
+        for(unsigned long long int j = 0; j < shard->capacity; j++)
+        {
+            if(shard->kmers[j] != KMER_WIDE_EMPTY)
+            {
+                KMerStatisticsAdd(statistics, shard->counts[j], 1);
+            }
+        }
+    }
+}
+
+unsigned long long int KMerWideTableNumEntries(KMerWideTable* table)
+{
+    unsigned long long int entries = 0;
+    
+    for(int i = 0; i < KMER_WIDE_NUM_SHARDS; i++)
+    {
+        entries += table->shards[i].entries;
+    }
+    
+    return entries;
+}
+
+unsigned long long int KMerWideTableGetMemory(KMerWideTable* table)
+{
+    unsigned long long int capacity = 0;
+    
+    for(int i = 0; i < KMER_WIDE_NUM_SHARDS; i++)
+    {
+        capacity += table->shards[i].capacity;
+    }
+    
+    return sizeof(KMerWideTable) + capacity * (sizeof(KMerWide) + sizeof(unsigned int));
+}
+
+void freeKMerWideTable(KMerWideTable* table)
+{
+    for(int i = 0; i < KMER_WIDE_NUM_SHARDS; i++)
+    {
+        freeMemory(table->shards[i].kmers, table->shards[i].capacity * sizeof(KMerWide));
+        freeMemory(table->shards[i].counts, table->shards[i].capacity * sizeof(unsigned int));
+        pthread_mutex_destroy(&(table->shards[i].lock));
+    }
+    
+    free(table);
+}
@@ -0,0 +1,159 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <pthread.h>
+#include "Utility.h"
+#include "KMerHash.h"
+#include "KMerStatistics.h"
+
+#ifndef KMERWIDETABLE_H
+#define	KMERWIDETABLE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * A k-mer table for k-mers longer than KMER_NARROW_MAX_SIZE, which do not fit 
+ * in the 64-bit keys of the k-mer table. It is used by the k-mer table itself 
+ * when it is created for such k-mers (see newKMerTable), and is kept apart so 
+ * that shorter k-mers never pay for the wider keys.
+ * 
+ * Like the k-mer table, it is a sharded, open-addressing (linear probing) hash 
+ * table of canonical k-mers, with keys and counts in parallel arrays. Counts 
+ * are plain 32-bit integers. Several threads may count into the table at once: 
+ * each shard has a mutex held while a k-mer is added to it.
+ * 
+ * An empty slot is marked with KMER_WIDE_EMPTY, which can never be produced by 
+ * getKMerWide for k-mers of at most KMER_MAX_SIZE bases.
+ */
+#define KMER_WIDE_EMPTY (~(KMerWide)0)
+
+#define KMER_WIDE_SHARD_BITS 8
+#define KMER_WIDE_NUM_SHARDS (1 << KMER_WIDE_SHARD_BITS)
+
+typedef struct
+{
+    KMerWide* kmers;                        // Packed k-mer keys.
+    unsigned int* counts;                   // Counts, indexed by slot.
+    
+    unsigned long long int capacity;        // Number of slots (power of two).
+    unsigned long long int entries;         // Number of occupied slots.
+    
+    pthread_mutex_t lock;                   // Held while adding to the shard.
+} KMerWideTableShard;
+
+typedef struct
+{
+    KMerWideTableShard shards[KMER_WIDE_NUM_SHARDS];
+    
+    unsigned int kmerSize;                  // The length of the k-mers.
+    enum KMER_HASH_FUNCTION hashFunction;
+} KMerWideTable;
+
+/**
+ * Creates a new, empty wide k-mer table.
+ * 
+ * @param kmerSize The length of the k-mers the table will hold (<= KMER_MAX_SIZE).
+ * @param function The hash function used to place the k-mers.
+ * @return The new table, or NULL if it could not be allocated.
+ */
+KMerWideTable* newKMerWideTable(unsigned int kmerSize, enum KMER_HASH_FUNCTION function);
+
+/**
+ * Counts every k-mer of the sequence. Palindromic k-mers are counted twice, 
+ * as in the k-mer table. Several threads may do this at the same time.
+ * 
+ * @param table The table to work with.
+ * @param sequence The sequence to count.
+ * @param length The length of the sequence in nucleotide bases.
+ */
+void KMerWideTableAddSequence(KMerWideTable* table, unsigned long long int* sequence,
+        unsigned int length);
+
+/**
+ * Fills the counts of every k-mer of the sequence, in order. K-mers that are 
+ * not in the table have a count of 1, as in the k-mer table.
+ * 
+ * @param table The table to work with.
+ * @param sequence The sequence to look up.
+ * @param length The length of the sequence in nucleotide bases.
+ * @param counts The counts to fill: (length - kmerSize + 1) entries.
+ */
+void KMerWideTableLookupSequence(KMerWideTable* table, unsigned long long int* sequence,
+        unsigned int length, unsigned int* counts);
+
+/**
+ * Removes the k-mers whose count is below minimumCount. The counts of every 
+ * k-mer are tallied into the histogram, and the number of k-mers examined and 
+ * removed are added to total and unique.
+ * 
+ * @param table The table to work with.
+ * @param minimumCount The smallest count kept.
+ * @param histogram The k-mer count tallies to add to.
+ * @param histogramMax The largest count tallied.
+ * @param unique Incremented by the number of k-mers removed.
+ * @param total Incremented by the number of k-mers examined.
+ * @return Whether or not there was enough memory to shrink the table.
+ */
+int KMerWideTablePrune(KMerWideTable* table, unsigned int minimumCount, 
+        unsigned long long int* histogram, unsigned long long int histogramMax,
+        unsigned long long int* unique, unsigned long long int* total);
+
+/**
+ * Adds the counts of the k-mers in a range of shards to the statistics.
+ * 
+ * @param table The table to work with.
+ * @param firstShard The first shard to summarize.
+ * @param lastShard One past the last shard to summarize.
+ * @param statistics The statistics to add to.
+ */
+void KMerWideTableGatherStatistics(KMerWideTable* table, unsigned int firstShard, 
+        unsigned int lastShard, KMerStatistics* statistics);
+
+/**
+ * Returns the number of k-mers in the table.
+ * 
+ * @param table The table to work with.
+ * @return The number of k-mers.
+ */
+unsigned long long int KMerWideTableNumEntries(KMerWideTable* table);
+
+/**
+ * Returns the number of bytes used by the table.
+ * 
+ * @param table The table to work with.
+ * @return The size of the table in bytes.
+ */
+unsigned long long int KMerWideTableGetMemory(KMerWideTable* table);
+
+/**
+ * Releases the table.
+ * 
+ * @param table The table to release.
+ */
+void freeKMerWideTable(KMerWideTable* table);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* KMERWIDETABLE_H */
+
@@ -0,0 +1,155 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "Memory.h"
+
+static unsigned long long int limit = 0;
+static unsigned long long int used = 0;
+static unsigned long long int peak = 0;
+static enum HUGE_PAGE_MODE hugePages = HUGE_PAGES_TRANSPARENT;
+
+void setMemoryLimit(unsigned long long int bytes)
+{
+    limit = bytes;
+}
+
+void setHugePageMode(enum HUGE_PAGE_MODE mode)
+{
+    hugePages = mode;
+}
+
+unsigned long long int getAllocationSize(unsigned long long int size)
+{
+    if(size >= MEMORY_HUGE_PAGE_SIZE)
+    {
+        return (size + MEMORY_HUGE_PAGE_SIZE - 1) / MEMORY_HUGE_PAGE_SIZE * MEMORY_HUGE_PAGE_SIZE;
+    }
+    
+    return size;
+}
+
+/* Maps a large allocation of a whole number of huge pages, whatever the mode, 
+ * so that freeMemory can unmap it. */
+static void* mapMemory(unsigned long long int size)
+{
+    void* memory = MAP_FAILED;
+    
+#ifdef MAP_HUGETLB
+    if(hugePages == HUGE_PAGES_EXPLICIT)
+    {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, 
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            // Fails when not enough huge pages are reserved.
+    }
+#endif
+    
+    if(memory == MAP_FAILED)
+    {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        
+#ifdef MADV_HUGEPAGE
+        if(memory != MAP_FAILED && hugePages != HUGE_PAGES_OFF)
+        {
+            madvise(memory, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    
+    return (memory == MAP_FAILED) ? NULL : memory;
+}
+
+void* allocateMemory(unsigned long long int size)
+{
+    unsigned long long int total;
+    unsigned long long int highest;
+    void* memory;
+    
+    size = getAllocationSize(size);
+    total = __sync_add_and_fetch(&used, size);
+    
+    if(limit > 0 && total > limit)
+    {
+        __sync_sub_and_fetch(&used, size);
+        
+        printf("ERROR: Allocating %llu bytes would exceed the memory limit of %llu bytes (%llu in use).\n",
+                size, limit, total - size);
+        
+        return NULL;
+    }
+    
+    if(size >= MEMORY_HUGE_PAGE_SIZE)
+    {
+        memory = mapMemory(size);
+    }
+    else
+    {
+        memory = calloc(1, size);
+    }
+    
+    if(memory == NULL)
+    {
+        __sync_sub_and_fetch(&used, size);
+        return NULL;
+    }
+    
+    // Raise the peak, unless another thread raised it further:
+    highest = __sync_fetch_and_add(&peak, 0);
+    
+    while(highest < total && !__sync_bool_compare_and_swap(&peak, highest, total))
+    {
+        highest = __sync_fetch_and_add(&peak, 0);
+    }
+    
+    return memory;
+}
+
+void freeMemory(void* memory, unsigned long long int size)
+{
+    if(memory == NULL)
+    {
+        return;
+    }
+    
+    size = getAllocationSize(size);
+    
+    if(size >= MEMORY_HUGE_PAGE_SIZE)
+    {
+        munmap(memory, size);
+    }
+    else
+    {
+        free(memory);
+    }
+    
+    __sync_sub_and_fetch(&used, size);
+}
+
+unsigned long long int getMemoryUsed()
+{
+    return __sync_fetch_and_add(&used, 0);
+}
+
+unsigned long long int getMemoryPeak()
+{
+    return __sync_fetch_and_add(&peak, 0);
+}
@@ -0,0 +1,110 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef MEMORY_H
+#define	MEMORY_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * The allocator for the large arrays of the program: the k-mer tables and the 
+ * read batches. Every allocation is counted against an optional memory limit, 
+ * so that exceeding it fails at the allocation with a clear message instead 
+ * of later, when the machine runs out of memory.
+ * 
+ * Allocations of at least MEMORY_HUGE_PAGE_SIZE are mapped directly and, 
+ * depending on the huge page mode, backed by huge pages. Random lookups into 
+ * a large k-mer table otherwise miss the TLB on nearly every access. Smaller 
+ * allocations come from the heap.
+ */
+#define MEMORY_HUGE_PAGE_SIZE (2ULL * 1024 * 1024)
+
+enum HUGE_PAGE_MODE
+{
+    HUGE_PAGES_OFF,                         // Normal pages only.
+    HUGE_PAGES_TRANSPARENT,                 // Ask for transparent huge pages.
+    HUGE_PAGES_EXPLICIT,                    // Use reserved huge pages when available.
+};
+
+/**
+ * Sets the number of bytes that may be allocated at once.
+ * 
+ * @param limit The limit in bytes, or 0 for no limit.
+ */
+void setMemoryLimit(unsigned long long int limit);
+
+/**
+ * Sets how large allocations are backed by huge pages. The default is 
+ * HUGE_PAGES_TRANSPARENT. This only affects later allocations.
+ * 
+ * @param mode The huge page mode.
+ */
+void setHugePageMode(enum HUGE_PAGE_MODE mode);
+
+/**
+ * Returns the memory an allocation of the given size takes, which is what it 
+ * counts against the memory limit: large allocations are mapped as a whole 
+ * number of huge pages.
+ * 
+ * @param size The number of bytes to allocate.
+ * @return The number of bytes the allocation takes.
+ */
+unsigned long long int getAllocationSize(unsigned long long int size);
+
+/**
+ * Allocates zeroed memory. If the allocation would exceed the memory limit, 
+ * a message saying so is printed and nothing is allocated. This may be called 
+ * by several threads at once.
+ * 
+ * @param size The number of bytes to allocate.
+ * @return The memory, or NULL if it could not be allocated.
+ */
+void* allocateMemory(unsigned long long int size);
+
+/**
+ * Releases memory returned by allocateMemory.
+ * 
+ * @param memory The memory to release, or NULL.
+ * @param size The size it was allocated with.
+ */
+void freeMemory(void* memory, unsigned long long int size);
+
+/**
+ * Returns the number of bytes currently allocated by allocateMemory.
+ * 
+ * @return The number of bytes in use.
+ */
+unsigned long long int getMemoryUsed();
+
+/**
+ * Returns the largest number of bytes that were allocated at once.
+ * 
+ * @return The peak number of bytes in use.
+ */
+unsigned long long int getMemoryPeak();
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* MEMORY_H */
+
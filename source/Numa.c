@@ -0,0 +1,242 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "Numa.h"
+
+// Memory policies and flags of the mbind system call:
+#define NUMA_MPOL_BIND 2
+#define NUMA_MPOL_INTERLEAVE 3
+#define NUMA_MPOL_MF_MOVE (1 << 1)
+
+// Pages examined to find where memory is placed:
+#define NUMA_SAMPLE_PAGES 1024
+
+#define NUMA_NODE_PATH "/sys/devices/system/node"
+
+static unsigned int numNodes = 1;
+static int nodeIDs[NUMA_MAX_NODES] = {0};       // System node numbers.
+static cpu_set_t nodeCPUs[NUMA_MAX_NODES];
+static pthread_once_t topologyOnce = PTHREAD_ONCE_INIT;
+
+/* Reads a list such as "0-3,8,10-11" into the set, stopping after the limit. 
+ * Returns the number of values read. */
+static unsigned int parseList(char* text, int* values, unsigned int limit)
+{
+    unsigned int count = 0;
+    char* next = text;
+    long int first;
+    long int last;
+    
+    while(*next != '\0' && *next != '\n' && count < limit)
+    {
+        first = strtol(next, &next, 10);
+        last = first;
+        
+        if(*next == '-')
+        {
+            last = strtol(next + 1, &next, 10);
+        }
+        
+        for(long int value = first; value <= last && count < limit; value++)
+        {
+            values[count++] = (int)value;
+        }
+        
+        if(*next == ',')
+        {
+            next++;
+        }
+        else if(*next != '\0' && *next != '\n')
+        {
+            break;
+        }
+    }
+    
+    return count;
+}
+
+/* Reads the first line of the file, returning whether or not there was one. */
+static int readLine(char* fileName, char* line, int size)
+{
+    FILE* file = fopen(fileName, "r");
+    int found;
+    
+    if(file == NULL)
+    {
+        return 0;
+    }
+    
+    found = (fgets(line, size, file) != NULL);
+    fclose(file);
+    
+    return found;
+}
+
+static void findTopology()
+{
+    static char line[65536];
+    static int cpus[CPU_SETSIZE];
+    char fileName[256];
+    int ids[NUMA_MAX_NODES];
+    unsigned int found;
+    unsigned int numCPUs;
+    
+    if(!readLine(NUMA_NODE_PATH "/online", line, sizeof(line)) ||
+            (found = parseList(line, ids, NUMA_MAX_NODES)) == 0)
+    {
+        return;
+    }
+    
+    numNodes = 0;
+    
+    // Nodes without CPUs (memory only) cannot run threads, and node numbers
+    // past the mask of placeMemory are not used:
+    for(unsigned int i = 0; i < found; i++)
+    {
+        sprintf(fileName, NUMA_NODE_PATH "/node%d/cpulist", ids[i]);
+        
+        if(ids[i] < 0 || ids[i] >= NUMA_MAX_NODES || !readLine(fileName, line, sizeof(line)) ||
+                (numCPUs = parseList(line, cpus, CPU_SETSIZE)) == 0)
+        {
+            continue;
+        }
+        
+        CPU_ZERO(&nodeCPUs[numNodes]);
+        
+        for(unsigned int j = 0; j < numCPUs; j++)
+        {
+            if(cpus[j] >= 0 && cpus[j] < CPU_SETSIZE)
+            {
+                CPU_SET(cpus[j], &nodeCPUs[numNodes]);
+            }
+        }
+        
+        nodeIDs[numNodes++] = ids[i];
+    }
+    
+    // Without any usable node, act as a single node:
+    if(numNodes == 0)
+    {
+        numNodes = 1;
+        nodeIDs[0] = 0;
+        CPU_ZERO(&nodeCPUs[0]);
+    }
+}
+
+unsigned int getNumNodes()
+{
+    pthread_once(&topologyOnce, findTopology);
+    
+    return numNodes;
+}
+
+int pinThreadToNode(unsigned int node)
+{
+    if(node >= getNumNodes() || CPU_COUNT(&nodeCPUs[node]) == 0)
+    {
+        return 0;
+    }
+    
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &nodeCPUs[node]) == 0;
+}
+
+int placeMemory(void* memory, unsigned long long int size, int node)
+{
+    unsigned long long int pageSize = (unsigned long long int)sysconf(_SC_PAGESIZE);
+    unsigned long long int first = ((unsigned long long int)memory + pageSize - 1) / pageSize * pageSize;
+    unsigned long long int last = ((unsigned long long int)memory + size) / pageSize * pageSize;
+    unsigned long int mask = 0;
+    int mode = NUMA_MPOL_BIND;
+    
+    if(memory == NULL || node >= (int)getNumNodes())
+    {
+        return 0;
+    }
+    
+    // Not a single whole page:
+    if(last <= first)
+    {
+        return 1;
+    }
+    
+    if(node == NUMA_INTERLEAVE)
+    {
+        mode = NUMA_MPOL_INTERLEAVE;
+        
+        for(unsigned int i = 0; i < numNodes; i++)
+        {
+            mask |= 1UL << nodeIDs[i];
+        }
+    }
+    else
+    {
+        mask = 1UL << nodeIDs[node];
+    }
+    
+    // The kernel reads one bit fewer than the number of nodes given:
+    return syscall(SYS_mbind, (void*)first, last - first, mode, &mask, 
+            sizeof(mask) * 8 + 1, NUMA_MPOL_MF_MOVE) == 0;
+}
+
+double getLocalFraction(void* memory, unsigned long long int size, unsigned int node)
+{
+    void* pages[NUMA_SAMPLE_PAGES];
+    int status[NUMA_SAMPLE_PAGES];
+    unsigned long long int pageSize = (unsigned long long int)sysconf(_SC_PAGESIZE);
+    unsigned long long int numPages = (size + pageSize - 1) / pageSize;
+    unsigned int numSamples = numPages < NUMA_SAMPLE_PAGES ? (unsigned int)numPages : NUMA_SAMPLE_PAGES;
+    unsigned int known = 0;
+    unsigned int local = 0;
+    
+    if(memory == NULL || numSamples == 0 || node >= getNumNodes())
+    {
+        return -1;
+    }
+    
+    for(unsigned int i = 0; i < numSamples; i++)
+    {
+        pages[i] = (char*)memory + size / numSamples * i;
+    }
+    
+    // Without target nodes, the status of each page is its node:
+    if(syscall(SYS_move_pages, 0, (unsigned long int)numSamples, pages, NULL, status, 0) != 0)
+    {
+        return -1;
+    }
+    
+    for(unsigned int i = 0; i < numSamples; i++)
+    {
+        // Pages never touched have no node:
+        if(status[i] >= 0)
+        {
+            known++;
+            local += (status[i] == nodeIDs[node]);
+        }
+    }
+    
+    return (known == 0) ? -1 : (double)local / known;
+}
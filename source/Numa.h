@@ -0,0 +1,91 @@
+/*
+
+Pollux
+Copyright (C) 2014  Eric Marinier
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef NUMA_H
+#define	NUMA_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * Placement of read-only memory and threads across the NUMA nodes of the 
+ * machine. Nodes are numbered from 0 to getNumNodes() - 1, in the order the 
+ * system lists them. The system calls are made directly, so nothing beyond 
+ * the C library is needed. On a machine without NUMA support, there is a 
+ * single node and placing memory or threads does nothing.
+ */
+#define NUMA_MAX_NODES 64
+
+// Spreads the pages of the memory over every node:
+#define NUMA_INTERLEAVE -1
+
+enum NUMA_POLICY
+{
+    NUMA_OFF,                               // No placement and no report.
+    NUMA_FIRST_TOUCH,                       // Leave pages where they were first touched.
+    NUMA_INTERLEAVE_PAGES,                  // Interleave pages across the nodes.
+    NUMA_REPLICATE,                         // A copy on every node.
+};
+
+/**
+ * Returns the number of nodes. This is at least 1.
+ * 
+ * @return The number of nodes.
+ */
+unsigned int getNumNodes();
+
+/**
+ * Restricts the calling thread to the CPUs of the node.
+ * 
+ * @param node The node.
+ * @return Whether or not the thread was pinned.
+ */
+int pinThreadToNode(unsigned int node);
+
+/**
+ * Binds the pages of the memory to the node, or interleaves them over every 
+ * node, moving the pages already touched. Only the whole pages within the 
+ * memory are placed.
+ * 
+ * @param memory The memory.
+ * @param size The number of bytes.
+ * @param node The node, or NUMA_INTERLEAVE.
+ * @return Whether or not the memory was placed.
+ */
+int placeMemory(void* memory, unsigned long long int size, int node);
+
+/**
+ * Returns the fraction of the pages of the memory that are on the node, from 
+ * a sample of its pages. This is the fraction of uniformly random accesses to 
+ * the memory that are local to a thread running on the node.
+ * 
+ * @param memory The memory.
+ * @param size The number of bytes.
+ * @param node The node.
+ * @return The fraction of pages on the node, or -1 if it is unknown.
+ */
+double getLocalFraction(void* memory, unsigned long long int size, unsigned int node);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* NUMA_H */
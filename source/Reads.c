@@ -22,94 +22,412 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>
 
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "Reads.h"
 #include "Encoding.h" 
 #include "Utility.h"
+#include "ErrorTyping.h"
+#include "Memory.h"
 
 int BATCH_SIZE = 200000;        // Number of reads loaded in memory.
 int NUCLEOTIDE = 0;             // [0, 1, 2, 4] : replaces N's deterministically 
 
-Reads* createReads(char* fileName)
+/* Maps the file privately, so that its records can be parsed and terminated in 
+ * place without changing the file. The mapping is followed by at least one 0 
+ * byte, so that the last line can be terminated even without a newline. */
+static char* mapReads(char* fileName, unsigned long long int* size)
 {
-    Reads* reads = (Reads*)malloc(sizeof(Reads));
+    struct stat st;
+    char* data;
     
-    FILE* file = fopen(fileName, "r");
+    int file = open(fileName, O_RDONLY);
     
-    if (file == 0) 
+    if(file < 0)
     {
-        printf("Could not open file location: %s for reading.\n", fileName);
-        return 0;
+        return NULL;
     }
     
-    char ch;
-    int lines = 0;
+    if(fstat(file, &st) != 0)
+    {
+        close(file);
+        return NULL;
+    }
+    
+    *size = st.st_size;
+    
+    // Reserve the file and its terminating byte, then map the file over it:
+    data = (char*)mmap(NULL, *size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     
-    // Count the number of lines in the file:
-    while (EOF != (ch = getc(file))) 
+    if(data != MAP_FAILED && *size > 0 && mmap(data, *size, PROT_READ | PROT_WRITE, 
+            MAP_PRIVATE | MAP_FIXED, file, 0) == MAP_FAILED)
     {
-        if ('\n' == ch) {
-            ++lines;
+        munmap(data, *size + 1);
+        data = MAP_FAILED;
+    }
+    
+    close(file);
+        // The mapping remains after the file is closed.
+    
+    if(data == MAP_FAILED)
+    {
+        return NULL;
+    }
+    
+    madvise(data, *size, MADV_SEQUENTIAL);
+    
+    return data;
+}
+
+/* Opens the file for reading from the start. A compressed file is 
+ * decompressed into two windows in turn, and any other file is mapped. */
+static bool openReads(Reads* reads)
+{
+    reads->position = 0;
+    reads->released = 0;
+    reads->compressed = NULL;
+    
+    if(!isCompressedFile(reads->fileName))
+    {
+        return (reads->data = mapReads(reads->fileName, &(reads->size))) != NULL;
+    }
+    
+    // Room for each window and a terminating byte, used as it is filled:
+    reads->size = 0;
+    reads->capacity = READS_WINDOW_BYTES;
+    
+    for(int i = 0; i < 2; i++)
+    {
+        reads->windows[i] = (char*)mmap(NULL, reads->capacity + 1, PROT_READ | PROT_WRITE, 
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    
+    reads->data = reads->windows[0];
+    
+    if(reads->windows[0] == MAP_FAILED || reads->windows[1] == MAP_FAILED || 
+            (reads->compressed = openCompressedFile(reads->fileName, reads->numThreads)) == NULL)
+    {
+        for(int i = 0; i < 2; i++)
+        {
+            if(reads->windows[i] != MAP_FAILED)
+            {
+                munmap(reads->windows[i], reads->capacity + 1);
+            }
         }
+        
+        reads->compressed = NULL;
+        return false;
+    }
+    
+    return true;
+}
+
+static void closeReads(Reads* reads)
+{
+    if(reads->compressed != NULL)
+    {
+        closeCompressedFile(reads->compressed);
+        munmap(reads->windows[0], reads->capacity + 1);
+        munmap(reads->windows[1], reads->capacity + 1);
+    }
+    else
+    {
+        munmap(reads->data, reads->size + 1);
+    }
+}
+
+/* Decompresses more of a compressed file after the bytes already in the window, 
+ * without moving them. Returns whether any bytes were added: never for a mapped 
+ * file, or once the file has ended or the window is full. */
+static bool fillReads(Reads* reads)
+{
+    unsigned long long int length;
+    
+    if(reads->compressed == NULL || reads->size == reads->capacity)
+    {
+        return false;
+    }
+    
+    length = reads->capacity - reads->size;
+    length = (length < COMPRESSED_CHUNK_BYTES) ? length : COMPRESSED_CHUNK_BYTES;
+    length = readCompressedFile(reads->compressed, reads->data + reads->size, length);
+    reads->size += length;
+    
+    return length > 0;
+}
+
+/* Returns the end of the line starting at the position, decompressing more of 
+ * the file as needed, or NULL if there is no newline. */
+static char* findLineEnd(Reads* reads, unsigned long long int position)
+{
+    char* end = NULL;
+    
+    while((position >= reads->size || 
+            (end = (char*)memchr(reads->data + position, '\n', reads->size - position)) == NULL) && 
+            fillReads(reads))
+    {
+    }
+    
+    return end;
+}
+
+/* Returns the next line of the file, including its newline, and moves past it. 
+ * Returns NULL at the end of the file, or if the line does not fit in the 
+ * window of a compressed file. */
+static char* getNextLine(Reads* reads, int* length)
+{
+    char* line;
+    char* end = findLineEnd(reads, reads->position);
+    
+    if(reads->position >= reads->size || 
+            (end == NULL && reads->compressed != NULL && reads->size == reads->capacity))
+    {
+        return NULL;
+    }
+    
+    line = reads->data + reads->position;
+    *length = (end == NULL) ? (int)(reads->size - reads->position) : (int)(end - line + 1);
+    reads->position += *length;
+    
+    return line;
+}
+
+/* Returns how far the reading of the file went, in the bytes of the file. */
+static unsigned long long int getPosition(Reads* reads)
+{
+    if(reads->compressed != NULL)
+    {
+        return getCompressedPosition(reads->compressed);
+    }
+    
+    return reads->position;
+}
+
+/* Returns an upper bound on the words the encoded sequences of a batch take. */
+static unsigned long long int getBatchWords(Reads* reads)
+{
+    unsigned long long int bytes = reads->size;
+    unsigned long long int words;
+    
+    // A batch of a compressed file fits in a window:
+    if(reads->compressed != NULL)
+    {
+        bytes = (reads->numBytes > 0 && reads->numBytes < READS_WINDOW_BYTES) ? 
+                reads->numBytes : READS_WINDOW_BYTES;
+    }
+    
+    // Every base of a batch comes with a quality score, and each read is 
+    // encoded in whole words:
+    words = bytes / 2 / 32 + BATCH_SIZE;
+    
+    if(reads->longestRead > 0 && (unsigned long long int)BATCH_SIZE * ((reads->longestRead + 31) / 32) < words)
+    {
+        words = (unsigned long long int)BATCH_SIZE * ((reads->longestRead + 31) / 32);
     }
     
-    fclose(file);
-    file = fopen(fileName, "r");
+    return words;
+}
+
+/* Returns the size of the blocks of the arenas: no more than a batch needs. */
+static unsigned long long int getBlockWords(Reads* reads)
+{
+    unsigned long long int words = getBatchWords(reads);
     
-    if (file == 0) 
+    return (words < READS_BLOCK_WORDS) ? words : READS_BLOCK_WORDS;
+}
+
+Reads* createReads(char* fileName, KMerSketch* sketch, unsigned int numThreads)
+{
+    Reads* reads = (Reads*)malloc(sizeof(Reads));
+    
+    reads->fileName = fileName;
+    reads->numThreads = numThreads;
+    
+    if (!openReads(reads)) 
     {
         printf("Could not open file location: %s for reading.\n", fileName);
+        free(reads);
         return 0;
     }
     
-    reads->fileName = fileName;
-    reads->file = file;
-    reads->total = lines / 4;
+    char* line;
+    int length;
+    int lines = 0;
+    unsigned long long int bases = 0;
+    double scale;
     
-    reads->current = 0;
+    for(int i = 0; i < READS_NUM_BATCHES; i++)
+    {
+        ReadsBatch* batch = &(reads->batches[i]);
+        
+        batch->readData = NULL;
+        batch->count = 0;
+        batch->blocks = NULL;
+        batch->block = NULL;
+        batch->used = 0;
+        batch->ns = NULL;
+        batch->numNs = 0;
+        batch->nsCapacity = 0;
+    }
+    
+    reads->first = 0;
+    reads->filled = 0;
+    reads->finished = false;
+    reads->stopping = false;
+    reads->loading = false;
+    pthread_mutex_init(&(reads->lock), NULL);
+    pthread_cond_init(&(reads->changed), NULL);
+    
+    reads->batch = NULL;
     reads->readData = 0;
+    reads->current = 0;
+    reads->count = 0;
     reads->ID = 0;    
     
+    // Unknown without a sketch:
+    reads->distinctKMers = 0;
+    reads->repeatedKMers = 0;
+    reads->numBases = 0;
+    reads->numBytes = 0;
+    reads->longestRead = 0;
+    reads->blockWords = READS_BLOCK_WORDS;
+    
+    if(sketch == NULL)
+    {
+        reads->blockWords = getBlockWords(reads);
+        return reads;
+    }
+    
+    KMerSketchReset(sketch);
+    
+    // Sketch the sequences at the beginning of the file:
+    while (reads->position < READS_SKETCH_BYTES && (line = getNextLine(reads, &length)) != NULL) 
+    {
+        if (lines % 4 == 1)
+        {
+            KMerSketchAddSequence(sketch, line, length);
+            
+            // Without its newline:
+            bases += length - 1;
+            reads->longestRead = (length - 1 > reads->longestRead) ? length - 1 : reads->longestRead;
+        }
+        
+        ++lines;
+    }
+    
+    // The rest of the file is assumed to be like its beginning:
+    scale = (getPosition(reads) == 0) ? 1.0 : (double)readsGetSize(reads) / getPosition(reads);
+    
+    KMerSketchExtrapolate(sketch, scale, &(reads->distinctKMers), &(reads->repeatedKMers));
+    reads->numBases = (unsigned long long int)(bases * scale);
+    reads->numBytes = (unsigned long long int)(reads->position * scale);
+    reads->blockWords = getBlockWords(reads);
+    
+    // Start over:
+    if(reads->compressed != NULL)
+    {
+        closeReads(reads);
+        
+        if(!openReads(reads))
+        {
+            printf("Could not open file location: %s for reading.\n", fileName);
+            free(reads);
+            return 0;
+        }
+    }
+    
+    reads->position = 0;
+    
     return reads;
 }
 
-void freeReads(Reads* reads)
+/* Returns room for the given number of words in the arena of the batch, 
+ * reusing the blocks of the earlier batches and adding a block when none of 
+ * them has room. */
+static unsigned long long int* allocateWords(Reads* reads, ReadsBatch* batch, unsigned long long int words)
 {
-    // Do we already have reads open?
-    if(reads->readData != 0)
+    ReadsBlock* block = batch->block;
+    unsigned long long int size;
+    
+    if(block != NULL && batch->used + words <= block->size)
+    {
+        batch->used += words;
+        return &(block->words[batch->used - words]);
+    }
+    
+    // The next block, unless it is too small for a long read:
+    if(block != NULL && block->next != NULL && words <= block->next->size)
     {
-        int limit;
+        block = block->next;
+    }
+    else if(block == NULL && batch->blocks != NULL && words <= batch->blocks->size)
+    {
+        block = batch->blocks;
+    }
+    else
+    {
+        size = (words > reads->blockWords) ? words : reads->blockWords;
+        block = (ReadsBlock*)allocateMemory(sizeof(ReadsBlock) + size * sizeof(unsigned long long int));
         
-        // We don't want to free memory we haven't allocated.
-        // How many reads do we need to free in this block? The last block 
-        //      might not need all freed.
+        if(block == NULL)
+        {
+            printf("CRITICAL: FAILED TO ALLOCATE READS!\n");
+            exit(1);
+        }
         
-        // The entire block needs to be freed.
-        // This is the case when we're not in the last, or the last block was
-        //      entirely full.
-        if(reads->current < reads->total || reads->total % BATCH_SIZE == 0)
+        block->size = size;
+        
+        // Insert it after the block being filled:
+        if(batch->block != NULL)
         {
-            limit = BATCH_SIZE;
+            block->next = batch->block->next;
+            batch->block->next = block;
         }
-        // Only part of the block needs to be freed.
         else
         {
-            limit = reads->total % BATCH_SIZE;
+            block->next = batch->blocks;
+            batch->blocks = block;
         }
+    }
+    
+    batch->block = block;
+    batch->used = words;
+    
+    return block->words;
+}
+
+/* Frees the reads of a batch that was read, and gives the pages of its 
+ * records in a mapped file back to the system, along with the changes made to 
+ * them in place. Only the reader of the batches calls this. */
+static void releaseBatch(Reads* reads, ReadsBatch* batch)
+{
+    unsigned long long int pageSize = sysconf(_SC_PAGESIZE);
+    unsigned long long int end = batch->end / pageSize * pageSize;
+    
+    // Free the reads replaced by corrections. The names and quality are in 
+    // the file, and the sequences in the arena:
+    for(int i = 0; i < batch->count; i++)
+    {
+        struct read* current = &(batch->readData[i]);
         
-        // Free all the open reads.
-        for(int i = 0; i < limit; i++)
+        if(current->corrected)
         {
-            struct read* current = &(reads->readData[i]);
-            
-            free(current->seqName1);
             free(current->sequence);
-            free(current->seqName2);
             free(current->quality);
-            
-            free(current->basecontig);
         }
         
-        free(reads->readData);
+        free(current->basecontig);
+    }
+    
+    batch->count = 0;
+    
+    // The windows of a compressed file are reused instead:
+    if(reads->compressed == NULL && end > reads->released)
+    {
+        madvise(reads->data + reads->released, end - reads->released, MADV_DONTNEED);
+        reads->released = end;
     }
 }
 
@@ -138,119 +456,364 @@ char getNextReplacementNucleotide()
     return result;
 }
 
-// Replaces internal N's with other nucleotides.
-void replaceN(char* string)
+static inline bool isN(char nucleotide)
 {
-    for(int i = 0; i < strlen(string); i++)
+    return nucleotide == 'N' || nucleotide == 'n';
+}
+
+/* Remembers the internal N's of a read, to be replaced once the batch is read. 
+ * The N's of every file are replaced in the order in which the batches are 
+ * read, however far ahead they were loaded. */
+static void findNs(ReadsBatch* batch, int read, char* string, int length)
+{
+    for(int i = 0; i < length; i++)
     {
-        if(string[i] == 'N' || string[i] == 'n')
+        if(isN(string[i]))
         {
-            string[i] = getNextReplacementNucleotide();
+            if(batch->numNs == batch->nsCapacity)
+            {
+                batch->nsCapacity = (batch->nsCapacity == 0) ? 1024 : batch->nsCapacity * 2;
+                batch->ns = (int*)realloc(batch->ns, batch->nsCapacity * 2 * sizeof(int));
+                
+                if(batch->ns == NULL)
+                {
+                    printf("CRITICAL: FAILED TO ALLOCATE READS!\n");
+                    exit(1);
+                }
+            }
+            
+            batch->ns[2 * batch->numNs] = read;
+            batch->ns[2 * batch->numNs + 1] = i;
+            batch->numNs++;
         }
     }
 }
 
-void deleteCharacter(char* string, int pos)
+// Replaces internal N's with other nucleotides.
+static void replaceNs(ReadsBatch* batch)
 {
-    int length = strlen(string);
-    
-    if (pos < 0 || pos >= length)
-        return;
-    
-    for(int i = pos; i < length; i++)
+    for(int i = 0; i < batch->numNs; i++)
     {
-        string[i] = string[i + 1];
+        setBase(batch->readData[batch->ns[2 * i]].sequence, batch->ns[2 * i + 1], 
+                getNextReplacementNucleotide());
     }
     
-    string[length] = '\0';
+    batch->numNs = 0;
 }
 
-void trimNs(char* sequence, char* quality)
+// Trims the quality along with the sequence, as far as it goes.
+void trimNs(char** sequence, int* sequenceLength, char** quality, int* qualityLength)
 {
     // Delete leading N's.
-    while(strlen(sequence) >= 1 && 
-            (sequence[0] == 'N' || sequence[0] == 'n'))
+    while(*sequenceLength >= 1 && isN((*sequence)[0]))
     {
-        deleteCharacter(sequence, 0);
-        deleteCharacter(quality, 0);
+        (*sequence)++;
+        (*sequenceLength)--;
+        
+        if(*qualityLength >= 1)
+        {
+            (*quality)++;
+            (*qualityLength)--;
+        }
     }
     
     // Delete trailing N's.
-    while(strlen(sequence) >= 1 && 
-            (sequence[strlen(sequence) - 1] == 'N' || sequence[strlen(sequence) - 1] == 'n'))
+    while(*sequenceLength >= 1 && isN((*sequence)[*sequenceLength - 1]))
     {
-        deleteCharacter(sequence, strlen(sequence) - 1);
-        deleteCharacter(quality, strlen(quality) - 1);
+        (*sequenceLength)--;
+        
+        if(*qualityLength >= 1)
+        {
+            (*qualityLength)--;
+        }
     }    
 }
 
-void trimSpaces(char* string)
+void trimSpaces(char** string, int* length)
 {
     // Delete leading spaces.
-    while(strlen(string) >= 1 && isspace(string[0]))
+    while(*length >= 1 && isspace((*string)[0]))
     {
-        deleteCharacter(string, 0);
+        (*string)++;
+        (*length)--;
     }
     
-    // Delete trailing N's.
-    while(strlen(string) >= 1 && isspace(string[strlen(string) - 1]))
+    // Delete trailing spaces.
+    while(*length >= 1 && isspace((*string)[*length - 1]))
     {
-        deleteCharacter(string, strlen(string) - 1);
+        (*length)--;
     }
 }
 
-void loadReads(Reads* reads)
+/* Moves the records of the batch being loaded, from its start, to the other 
+ * window of a compressed file when its window is full. The other window only 
+ * held batches that were already released: the batch being read, if any, is 
+ * in the same window as the batch that follows it. */
+static void switchWindow(Reads* reads, ReadsBatch* batch, int count, unsigned long long int start)
 {
-    freeReads(reads);   // FREE FIRST!    
-    reads->readData = (struct read*)malloc(BATCH_SIZE * sizeof(struct read));      // LOAD SECOND!
-      
-    for(int i = 0; i < BATCH_SIZE && (reads->current + i < reads->total); i++)
+    char* previous = reads->data + start;
+    char* data = reads->windows[(reads->data == reads->windows[0]) ? 1 : 0];
+    
+    // The pages of the batches before are no longer needed:
+    madvise(data, reads->capacity + 1, MADV_DONTNEED);
+    memcpy(data, previous, reads->size - start);
+    
+    for(int i = 0; i < count; i++)
     {
-        struct read* current = &(reads->readData[i]);
+        struct read* current = &(batch->readData[i]);
         
-        reads->ID = reads->ID + 1;
+        current->seqName1 = data + (current->seqName1 - previous);
+        current->seqName2 = data + (current->seqName2 - previous);
+        current->quality = data + (current->quality - previous);
+    }
+    
+    reads->data = data;
+    reads->size -= start;
+    reads->position -= start;
+}
 
-        // TODO: THESE LENGTHS SHOULD BE VARIABLE!!!
-        char seqName1[2048];
-        char sequence[2048];
-        char seqName2[2048];
-        char quality[2048];
-        
-        // Get the 4 lines of a FASTQ file:
-        if(     fgets(seqName1, 2048, reads->file) == NULL ||
-                fgets(sequence, 2048, reads->file) == NULL ||
-                fgets(seqName2, 2048, reads->file) == NULL ||
-                fgets(quality, 2048, reads->file) == NULL )
+/* Parses the next records of the file into the batch. Only the loader thread 
+ * calls this, once the file is open. */
+static void loadBatch(Reads* reads, ReadsBatch* batch)
+{
+    unsigned long long int first = reads->position;
+    
+    if(batch->readData == NULL)
+    {
+        batch->readData = (struct read*)allocateMemory(BATCH_SIZE * sizeof(struct read));
+    }
+    
+    if(batch->readData == NULL)
+    {
+        printf("CRITICAL: FAILED TO ALLOCATE READS!\n");
+        exit(1);
+    }
+    
+    // Fill the arena again from its first block:
+    batch->block = NULL;
+    batch->used = 0;
+    batch->count = 0;
+    batch->numNs = 0;
+      
+    for(int i = 0; i < BATCH_SIZE; i++)
+    {
+        struct read* current = &(batch->readData[i]);
+        
+        char* sequence;
+        char* quality;
+        int sequenceLength;
+        int qualityLength;
+        
+        unsigned long long int start = reads->position;
+        
+        // Get the 4 lines of a FASTQ file. A record cut short by the end of the 
+        // file is ignored:
+        if(     (current->seqName1 = getNextLine(reads, &(current->seqName1Length))) == NULL ||
+                (sequence = getNextLine(reads, &sequenceLength)) == NULL ||
+                (current->seqName2 = getNextLine(reads, &(current->seqName2Length))) == NULL ||
+                (quality = getNextLine(reads, &qualityLength)) == NULL ||
+                quality[qualityLength - 1] != '\n')
         {
-            printf("CRITICAL: FAILED TO READ INPUT!\n");
-            exit(1);
+            // The window of a compressed file is full: continue in the other 
+            // window, or end the batch if it fills a window alone.
+            if(reads->compressed != NULL && reads->size == reads->capacity)
+            {
+                reads->position = start;
+                
+                if(first > 0)
+                {
+                    switchWindow(reads, batch, i, first);
+                    first = 0;
+                    i--;
+                    continue;
+                }
+                
+                if(i == 0)
+                {
+                    printf("CRITICAL: A READ IN %s DOES NOT FIT IN MEMORY!\n", reads->fileName);
+                    exit(1);
+                }
+                
+                break;
+            }
+            
+            reads->position = reads->size;
+            break;
         }
+        
+        reads->ID = reads->ID + 1;
+        batch->count = i + 1;
        
-        trimSpaces(sequence);
-        trimSpaces(quality);
+        trimSpaces(&sequence, &sequenceLength);
+        trimSpaces(&quality, &qualityLength);
     
-        trimNs(sequence, quality);
-        replaceN(sequence);
+        trimNs(&sequence, &sequenceLength, &quality, &qualityLength);
+        findNs(batch, i, sequence, sequenceLength);
         
-        // Sequence name 1:
-        current->seqName1 = malloc(strlen(seqName1) + 1);
-        strcpy(current->seqName1, seqName1);
+        // The trimmed characters are no longer needed:
+        sequence[sequenceLength] = '\0';
+        quality[qualityLength] = '\0';
         
         // Encode sequences:
+        current->sequence = allocateWords(reads, batch, (sequenceLength + 31) / 32);
         encode_sequence(current, sequence);
         
-         // Sequence name 2:
-        current->seqName2 = malloc(strlen(seqName2) + 1);
-        strcpy(current->seqName2, seqName2);       
-        
         //Quality:
-        current->quality = malloc(strlen(quality) + 1);
-        strcpy(current->quality, quality);
+        current->quality = quality;
+        current->corrected = 0;
         
         current->basecontig = NULL;
         current->correct_pos = 0;
+        current->type = UNKNOWN;
         current->number = reads->ID;        
     }
+    
+    batch->end = reads->position;
+    batch->progress = getPosition(reads);
+}
+
+/* Loads the batches of the file in order, ahead of the reader, until the end of 
+ * the file or until it is stopped. */
+static void* loadReads(void* arg)
+{
+    Reads* reads = (Reads*)arg;
+    ReadsBatch* batch;
+    
+    while(true)
+    {
+        // Wait for a free batch:
+        pthread_mutex_lock(&(reads->lock));
+        
+        while(reads->filled == READS_NUM_BATCHES && !reads->stopping)
+        {
+            pthread_cond_wait(&(reads->changed), &(reads->lock));
+        }
+        
+        batch = &(reads->batches[(reads->first + reads->filled) % READS_NUM_BATCHES]);
+        
+        if(reads->stopping)
+        {
+            pthread_mutex_unlock(&(reads->lock));
+            break;
+        }
+        
+        pthread_mutex_unlock(&(reads->lock));
+        
+        loadBatch(reads, batch);
+        
+        pthread_mutex_lock(&(reads->lock));
+        
+        if(batch->count > 0)
+        {
+            reads->filled++;
+        }
+        else
+        {
+            reads->finished = true;
+        }
+        
+        pthread_cond_broadcast(&(reads->changed));
+        pthread_mutex_unlock(&(reads->lock));
+        
+        if(batch->count == 0)
+        {
+            break;
+        }
+    }
+    
+    return NULL;
+}
+
+/* Starts loading the batches in the background, if that has not started. */
+static void startLoading(Reads* reads)
+{
+    if(!reads->loading)
+    {
+        reads->loading = true;
+        
+        if(pthread_create(&(reads->loader), NULL, loadReads, reads) != 0)
+        {
+            printf("CRITICAL: FAILED TO START LOADING %s!\n", reads->fileName);
+            exit(1);
+        }
+    }
+}
+
+/* Stops the loader and releases every batch, so that the file can be closed. */
+static void stopLoading(Reads* reads)
+{
+    if(reads->loading)
+    {
+        pthread_mutex_lock(&(reads->lock));
+        reads->stopping = true;
+        pthread_cond_broadcast(&(reads->changed));
+        pthread_mutex_unlock(&(reads->lock));
+        
+        pthread_join(reads->loader, NULL);
+    }
+    
+    for(int i = 0; i < reads->filled; i++)
+    {
+        releaseBatch(reads, &(reads->batches[(reads->first + i) % READS_NUM_BATCHES]));
+    }
+    
+    reads->first = 0;
+    reads->filled = 0;
+    reads->finished = false;
+    reads->stopping = false;
+    reads->loading = false;
+    
+    reads->batch = NULL;
+    reads->readData = 0;
+    reads->current = 0;
+    reads->count = 0;
+}
+
+/* Waits until the batch after the one being read is loaded, and returns 
+ * whether there is one. */
+static bool waitForBatch(Reads* reads)
+{
+    int held = (reads->batch != NULL) ? 1 : 0;
+    bool loaded;
+    
+    startLoading(reads);
+    
+    pthread_mutex_lock(&(reads->lock));
+    
+    while(reads->filled == held && !reads->finished)
+    {
+        pthread_cond_wait(&(reads->changed), &(reads->lock));
+    }
+    
+    loaded = reads->filled > held;
+    pthread_mutex_unlock(&(reads->lock));
+    
+    return loaded;
+}
+
+/* Releases the batch that was read, and moves on to the next, which must be 
+ * loaded. */
+static void nextBatch(Reads* reads)
+{
+    if(reads->batch != NULL)
+    {
+        releaseBatch(reads, reads->batch);
+        
+        // Let the loader fill it again:
+        pthread_mutex_lock(&(reads->lock));
+        reads->first = (reads->first + 1) % READS_NUM_BATCHES;
+        reads->filled--;
+        pthread_cond_broadcast(&(reads->changed));
+        pthread_mutex_unlock(&(reads->lock));
+    }
+    
+    reads->batch = &(reads->batches[reads->first]);
+    
+    replaceNs(reads->batch);
+    
+    reads->readData = reads->batch->readData;
+    reads->current = 0;
+    reads->count = reads->batch->count;
 }
 
 struct read* readsGetNext(Reads* reads)
@@ -258,37 +821,54 @@ struct read* readsGetNext(Reads* reads)
     struct read* result;
     
     // Do we need to load more reads?
-    if(reads->current % BATCH_SIZE == 0)
+    if(reads->current == reads->count && waitForBatch(reads))
     {
-        loadReads(reads);
+        nextBatch(reads);
     }
     
-    result = &(reads->readData[reads->current % BATCH_SIZE]);
+    result = &(reads->readData[reads->current]);
     reads->current = reads->current + 1;    
     
     return result;
 }
 
+// Returns the remaining reads of the current batch (loading the next batch if 
+// needed) as a contiguous array. They are valid until the next batch is loaded.
+int readsGetNextBatch(Reads* reads, struct read** batch)
+{
+    int count;
+    
+    // Do we need to load more reads?
+    if(reads->current == reads->count && waitForBatch(reads))
+    {
+        nextBatch(reads);
+    }
+    
+    count = reads->count - reads->current;
+    
+    *batch = &(reads->readData[reads->current]);
+    reads->current = reads->count;
+    
+    return count;
+}
+
 bool readsHasNext(Reads* reads)
 {
-    return (reads->current < reads->total);
+    return (reads->current < reads->count || waitForBatch(reads));
 }
 
 int readsReset(Reads* reads)
 {   
-    freeReads(reads);
-    fclose(reads->file);    
+    stopLoading(reads);
+    closeReads(reads);
     
-    reads->file = fopen(reads->fileName, "r");
-    
-    if (reads->file == 0) 
+    // Open the file again, without the changes made in place:
+    if (!openReads(reads)) 
     {
         printf("Could not open file location: %s for reading.\n", reads->fileName);
         return 1;
     }
     
-    reads->current = 0;
-    reads->readData = 0;
     reads->ID = 0;
     
     return 0;
@@ -296,15 +876,72 @@ int readsReset(Reads* reads)
 
 void readsDestroy(Reads* reads)
 {
-    freeReads(reads);
-    fclose(reads->file);
+    ReadsBlock* next;
+    
+    stopLoading(reads);
+    closeReads(reads);
+    
+    for(int i = 0; i < READS_NUM_BATCHES; i++)
+    {
+        ReadsBatch* batch = &(reads->batches[i]);
+        
+        if(batch->readData != NULL)
+        {
+            freeMemory(batch->readData, BATCH_SIZE * sizeof(struct read));
+        }
+        
+        for(ReadsBlock* block = batch->blocks; block != NULL; block = next)
+        {
+            next = block->next;
+            freeMemory(block, sizeof(ReadsBlock) + block->size * sizeof(unsigned long long int));
+        }
+        
+        free(batch->ns);
+    }
+    
+    pthread_mutex_destroy(&(reads->lock));
+    pthread_cond_destroy(&(reads->changed));
     
     free(reads);
 }
 
-int readsGetCount(Reads* reads)
+// Returns how far the reads that were loaded go, in the bytes of the file.
+unsigned long long int readsGetPosition(Reads* reads)
+{
+    return (reads->batch != NULL) ? reads->batch->progress : 0;
+}
+
+unsigned long long int readsGetSize(Reads* reads)
+{
+    if(reads->compressed != NULL)
+    {
+        return reads->compressed->size;
+    }
+    
+    return reads->size;
+}
+
+// Returns an upper bound on the memory held while reading the file: the reads 
+// and arenas of its batches, and the windows and decompression chunks of a 
+// compressed file.
+unsigned long long int readsGetMemory(Reads* reads)
 {
-    return reads->total;
+    unsigned long long int words = getBatchWords(reads);
+    unsigned long long int memory;
+    
+    // One block holds a batch, unless that is more than a full block:
+    memory = READS_NUM_BATCHES * (getAllocationSize(BATCH_SIZE * sizeof(struct read)) + 
+            ((words <= reads->blockWords) ? 1 : words / reads->blockWords + 1) * 
+            getAllocationSize(sizeof(ReadsBlock) + reads->blockWords * sizeof(unsigned long long int)));
+    
+    // The windows are filled in turn, up to the whole file:
+    if(reads->compressed != NULL)
+    {
+        memory += ((reads->numBytes > 0 && reads->numBytes < 2 * READS_WINDOW_BYTES) ? 
+                reads->numBytes : 2 * READS_WINDOW_BYTES) + COMPRESSED_NUM_CHUNKS * COMPRESSED_CHUNK_BYTES;
+    }
+    
+    return memory;
 }
 
 char* readsGetFileName(Reads* reads)
@@ -19,7 +19,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdio.h>
+#include <pthread.h>
 #include "Utility.h"
+#include "KMerSketch.h"
+#include "Compression.h"
 
 #ifndef READS_H
 #define	READS_H
@@ -29,14 +32,36 @@ extern "C" {
 #endif
     
 extern int BATCH_SIZE;  // Batch size in reads.
+extern int NUCLEOTIDE;  // The next replacement for an N.
 
-// Single read:
+// The k-mers of larger files are estimated from a sketch of this many bytes:
+#define READS_SKETCH_BYTES (64ULL << 20)
+
+// The most bytes of a compressed file held decompressed in each of its two 
+// windows:
+#define READS_WINDOW_BYTES (1ULL << 29)
+
+// The batch being read, and the next one being loaded in the background:
+#define READS_NUM_BATCHES 2
+
+// The encoded sequences of a batch are allocated from blocks of this many words, 
+// or fewer if a batch of the file cannot need as many:
+#define READS_BLOCK_WORDS (1ULL << 20)
+
+/* Single read. The names and quality point into the mapped file (see 
+ * createReads). The names are not terminated, but keep their newline. The 
+ * quality is terminated in place, and the sequence is in the arena of the 
+ * batch, until a correction replaces them. */
 struct read {
     char* seqName1;
     unsigned long long int* sequence;
     char* seqName2;
     char* quality;   
     
+    int seqName1Length;
+    int seqName2Length;
+    short corrected;    // Whether applyCorrection replaced the sequence and quality.
+    
     struct contig* basecontig;
     unsigned long int startpos;
     int length;
@@ -46,26 +71,87 @@ struct read {
     char type;
 };
 
+/* A block of the arena holding the encoded sequences of a batch. The blocks 
+ * are kept and filled again by each batch, instead of freeing every sequence. */
+typedef struct ReadsBlock
+{
+    struct ReadsBlock* next;
+    unsigned long long int size;            // In words.
+    unsigned long long int words[];
+    
+} ReadsBlock;
+
+/* A batch of reads, loaded in the background. */
+typedef struct
+{
+    struct read* readData;                  // Kept for every batch.
+    int count;                              // The number of reads.
+    
+    ReadsBlock* blocks;                     // The arena of the batch.
+    ReadsBlock* block;                      // The block being filled.
+    unsigned long long int used;            // The words used in that block.
+    
+    int* ns;                                // The read and position of each N.
+    int numNs;                              // Replaced as the batch is read.
+    int nsCapacity;
+    
+    unsigned long long int end;             // The offset after its records.
+    unsigned long long int progress;        // The position in the file after it.
+    
+} ReadsBatch;
+
 // Collection of reads:
 typedef struct
 {
     char* fileName;
-    FILE* file;
-    int total;
     
-    int current;
+    char* data;                             // The file, mapped privately.
+    unsigned long long int size;            // The length of the file (or window).
+    
+    // A compressed file is decompressed into data, a window at a time:
+    CompressedFile* compressed;             // Or NULL if the file is mapped.
+    char* windows[2];                       // Alternately data.
+    unsigned long long int capacity;        // The size of a window.
+    unsigned int numThreads;                // Decompressing the file.
+    
+    unsigned long long int position;        // The offset of the next record.
+    unsigned long long int released;        // The pages before this were released.
     int ID;
     
-    struct read* readData;
+    // The batches, loaded in order by the loader thread:
+    ReadsBatch batches[READS_NUM_BATCHES];
+    int first;                              // The oldest batch loaded.
+    int filled;                             // The batches loaded, and not released.
+    bool finished;                          // The loader reached the end of the file.
+    bool stopping;                          // The loader must stop.
+    bool loading;                           // The loader was started.
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t loader;
+    
+    ReadsBatch* batch;  // The batch being read, or NULL.
+    struct read* readData;                  // Its reads.
+    int current;        // The next read of the batch.
+    int count;          // The number of reads in the batch.
+    
+    unsigned long long int distinctKMers;   // Estimated, or 0 if unknown.
+    unsigned long long int repeatedKMers;   // Estimated, or 0 if unknown.
+    unsigned long long int numBases;        // Estimated, or 0 if unknown.
+    unsigned long long int numBytes;        // Decompressed, estimated, or 0 if unknown.
+    int longestRead;                        // Of those sketched, or 0 if unknown.
+    unsigned long long int blockWords;      // The size of a new block of an arena.
     
 } Reads;
 
-Reads* createReads(char* fileName);
+Reads* createReads(char* fileName, KMerSketch* sketch, unsigned int numThreads);
 struct read* readsGetNext(Reads* reads);
+int readsGetNextBatch(Reads* reads, struct read** batch);
 bool readsHasNext(Reads* reads);
 int readsReset(Reads* reads);
 void readsDestroy(Reads* reads);
-int readsGetCount(Reads* reads);
+unsigned long long int readsGetPosition(Reads* reads);
+unsigned long long int readsGetSize(Reads* reads);
+unsigned long long int readsGetMemory(Reads* reads);
 char* readsGetFileName(Reads* reads);
 
 #ifdef	__cplusplus
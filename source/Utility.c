@@ -126,6 +126,122 @@ unsigned long long int* createReverseCompliment(unsigned long long int* sequence
     return reverseCompliment;
 }
 
+unsigned long long int getReverseComplimentKMer(unsigned long long int kmer,
+        unsigned int kmerSize)
+{
+    // Compliment:
+    unsigned long long int result = ~kmer;
+    
+    // Reverse the order of the 2-bit nucleotides:
+    result = ((result >> 2) & 0x3333333333333333ULL) | ((result & 0x3333333333333333ULL) << 2);
+    result = ((result >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((result & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    result = ((result >> 8) & 0x00FF00FF00FF00FFULL) | ((result & 0x00FF00FF00FF00FFULL) << 8);
+    result = ((result >> 16) & 0x0000FFFF0000FFFFULL) | ((result & 0x0000FFFF0000FFFFULL) << 16);
+    result = (result >> 32) | (result << 32);
+    
+    // Left-align; the complimented padding bits are shifted out:
+    return result << (64 - kmerSize * 2);
+}
+
+unsigned long long int getCanonicalKMer(unsigned long long int kmer,
+        unsigned int kmerSize)
+{
+    unsigned long long int reverse = getReverseComplimentKMer(kmer, kmerSize);
+    
+    return (kmer < reverse) ? kmer : reverse;
+}
+
+void getCanonicalKMers(unsigned long long int* sequence, unsigned int length,
+        unsigned int kmerSize, unsigned long long int* kmers)
+{
+    const unsigned long long int MASK = 0xFFFFFFFFFFFFFFFF;
+    const unsigned int SHIFT = 64 - kmerSize * 2;
+    
+    unsigned long long int forward;
+    unsigned long long int reverse;
+    unsigned long long int nucleotide;
+    
+    if(length < kmerSize)
+    {
+        return;
+    }
+    
+    forward = getKMer(sequence, 0, kmerSize);
+    reverse = getReverseComplimentKMer(forward, kmerSize);
+    kmers[0] = (forward < reverse) ? forward : reverse;
+    
+    for(unsigned int i = kmerSize; i < length; i++)
+    {
+        // Get the next nucleotide:
+        nucleotide = (sequence[i / 32] >> (62 - (i % 32) * 2)) & 0x3;
+        
+        // Roll the window forward:
+        forward = (forward << 2) | (nucleotide << SHIFT);
+        reverse = ((reverse >> 2) | ((0x3 - nucleotide) << 62)) & (MASK << SHIFT);
+        
+        kmers[i - kmerSize + 1] = (forward < reverse) ? forward : reverse;
+    }
+}
+
+KMerWide getKMerWide(unsigned long long int* sequence, 
+        unsigned int startNucleotidePosition, 
+        unsigned int endNucleotidePosition)
+{
+    KMerWide result;
+    
+    // Fits in the high word:
+    if(endNucleotidePosition - startNucleotidePosition <= 32)
+    {
+        return (KMerWide)getKMer(sequence, startNucleotidePosition, endNucleotidePosition) << 64;
+    }
+    
+    result = (KMerWide)getKMer(sequence, startNucleotidePosition, startNucleotidePosition + 32) << 64;
+    
+    return result | getKMer(sequence, startNucleotidePosition + 32, endNucleotidePosition);
+}
+
+KMerWide getReverseComplimentKMerWide(KMerWide kmer, unsigned int kmerSize)
+{
+    // Reverse compliment each word, and swap them:
+    KMerWide result = (KMerWide)getReverseComplimentKMer((unsigned long long int)kmer, 32) << 64;
+    result = result | getReverseComplimentKMer((unsigned long long int)(kmer >> 64), 32);
+    
+    // Left-align:
+    return result << (128 - kmerSize * 2);
+}
+
+void getCanonicalKMersWide(unsigned long long int* sequence, unsigned int length,
+        unsigned int kmerSize, KMerWide* kmers)
+{
+    const KMerWide MASK = ~(KMerWide)0;
+    const unsigned int SHIFT = 128 - kmerSize * 2;
+    
+    KMerWide forward;
+    KMerWide reverse;
+    KMerWide nucleotide;
+    
+    if(length < kmerSize)
+    {
+        return;
+    }
+    
+    forward = getKMerWide(sequence, 0, kmerSize);
+    reverse = getReverseComplimentKMerWide(forward, kmerSize);
+    kmers[0] = (forward < reverse) ? forward : reverse;
+    
+    for(unsigned int i = kmerSize; i < length; i++)
+    {
+        // Get the next nucleotide:
+        nucleotide = (sequence[i / 32] >> (62 - (i % 32) * 2)) & 0x3;
+        
+        // Roll the window forward:
+        forward = (forward << 2) | (nucleotide << SHIFT);
+        reverse = ((reverse >> 2) | ((0x3 - nucleotide) << 126)) & (MASK << SHIFT);
+        
+        kmers[i - kmerSize + 1] = (forward < reverse) ? forward : reverse;
+    }
+}
+
 void printAsNucleotides(unsigned long long int* sequence, 
         unsigned int startNucleotidePosition, 
         unsigned int endNucleotidePosition)
@@ -276,6 +392,33 @@ int getMin(int value1, int value2)
     }
 }
 
+unsigned long long int parseMemorySize(char* text)
+{
+    char* end;
+    unsigned long long int size = strtoull(text, &end, 10);
+    
+    if(end == text)
+    {
+        return 0;
+    }
+    
+    // Megabytes when no unit is given:
+    if(*end == '\0' || strcmp(end, "M") == 0 || strcmp(end, "m") == 0)
+    {
+        return size << 20;
+    }
+    else if(strcmp(end, "G") == 0 || strcmp(end, "g") == 0)
+    {
+        return size << 30;
+    }
+    else if(strcmp(end, "K") == 0 || strcmp(end, "k") == 0)
+    {
+        return size << 10;
+    }
+    
+    return 0;
+}
+
 char getBase(unsigned long long int* nucleotideSequence, 
         unsigned int nucleotidePosition)
 {
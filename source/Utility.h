@@ -34,6 +34,15 @@ typedef int bool;
 #define MAX_CORRECTIONS 30                      // 'Minimum' max corrections performed.
                                                 // - More important for short reads.
 
+#define KMER_NARROW_MAX_SIZE 31                 // Largest k-mer held by getKMer.
+#define KMER_MAX_SIZE 63                        // Largest k-mer held by getKMerWide.
+
+/**
+ * A k-mer longer than KMER_NARROW_MAX_SIZE, packed into 128 bits the same way 
+ * getKMer packs a k-mer into 64: left-aligned, with the lower bits set to 0.
+ */
+typedef unsigned __int128 KMerWide;
+
 struct Sequence
 {
     unsigned long long int* sequence;           // Pointer to the actual sequence.
@@ -125,6 +134,15 @@ int getMax(int value1, int value2);
  */
 int getMin(int value1, int value2);
 
+/**
+ * This is a helper function to read a memory size, such as "512M" or "8G". 
+ * The size is in megabytes when no unit is given.
+ * 
+ * @param text The memory size, with an optional K, M or G unit.
+ * @return The size in bytes, or 0 if the text was not understood.
+ */
+unsigned long long int parseMemorySize(char* text);
+
 /**
  * This function returns the reverse for a single 64bit sequence block.
  * 
@@ -145,6 +163,82 @@ unsigned long long int getReverse(unsigned long long int sequence);
 unsigned long long int* createReverseCompliment(unsigned long long int* sequence,
         unsigned int length);
 
+/**
+ * This function returns the reverse compliment of a single k-mer, as produced 
+ * by getKMer. The result is also left-aligned, with the 64 - (2 * k) lower 
+ * bits set to 0.
+ * 
+ * @param kmer The k-mer to reverse compliment.
+ * @param kmerSize The length of the k-mer (<= 32).
+ * @return The reverse compliment of the k-mer.
+ */
+unsigned long long int getReverseComplimentKMer(unsigned long long int kmer,
+        unsigned int kmerSize);
+
+/**
+ * This function returns the canonical form of a k-mer: the smaller of the 
+ * k-mer and its reverse compliment. A k-mer and its reverse compliment share 
+ * the same canonical k-mer.
+ * 
+ * @param kmer The k-mer, as produced by getKMer.
+ * @param kmerSize The length of the k-mer (<= 32).
+ * @return The canonical k-mer.
+ */
+unsigned long long int getCanonicalKMer(unsigned long long int kmer,
+        unsigned int kmerSize);
+
+/**
+ * This function fills the passed array with the canonical form of every k-mer 
+ * in the sequence, in order. The reverse compliment is maintained 
+ * incrementally while the k-mer window rolls over the sequence.
+ * 
+ * @param sequence The sequence array from which to pull the k-mers.
+ * @param length The length of the sequence in nucleotide bases.
+ * @param kmerSize The length of the k-mers (<= 32).
+ * @param kmers The array to fill. There will be (length - kmerSize + 1) 
+ *      entries expected to be filled.
+ */
+void getCanonicalKMers(unsigned long long int* sequence, unsigned int length,
+        unsigned int kmerSize, unsigned long long int* kmers);
+
+/**
+ * This function returns a k-mer of up to 64 nucleotide bases from the passed 
+ * sequence array as a single 128-bit integer. It is otherwise the same as 
+ * getKMer.
+ * 
+ * @param sequence The sequence array from which to pull the k-mer.
+ * @param startNucleotidePosition The starting position of the k-mer.
+ * @param endNucleotidePosition The ending position of the k-mer (excluded).
+ * @return A 128-bit integer representation of the k-mer with the first k high 
+ *      bits representing the k-mer and the 128 - (2 * k) lower bits set to 0.
+ */
+KMerWide getKMerWide(unsigned long long int* sequence, 
+        unsigned int startNucleotidePosition, 
+        unsigned int endNucleotidePosition);
+
+/**
+ * This function returns the reverse compliment of a single k-mer, as produced 
+ * by getKMerWide. The result is also left-aligned.
+ * 
+ * @param kmer The k-mer to reverse compliment.
+ * @param kmerSize The length of the k-mer (<= 64).
+ * @return The reverse compliment of the k-mer.
+ */
+KMerWide getReverseComplimentKMerWide(KMerWide kmer, unsigned int kmerSize);
+
+/**
+ * This function fills the passed array with the canonical form of every k-mer 
+ * in the sequence, in order, as getCanonicalKMers does for shorter k-mers.
+ * 
+ * @param sequence The sequence array from which to pull the k-mers.
+ * @param length The length of the sequence in nucleotide bases.
+ * @param kmerSize The length of the k-mers (<= 64).
+ * @param kmers The array to fill. There will be (length - kmerSize + 1) 
+ *      entries expected to be filled.
+ */
+void getCanonicalKMersWide(unsigned long long int* sequence, unsigned int length,
+        unsigned int kmerSize, KMerWide* kmers);
+
 char getBase(unsigned long long int* nucleotideSequence, 
         unsigned int nucleotidePosition);
 
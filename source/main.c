@@ -25,6 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "Globals.h"
 #include "Reads.h"
 #include <unistd.h>
+#include <ctype.h>
 
 bool checkInput(int numInputFiles, char* inputFileNames, char* outputFileName, 
         bool paired, enum SEQUENCING_TECHNOLOGY type, bool fastk, unsigned int KMER_SIZE)
@@ -47,12 +48,70 @@ bool checkInput(int numInputFiles, char* inputFileNames, char* outputFileName,
         return false;
     }
     
-    if (KMER_SIZE > 31)
+    if (KMER_SIZE > KMER_MAX_SIZE)
     {
         printf("ERROR: k-mer size is too large.\n");
         return false;
     }
     
+    if (KMER_SIZE > KMER_NARROW_MAX_SIZE && (KMER_ENGINE != KMER_ENGINE_HASH || 
+            MAX_MEMORY > 0 || FILTER_SIZE > 0 || SAVE_KMERS != NULL || LOAD_KMERS != NULL))
+    {
+        printf("ERROR: k-mers longer than %d cannot be used with the sort or cqf engines, --max-memory, --bloom, --save-kmers or --load-kmers.\n", KMER_NARROW_MAX_SIZE);
+        return false;
+    }
+    
+    if (NUM_THREADS < 1)
+    {
+        printf("ERROR: Need at least one thread.\n");
+        return false;
+    }
+    
+    if (!isKMerHashSupported(HASH_FUNCTION))
+    {
+        printf("ERROR: The %s hash function is not supported on this machine.\n", getKMerHashName(HASH_FUNCTION));
+        return false;
+    }
+    
+    if (KMER_ENGINE == KMER_ENGINE_SORT && 
+            (MAX_MEMORY > 0 || FILTER_SIZE > 0 || SAVE_KMERS != NULL || LOAD_KMERS != NULL))
+    {
+        printf("ERROR: The sort engine cannot be used with --max-memory, --bloom, --save-kmers or --load-kmers.\n");
+        return false;
+    }
+    
+    if (KMER_ENGINE == KMER_ENGINE_QUOTIENT && 
+            (MAX_MEMORY > 0 || FILTER_SIZE > 0 || SAVE_KMERS != NULL || LOAD_KMERS != NULL))
+    {
+        printf("ERROR: The cqf engine cannot be used with --max-memory, --bloom, --save-kmers or --load-kmers.\n");
+        return false;
+    }
+    
+    if (EXTEND_KMERS != NULL && (LOAD_KMERS != NULL || MAX_MEMORY > 0 || FILTER_SIZE > 0 || 
+            KMER_ENGINE != KMER_ENGINE_HASH))
+    {
+        printf("ERROR: --extend-kmers cannot be used with --load-kmers, --max-memory, --bloom or the sort or cqf engines.\n");
+        return false;
+    }
+    
+    if (FREEZE_KMERS && LOAD_KMERS != NULL)
+    {
+        printf("ERROR: --freeze cannot be used with --load-kmers.\n");
+        return false;
+    }
+    
+    if (NUMA_PLACEMENT != NUMA_OFF && !FREEZE_KMERS)
+    {
+        printf("ERROR: --numa needs --freeze.\n");
+        return false;
+    }
+    
+    if (REMAINDER_BITS < 1 || REMAINDER_BITS > 32)
+    {
+        printf("ERROR: The quotient filter remainder must be from 1 to 32 bits.\n");
+        return false;
+    }
+    
     return true;
 }
 
@@ -65,7 +124,7 @@ void help()
     printf("ERROR CORRECTION\n");
     printf("Required: \n");
     printf("\n");
-    printf("\t-i \t[file] \tSpecify one or many FASTQ input files.\n");
+    printf("\t-i \t[file] \tSpecify one or many FASTQ input files, optionally gzip or BGZF compressed.\n");
     printf("\n");
     
     printf("Optional: \n");
@@ -80,8 +139,33 @@ void help()
     printf("\t-f \t[bool] \tLow k-mer read filtering. \"true\" or \"false\".\n");
     //printf("\t-q \t[bool] \tQuality score updating. \"true\" or \"false\".\n");
     printf("\n");
-    printf("\t-k \t[int] \tSpecify the k-mer size.\n");
+    printf("\t-k \t[int] \tSpecify the k-mer size, up to 63.\n");
     printf("\t-b \t[int] \tSpecify the input batch size.\n");
+    printf("\t-t \t[int] \tSpecify the number of threads used for counting k-mers and\n");
+    printf("\t\t\tcorrecting unpaired reads.\n");
+    printf("\t--max-memory [size] \tLimit the memory used for counting k-mers, such as \"8G\".\n");
+    printf("\t\t\tK-mers are partitioned on disk when they do not fit.\n");
+    printf("\t--bloom [size] \tKeep singleton k-mers out of memory with a Bloom filter of\n");
+    printf("\t\t\tthe given size, such as \"512M\".\n");
+    printf("\t--engine [name] \tCount k-mers in a hash table (\"hash\"), by sorting them\n");
+    printf("\t\t\t(\"sort\") or in a counting quotient filter (\"cqf\"), which\n");
+    printf("\t\t\tuses less memory but may rarely merge two k-mers.\n");
+    printf("\t--cqf-bits [int] \tBits stored per k-mer by the cqf engine (default 8).\n");
+    printf("\t\t\tEach bit halves the chance of merging k-mers.\n");
+    printf("\t--hash [name] \tHash k-mers with \"murmur\", \"wyhash\" or \"crc32c\".\n");
+    printf("\t--slots [mask|shift] \tTake hash table slots from the low or high hash bits.\n");
+    printf("\t--huge-pages [mode] \tBack large tables with huge pages: \"off\", \"transparent\"\n");
+    printf("\t\t\t(the default) or \"explicit\", which uses reserved huge pages.\n");
+    printf("\t--save-kmers [file] \tSave the counted k-mers to an index file.\n");
+    printf("\t--load-kmers [file] \tUse the k-mers of an index file instead of counting.\n");
+    printf("\t--extend-kmers [file] \tCount the input files into the k-mers of an index file\n");
+    printf("\t\t\tand write it back, or to --save-kmers if given.\n");
+    printf("\t--freeze \tMove the counted k-mers into a perfect hash table before\n");
+    printf("\t\t\tcorrecting: a half to a third of the memory (about 10\n");
+    printf("\t\t\tbytes per k-mer), slower lookups.\n");
+    printf("\t--numa [policy] \tPin correction threads to NUMA nodes and place the frozen\n");
+    printf("\t\t\tk-mers: \"first-touch\", \"interleave\" or \"replicate\" (a\n");
+    printf("\t\t\tcopy per node). Reports the share of local lookups.\n");
     printf("\n");
     
     printf("FASTK CONVERSION\n");
@@ -90,6 +174,12 @@ void help()
     printf("\t-i \t[file] \tSpecify one or many input files.\n");
     printf("\n");
     
+    printf("HASH BENCHMARK\n");
+    printf("Required: \n");
+    printf("\t-hashbench \tCompare the hash functions on the k-mers of the input files.\n");
+    printf("\t-i \t[file] \tSpecify one or many input files.\n");
+    printf("\n");
+    
     printf("EXAMPLES: \n");
     printf("\n");
     printf("./error -i file1.fastq\n");
@@ -118,6 +208,7 @@ int main(int argc, char**argv)
     
     bool paired = false;
     bool fastk = false;
+    bool hashbench = false;
     
     // Corrections:
     bool substitutions = true;
@@ -181,11 +272,17 @@ int main(int argc, char**argv)
             
             printf(": output directory is %s\n", outputDirectory);
         }
-        // TYPE OF DATA
-        else if(strcmp("-t", argv[i]) == 0)
+        // THREADS (or deprecated: TYPE OF DATA)
+        else if(strcmp("-t", argv[i]) == 0 && i < (argc - 1))
         {
+            // Number of threads:
+            if(isdigit(argv[i + 1][0]))
+            {
+                NUM_THREADS = atoi(argv[i + 1]);
+                printf(": number of threads is %d\n", NUM_THREADS);
+            }
             // Illumina
-            if(strcmp("illumina", argv[i + 1]) == 0)
+            else if(strcmp("illumina", argv[i + 1]) == 0)
             {
                 type = ILLUMINA;
                 printf(": input type is Illumina\n");
@@ -224,6 +321,192 @@ int main(int argc, char**argv)
             
             i++; 
         }
+        // MEMORY LIMIT
+        else if(strcmp("--max-memory", argv[i]) == 0 && i < (argc - 1))
+        {
+            MAX_MEMORY = parseMemorySize(argv[i + 1]);
+            
+            if(MAX_MEMORY == 0)
+            {
+                printf("\nProblem with memory limit: %s\n", argv[i + 1]);
+                return 1;
+            }
+            
+            printf(": memory limit is %llu bytes\n", MAX_MEMORY);
+            
+            i++;
+        }
+        // SINGLETON FILTER
+        else if(strcmp("--bloom", argv[i]) == 0 && i < (argc - 1))
+        {
+            FILTER_SIZE = parseMemorySize(argv[i + 1]);
+            
+            if(FILTER_SIZE == 0)
+            {
+                printf("\nProblem with Bloom filter size: %s\n", argv[i + 1]);
+                return 1;
+            }
+            
+            printf(": Bloom filter size is %llu bytes\n", FILTER_SIZE);
+            
+            i++;
+        }
+        // COUNTING ENGINE
+        else if(strcmp("--engine", argv[i]) == 0 && i < (argc - 1))
+        {
+            if(strcmp("hash", argv[i + 1]) == 0)
+            {
+                KMER_ENGINE = KMER_ENGINE_HASH;
+            }
+            else if(strcmp("sort", argv[i + 1]) == 0)
+            {
+                KMER_ENGINE = KMER_ENGINE_SORT;
+            }
+            else if(strcmp("cqf", argv[i + 1]) == 0)
+            {
+                KMER_ENGINE = KMER_ENGINE_QUOTIENT;
+            }
+            else
+            {
+                printf("\nUnknown counting engine: %s\n", argv[i + 1]);
+                return 1;
+            }
+            
+            printf(": counting engine is %s\n", argv[i + 1]);
+            
+            i++;
+        }
+        // QUOTIENT FILTER REMAINDER
+        else if(strcmp("--cqf-bits", argv[i]) == 0 && i < (argc - 1))
+        {
+            REMAINDER_BITS = atoi(argv[i + 1]);
+            
+            printf(": quotient filter remainder is %d bits\n", REMAINDER_BITS);
+            
+            i++;
+        }
+        // HASH FUNCTION
+        else if(strcmp("--hash", argv[i]) == 0 && i < (argc - 1))
+        {
+            if(!parseKMerHash(argv[i + 1], &HASH_FUNCTION))
+            {
+                printf("\nUnknown hash function: %s\n", argv[i + 1]);
+                return 1;
+            }
+            
+            printf(": hash function is %s\n", argv[i + 1]);
+            
+            i++;
+        }
+        // SLOT REDUCTION
+        else if(strcmp("--slots", argv[i]) == 0 && i < (argc - 1))
+        {
+            if(strcmp("mask", argv[i + 1]) == 0)
+            {
+                SLOT_REDUCTION = KMER_SLOT_MASK;
+            }
+            else if(strcmp("shift", argv[i + 1]) == 0)
+            {
+                SLOT_REDUCTION = KMER_SLOT_SHIFT;
+            }
+            else
+            {
+                printf("\nUnknown slot reduction: %s\n", argv[i + 1]);
+                return 1;
+            }
+            
+            printf(": hash table slots use %s\n", argv[i + 1]);
+            
+            i++;
+        }
+        // HUGE PAGES
+        else if(strcmp("--huge-pages", argv[i]) == 0 && i < (argc - 1))
+        {
+            if(strcmp("off", argv[i + 1]) == 0)
+            {
+                HUGE_PAGES = HUGE_PAGES_OFF;
+            }
+            else if(strcmp("transparent", argv[i + 1]) == 0)
+            {
+                HUGE_PAGES = HUGE_PAGES_TRANSPARENT;
+            }
+            else if(strcmp("explicit", argv[i + 1]) == 0)
+            {
+                HUGE_PAGES = HUGE_PAGES_EXPLICIT;
+            }
+            else
+            {
+                printf("\nUnknown huge page mode: %s\n", argv[i + 1]);
+                return 1;
+            }
+            
+            printf(": huge pages are %s\n", argv[i + 1]);
+            
+            i++;
+        }
+        // SAVE K-MERS
+        else if(strcmp("--save-kmers", argv[i]) == 0 && i < (argc - 1))
+        {
+            SAVE_KMERS = argv[i + 1];
+            
+            printf(": saving k-mers to %s\n", SAVE_KMERS);
+            
+            i++;
+        }
+        // LOAD K-MERS
+        else if(strcmp("--load-kmers", argv[i]) == 0 && i < (argc - 1))
+        {
+            LOAD_KMERS = argv[i + 1];
+            
+            printf(": loading k-mers from %s\n", LOAD_KMERS);
+            
+            i++;
+        }
+        // EXTEND K-MERS
+        else if(strcmp("--extend-kmers", argv[i]) == 0 && i < (argc - 1))
+        {
+            EXTEND_KMERS = argv[i + 1];
+            
+            printf(": extending k-mers of %s\n", EXTEND_KMERS);
+            
+            i++;
+        }
+        // FREEZE K-MERS
+        else if(strcmp("--freeze", argv[i]) == 0)
+        {
+            FREEZE_KMERS = true;
+            
+            printf(": freezing k-mers before correction\n");
+        }
+        // NUMA PLACEMENT
+        else if(strcmp("--numa", argv[i]) == 0 && i < (argc - 1))
+        {
+            if(strcmp("off", argv[i + 1]) == 0)
+            {
+                NUMA_PLACEMENT = NUMA_OFF;
+            }
+            else if(strcmp("first-touch", argv[i + 1]) == 0)
+            {
+                NUMA_PLACEMENT = NUMA_FIRST_TOUCH;
+            }
+            else if(strcmp("interleave", argv[i + 1]) == 0)
+            {
+                NUMA_PLACEMENT = NUMA_INTERLEAVE_PAGES;
+            }
+            else if(strcmp("replicate", argv[i + 1]) == 0)
+            {
+                NUMA_PLACEMENT = NUMA_REPLICATE;
+            }
+            else
+            {
+                printf("\nUnknown NUMA placement: %s\n", argv[i + 1]);
+                return 1;
+            }
+            
+            printf(": NUMA placement is %s\n", argv[i + 1]);
+            
+            i++;
+        }
         // FASTK
         else if(strcmp("-fastk", argv[i]) == 0)
         {
@@ -231,6 +514,13 @@ int main(int argc, char**argv)
             
             printf(": FASTK conversion\n");
         }
+        // HASH BENCHMARK
+        else if(strcmp("-hashbench", argv[i]) == 0)
+        {
+            hashbench = true;
+            
+            printf(": hash benchmark\n");
+        }
         // SUBSTITUTIONS
         else if(strcmp("-s", argv[i]) == 0)
         {
@@ -393,6 +683,11 @@ int main(int argc, char**argv)
         {
             convertFASTQToFASTK(numInputFiles, inputFileNames, outputDirectory);
         }
+        // HASH BENCHMARK
+        else if(hashbench)
+        {
+            benchmarkHashFunctions(numInputFiles, inputFileNames);
+        }
         // ERROR CORRECTION
         else
         {
@@ -0,0 +1,48 @@
+# Writes n reads of a random genome to each of the files out1 and out2, from 
+# either strand and with substitution errors. The reads are the same on every 
+# machine: the generator only needs integers a double holds exactly.
+#
+# awk -v genome=100000 -v n=10000 -v readLength=100 -v out1=a.fastq -v out2=b.fastq -f reads.awk
+
+function next32()
+{
+    seed = (seed * 69069 + 1) % 4294967296
+    return seed
+}
+
+function pick(n)
+{
+    return int(next32() / 4294967296 * n)
+}
+
+BEGIN {
+    seed = 7
+    split("A C G T", base, " ")
+    complement["A"] = "T"; complement["C"] = "G"; complement["G"] = "C"; complement["T"] = "A"
+    
+    for (i = 0; i < genome; i++)
+        g[i] = base[pick(4) + 1]
+    
+    for (r = 0; r < 2 * n; r++)
+    {
+        start = pick(genome - readLength + 1)
+        forward = pick(2)
+        sequence = ""
+        
+        for (i = 0; i < readLength; i++)
+        {
+            c = forward ? g[start + i] : complement[g[start + readLength - 1 - i]]
+            
+            # One error in 200 bases:
+            if (pick(200) == 0)
+                c = base[pick(4) + 1]
+            
+            sequence = sequence c
+        }
+        
+        quality = sequence
+        gsub(/./, "I", quality)
+        
+        printf("@read%d\n%s\n+\n%s\n", r, sequence, quality) > (r < n ? out1 : out2)
+    }
+}
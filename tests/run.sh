@@ -0,0 +1,88 @@
+#!/bin/sh
+# Runs the regression tests against a built pollux:
+#
+# sh tests/run.sh [pollux]
+
+POLLUX=${1:-./pollux}
+TESTS=$(dirname "$0")
+WORK=$(mktemp -d)
+FAILED=0
+
+trap 'rm -rf "$WORK"' EXIT
+
+# Corrects the two files of reads into the named directory, with the options.
+run()
+{
+    name=$1
+    shift
+    
+    runFiles "$name" "$WORK/r1.fastq" "$WORK/r2.fastq" "$@"
+}
+
+# As run, correcting only the file given after the name.
+runFiles()
+{
+    name=$1
+    shift
+    
+    mkdir -p "$WORK/$name"
+    "$POLLUX" -i "$@" -o "$WORK/$name" > "$WORK/$name/log.txt" 2>&1
+}
+
+# Whether two runs kept the same k-mers and corrected the files named after 
+# them the same way.
+same()
+{
+    first=$1
+    second=$2
+    shift 2
+    
+    grep -E "^(Removed|Low k-mer|Kept)" "$WORK/$first/log.txt" > "$WORK/$first/counts.txt" &&
+    grep -E "^(Removed|Low k-mer|Kept)" "$WORK/$second/log.txt" > "$WORK/$second/counts.txt" &&
+    cmp -s "$WORK/$first/counts.txt" "$WORK/$second/counts.txt" || return 1
+    
+    if [ $# -eq 0 ]
+    then
+        set -- r1 r2
+    fi
+    
+    for file in "$@"
+    do
+        cmp -s "$WORK/$first/$file.fastq.corrected" "$WORK/$second/$file.fastq.corrected" || return 1
+    done
+}
+
+# Reports the test named by the first argument, which passed if the status 
+# given after it is 0.
+check()
+{
+    if [ "$2" -eq 0 ]
+    then
+        echo "PASS: $1"
+    else
+        echo "FAIL: $1 (see $WORK)"
+        FAILED=1
+        trap - EXIT
+    fi
+}
+
+# Two files of reads from one genome:
+awk -v genome=100000 -v n=10000 -v readLength=100 \
+        -v out1="$WORK/r1.fastq" -v out2="$WORK/r2.fastq" -f "$TESTS/reads.awk"
+
+run direct -b 100
+
+# A memory limit too small to count every k-mer at once spills them to 
+# partitions, which must give the same k-mers:
+run partitioned -b 100 --max-memory 10M
+grep -q "^Spilling k-mers to" "$WORK/partitioned/log.txt" && same direct partitioned
+check "counting within a memory limit matches counting directly" $?
+
+# Counting the second file into an index of the first must count every k-mer 
+# as if both files were counted at once, including those seen once in each:
+runFiles saved "$WORK/r1.fastq" -b 100 --save-kmers "$WORK/r1.kmers"
+runFiles extended "$WORK/r2.fastq" -b 100 --extend-kmers "$WORK/r1.kmers"
+same direct extended r2
+check "extending an index matches counting every file at once" $?
+
+exit $FAILED